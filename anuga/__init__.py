@@ -108,6 +108,7 @@ from anuga.utilities.parse_time import parse_time
 # Parallel api
 # ----------------------------
 from anuga.parallel.parallel_api import distribute
+from anuga.parallel.rebalance import rebalance
 from anuga.parallel.parallel_api import myid, numprocs, get_processor_name
 from anuga.parallel.parallel_api import send, receive, reduce
 from anuga.parallel.parallel_api import pypar_available, barrier, finalize
@@ -67,6 +67,7 @@ class General_mesh:
                  triangles,
                  geo_reference=None,
                  use_inscribed_circle=False,
+                 ordering=None,
                  verbose=False):
         """Build triangular 2d mesh from nodes and triangle information
 
@@ -82,6 +83,12 @@ class General_mesh:
           georeference (optional): If specified coordinates are
           assumed to be relative to this origin.
 
+          ordering (optional): 'hilbert' or 'morton'. If specified the
+          triangles are renumbered along that space filling curve and
+          the nodes in order of first use (see compute_mesh_ordering).
+          The permutations from the new to the supplied numbering are
+          kept as triangle_permutation and node_permutation.
+
 
         """
 
@@ -98,6 +105,23 @@ class General_mesh:
 
         self.nodes = num.array(nodes, float)
 
+        # Renumber triangles and nodes along a space filling curve
+        self.ordering = ordering
+        self.triangle_permutation = None
+        self.node_permutation = None
+        if ordering is not None:
+            if verbose: log.critical('General_mesh: Reordering mesh (%s)' % ordering)
+
+            triangle_permutation, node_permutation = \
+                compute_mesh_ordering(self.nodes, self.triangles, ordering)
+
+            inverse_node_permutation = num.argsort(node_permutation)
+            self.triangles = inverse_node_permutation[self.triangles[triangle_permutation]]
+            self.nodes = self.nodes[node_permutation]
+
+            self.triangle_permutation = triangle_permutation
+            self.node_permutation = node_permutation
+
         # Register number of elements and nodes
         self.number_of_triangles = N = int(self.triangles.shape[0])
         self.number_of_nodes = self.nodes.shape[0]
@@ -415,6 +439,27 @@ class General_mesh:
     def get_number_of_triangles(self):
         return self.number_of_triangles
 
+    def get_triangle_permutation(self):
+        """Return the supplied id of each triangle.
+
+        Triangle i of the mesh was triangle get_triangle_permutation()[i]
+        of the input. This is the identity unless the mesh was reordered.
+        """
+
+        if self.triangle_permutation is None:
+            return num.arange(self.number_of_triangles)
+
+        return self.triangle_permutation
+
+    def get_node_permutation(self):
+        """Return the supplied id of each node (see get_triangle_permutation).
+        """
+
+        if self.node_permutation is None:
+            return num.arange(self.number_of_nodes)
+
+        return self.node_permutation
+
 
     def get_number_of_nodes(self):
         return self.number_of_nodes
@@ -886,3 +931,104 @@ class General_mesh:
 
     def get_georeference(self):
         return self.geo_reference
+
+
+def _spread_bits(a):
+    """Spread the lower 16 bits of each entry of a so that there is a
+    zero bit between each of them.
+    """
+
+    a = a & 0x0000ffff
+    a = (a | (a << 8)) & 0x00ff00ff
+    a = (a | (a << 4)) & 0x0f0f0f0f
+    a = (a | (a << 2)) & 0x33333333
+    a = (a | (a << 1)) & 0x55555555
+
+    return a
+
+
+def morton_keys(ix, iy):
+    """Return the Morton (Z order) keys of integer coordinates in [0, 2**16)
+    """
+
+    return _spread_bits(ix) | (_spread_bits(iy) << 1)
+
+
+def hilbert_keys(ix, iy, bits=16):
+    """Return the distance along the Hilbert curve of integer
+    coordinates in [0, 2**bits)
+    """
+
+    x = num.array(ix, num.int64)
+    y = num.array(iy, num.int64)
+    d = num.zeros(x.shape, num.int64)
+
+    n = 1 << bits
+    s = n >> 1
+    while s > 0:
+        rx = ((x & s) > 0).astype(num.int64)
+        ry = ((y & s) > 0).astype(num.int64)
+        d += s * s * ((3 * rx) ^ ry)
+
+        # Rotate the quadrant
+        flip = (ry == 0) & (rx == 1)
+        x = num.where(flip, n - 1 - x, x)
+        y = num.where(flip, n - 1 - y, y)
+        swap = (ry == 0)
+        x, y = num.where(swap, y, x), num.where(swap, x, y)
+
+        s >>= 1
+
+    return d
+
+
+def compute_mesh_ordering(nodes, triangles, ordering='hilbert'):
+    """Compute a space filling curve numbering of a mesh.
+
+    Triangles are sorted by the Hilbert or Morton key of their centroid
+    on a 2**16 x 2**16 grid over the extent of the mesh (ties keep their
+    original order). Nodes are then numbered in order of first use by
+    the sorted triangles, with unused nodes at the end.
+
+    Neighbouring triangles and nodes end up close together in memory,
+    which improves cache reuse in the kernels that gather values from
+    the neighbours of each triangle.
+
+    Return triangle_permutation and node_permutation, the original id
+    of each triangle and node in the new numbering.
+    """
+
+    nodes = num.array(nodes, float)
+    triangles = num.array(triangles, int)
+
+    if ordering not in ['hilbert', 'morton']:
+        msg = 'Unknown mesh ordering %s. Use hilbert or morton' % str(ordering)
+        raise ValueError(msg)
+
+    centroids = num.sum(nodes[triangles], axis=1) / 3.0
+
+    bits = 16
+    lo = num.min(centroids, axis=0)
+    extent = num.max(num.max(centroids, axis=0) - lo)
+    if extent <= 0.0:
+        extent = 1.0
+    scale = ((1 << bits) - 1) / extent
+    ixy = ((centroids - lo) * scale).astype(num.int64)
+
+    if ordering == 'hilbert':
+        keys = hilbert_keys(ixy[:, 0], ixy[:, 1], bits)
+    else:
+        keys = morton_keys(ixy[:, 0], ixy[:, 1])
+
+    triangle_permutation = num.argsort(keys, kind='mergesort')
+
+    # Nodes in order of first use
+    used = triangles[triangle_permutation].ravel()
+    unique_nodes, first = num.unique(used, return_index=True)
+    node_order = unique_nodes[num.argsort(first, kind='mergesort')]
+
+    unused = num.ones(nodes.shape[0], bool)
+    unused[node_order] = False
+    node_permutation = num.concatenate((node_order, num.flatnonzero(unused)))
+
+    return triangle_permutation, node_permutation.astype(int)
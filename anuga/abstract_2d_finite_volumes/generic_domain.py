@@ -30,6 +30,7 @@ from .tag_region import Set_tag_region as region_set_tag_region
 from anuga.geometry.polygon import inside_polygon
 from anuga.abstract_2d_finite_volumes.util import get_textual_float
 from .quantity import Quantity
+from .kernel_profiler import Kernel_profiler
 import anuga.utilities.log as log
 import anuga
 
@@ -40,6 +41,16 @@ class Generic_Domain(object):
     """Generic computational Domain constructor.
     """
 
+    # Mesh and work arrays, indexed by triangle or edge, reallocated by
+    # first_touch_arrays
+    first_touch_array_names = ['centroid_coordinates', 'vertex_coordinates',
+                               'edge_coordinates', 'neighbours',
+                               'surrogate_neighbours', 'neighbour_edges',
+                               'normals', 'edgelengths', 'radii', 'areas',
+                               'number_of_boundaries', 'tri_full_flag',
+                               'already_computed_flux', 'max_speed',
+                               'work_centroid_values']
+
     def __init__(self,
                  source=None,
                  triangles=None,
@@ -60,7 +71,8 @@ class Generic_Domain(object):
                  numproc=1,
                  number_of_full_nodes=None,
                  number_of_full_triangles=None,
-                 ghost_layer_width=2):
+                 ghost_layer_width=2,
+                 mesh_ordering=None):
 
         """Instantiate generic computational Domain.
 
@@ -78,6 +90,12 @@ class Generic_Domain(object):
 
           tagged_elements:
           ...
+          mesh_ordering: None, 'hilbert' or 'morton'. Renumber the
+                         triangles and nodes along a space filling curve
+                         (see General_mesh). Defaults to
+                         anuga.config.mesh_ordering. Ignored for parallel
+                         domains whose communication patterns refer to the
+                         supplied numbering.
         """
 
         if verbose:
@@ -103,12 +121,18 @@ class Generic_Domain(object):
                                     use_cache=use_cache,
                                     verbose=verbose)
 
+        if mesh_ordering is None:
+            from anuga.config import mesh_ordering
+        if not mesh_ordering or full_send_dict or ghost_recv_dict:
+            mesh_ordering = None
+
         # Initialise underlying mesh structure
         self.mesh = Mesh(coordinates, triangles,
                          boundary=boundary,
                          tagged_elements=tagged_elements,
                          geo_reference=geo_reference,
                          use_inscribed_circle=use_inscribed_circle,
+                         ordering=mesh_ordering,
                          # number_of_full_nodes=number_of_full_nodes,
                          # number_of_full_triangles=number_of_full_triangles,
                          verbose=verbose)
@@ -145,6 +169,8 @@ class Generic_Domain(object):
         self.vertex_value_indices = self.mesh.vertex_value_indices
         self.number_of_triangles = self.mesh.number_of_triangles
         self.number_of_nodes = self.mesh.number_of_nodes
+        self.triangle_permutation = self.mesh.triangle_permutation
+        self.node_permutation = self.mesh.node_permutation
 
         self.geo_reference = self.mesh.geo_reference
         self.institution = 'Geosciences Australia'
@@ -191,6 +217,9 @@ class Generic_Domain(object):
             # self.quantities[name] = Quantity(self, name=name)
             Quantity(self, name=name, register=True)
 
+        # Quantity arrays are allocated separately (see set_quantity_arena)
+        self.quantity_arena = None
+
         # Create an empty list for forcing terms
         self.forcing_terms = []
 
@@ -201,6 +230,9 @@ class Generic_Domain(object):
         # by default domain is not parallel
         self.parallel = False
 
+        # Serial C kernels (see set_multiprocessor_mode in shallow water)
+        self.multiprocessor_mode = 0
+
         self.number_of_global_triangles = self.number_of_triangles
         self.number_of_global_nodes = self.number_of_nodes
 
@@ -223,6 +255,18 @@ class Generic_Domain(object):
         self.communication_reduce_time = 0.0
         self.communication_broadcast_time = 0.0
 
+        # Cumulative times and call counts of the steps of the evolve loop
+        from anuga.config import kernel_timing_file, hardware_counters
+        self.kernel_profiler = Kernel_profiler()
+        self.kernel_timing_file = kernel_timing_file
+        if hardware_counters:
+            self.set_hardware_counters(True)
+
+        # Ghost layers valid since the last ghost exchange
+        from anuga.config import ghost_exchange_period
+        self.set_ghost_exchange_period(ghost_exchange_period)
+        self.record_ghost_exchange()
+
         # Setup Communication Buffers
         if verbose:
             log.critical('Domain: Set up communication buffers ')
@@ -409,6 +453,12 @@ class Generic_Domain(object):
     def get_number_of_triangles(self, *args, **kwargs):
         return self.mesh.get_number_of_triangles(*args, **kwargs)
 
+    def get_triangle_permutation(self, *args, **kwargs):
+        return self.mesh.get_triangle_permutation(*args, **kwargs)
+
+    def get_node_permutation(self, *args, **kwargs):
+        return self.mesh.get_node_permutation(*args, **kwargs)
+
     def get_normal(self, *args, **kwargs):
         return self.mesh.get_normal(*args, **kwargs)
 
@@ -682,6 +732,141 @@ class Generic_Domain(object):
         """
         return self.using_discontinuous_elevation
 
+    def set_quantity_arena(self, policy='quantity'):
+        """Pack the arrays of all quantities into one aligned block of
+        memory (see quantity_arena.py), laid out quantity by quantity
+        (policy 'quantity') or array by array (policy 'array'). With
+        policy None the quantities get separate arrays again.
+
+        The quantity arrays are replaced, so call this before creating
+        operators or anything else keeping references to them. Quantities
+        created afterwards are not in the block until this is called again.
+        """
+
+        from anuga.abstract_2d_finite_volumes.quantity_arena import \
+            Quantity_arena, unpack_quantity_arrays
+
+        if policy is None:
+            if self.quantity_arena is not None:
+                unpack_quantity_arrays(self.quantities)
+            self.quantity_arena = None
+        else:
+            self.quantity_arena = Quantity_arena(self.quantities, policy)
+
+    def get_quantity_arena(self):
+        """Return the Quantity_arena holding the quantity arrays, or None
+        """
+
+        return self.quantity_arena
+
+    def set_kernel_timing_file(self, filename=None):
+        """Write the kernel timing statistics (see kernel_profiler.py) as
+        JSON to filename at each yield step of evolve. None to stop.
+        """
+
+        self.kernel_timing_file = filename
+
+    def get_kernel_timing_file(self):
+
+        return self.kernel_timing_file
+
+    def get_kernel_timing(self):
+        """Return dictionary of name: {'calls': calls, 'time': seconds}
+        with the cumulative wall time and number of calls of each timed
+        step of the evolve loop
+        """
+
+        return self.kernel_profiler.get_statistics()
+
+    def kernel_timing_statistics(self):
+        """Return string with the cumulative wall time and number of calls
+        of each timed step of the evolve loop
+        """
+
+        return self.kernel_profiler.statistics()
+
+    def print_kernel_timing_statistics(self):
+
+        print(self.kernel_timing_statistics())
+
+    def reset_kernel_timing(self):
+
+        self.kernel_profiler.reset()
+
+    def set_hardware_counters(self, flag=True):
+        """Count cycles, instructions and last level cache misses of the
+        timed steps of the evolve loop which are a single C kernel call
+        (protect, extrapolation, flux, flux_update_frequency, update,
+        backup and saxpy, see kernel_steps in kernel_profiler.py) with the
+        hardware performance counters (Linux perf_event_open). The counts
+        are added to get_kernel_timing, kernel_timing_statistics and
+        timestepping_statistics. Raises OSError if the counters are not
+        available. Resets the kernel timing.
+
+        Each domain opens its own counters, so turning them on or off for
+        one domain does not affect another. The counters count the thread
+        calling this and the threads it creates afterwards, so call this
+        before running threaded kernels to count the OpenMP threads as
+        well. The counts are of whatever those threads run: if several
+        domains are evolved at once in these threads (or share the OpenMP
+        threads) the counts include the work of the other domains.
+        """
+
+        self.kernel_profiler.set_hardware_counters(flag)
+
+    def get_hardware_counters(self):
+
+        return self.kernel_profiler.get_hardware_counters()
+
+    def dump_kernel_timing(self, filename):
+        """Write the kernel timing statistics, with the model time, number
+        of triangles and processor, to filename as JSON
+        """
+
+        self.kernel_profiler.dump(filename,
+                                  time=self.get_time(),
+                                  number_of_triangles=len(self),
+                                  processor=self.processor,
+                                  numproc=self.numproc)
+
+    def log_kernel_timing_statistics(self):
+
+        if self.kernel_timing_file is not None:
+            self.dump_kernel_timing(self.kernel_timing_file)
+
+    def first_touch_arrays(self):
+        """Reallocate the quantity arrays and the arrays named in
+        first_touch_array_names, copying them in from the threads of the
+        OpenMP kernels with the kernels' static schedule over triangles
+        (see quantity_arena.py). With the first touch page placement of
+        Linux each page is then on the NUMA node of the thread that works
+        on it. Thread count and binding (OMP_NUM_THREADS, OMP_PROC_BIND)
+        must be as in the kernels.
+        """
+
+        from anuga.abstract_2d_finite_volumes.quantity_arena import \
+            Quantity_arena, first_touch_array, quantity_array_names
+
+        N = self.number_of_elements
+
+        if self.quantity_arena is not None:
+            self.quantity_arena = Quantity_arena(self.quantities,
+                                                 self.quantity_arena.policy, N)
+        else:
+            for Q in self.quantities.values():
+                for array_name in quantity_array_names:
+                    setattr(Q, array_name,
+                            first_touch_array(getattr(Q, array_name), N))
+
+        # Mesh arrays are shared with self.mesh, possibly by another name
+        for name in self.first_touch_array_names:
+            A = getattr(self, name)
+            B = first_touch_array(A, N)
+            for obj in [self, self.mesh]:
+                for key, value in list(vars(obj).items()):
+                    if value is A:
+                        setattr(obj, key, B)
+
     def set_quantity_vertices_dict(self, quantity_dict):
         """Set values for named quantities.
         Supplied dictionary contains name/value pairs:
@@ -690,12 +875,18 @@ class Generic_Domain(object):
         value: Compatible list, numeric array, const or function (see below)
 
         The values will be stored in elements following their internal ordering.
+
+        Values are given per node in the numbering of the mesh file, and
+        are reordered with the nodes if the mesh was (see mesh_ordering).
         """
 
         # FIXME: Could we name this a bit more intuitively
         # E.g. set_quantities_from_dictionary
         for key in list(quantity_dict.keys()):
-            self.set_quantity(key, quantity_dict[key], location='vertices')
+            values = quantity_dict[key]
+            if self.node_permutation is not None:
+                values = num.array(values)[self.node_permutation]
+            self.set_quantity(key, values, location='vertices')
 
     def set_quantity(self, name,
                      *args, **kwargs):
@@ -1163,6 +1354,9 @@ class Generic_Domain(object):
         msg += ' (%ds)' % (walltime() - self.last_walltime)
         self.last_walltime = walltime()
 
+        if self.kernel_profiler.get_hardware_counters():
+            msg += '\n' + self.kernel_profiler.counter_statistics()
+
         if track_speeds is True:
             msg += '\n'
 
@@ -1695,6 +1889,8 @@ class Generic_Domain(object):
             # let's get out of here
             return
 
+        profile = self.kernel_profiler.time
+
         N = len(self)                             # Number of triangles
         self.yieldtime = self.get_time() + yieldstep    # set next yield time
 
@@ -1707,10 +1903,11 @@ class Generic_Domain(object):
         self.number_of_first_order_steps = 0
 
         # Update ghosts to ensure all centroid values are available
-        self.update_ghosts()
+        profile('ghost_exchange', self.update_ghosts)
+        self.record_ghost_exchange()
 
         # Update extrema if necessary (for reporting)
-        self.update_extrema()
+        profile('extrema', self.update_extrema)
 
         # Or maybe restore from latest checkpoint
         # if self.checkpoint is True:
@@ -1719,41 +1916,49 @@ class Generic_Domain(object):
         if skip_initial_step is False:
 
             # Assuming centroid values ok, calculate edge and vertes values
-            self.distribute_to_vertices_and_edges()
-            self.update_boundary()
+            profile('extrapolation', self.distribute_to_vertices_and_edges)
+            profile('boundary', self.update_boundary)
 
             yield(self.get_time())      # Yield initial values
 
         while True:
-            initial_time = self.get_time()
+            if self.use_native_evolve():
+                # Take the timesteps up to the next yield point in one call
+                self.evolve_to_yieldstep(yieldstep, self.finaltime)
+            else:
+                initial_time = self.get_time()
 
-            # Apply fluid flow fractional step
-            if self.get_timestepping_method() == 'euler':
-                self.evolve_one_euler_step(yieldstep, self.finaltime)
+                # Apply fluid flow fractional step
+                if self.get_timestepping_method() == 'euler':
+                    self.evolve_one_euler_step(yieldstep, self.finaltime)
 
-            elif self.get_timestepping_method() == 'rk2':
-                self.evolve_one_rk2_step(yieldstep, self.finaltime)
+                elif self.get_timestepping_method() == 'rk2':
+                    self.evolve_one_rk2_step(yieldstep, self.finaltime)
 
-            elif self.get_timestepping_method() == 'rk3':
-                self.evolve_one_rk3_step(yieldstep, self.finaltime)
+                elif self.get_timestepping_method() == 'rk3':
+                    self.evolve_one_rk3_step(yieldstep, self.finaltime)
 
-            # Apply other fractional steps
-            self.apply_fractional_steps()
+                # Apply other fractional steps
+                self.apply_fractional_steps()
 
-            # Centroid Values of variables should be ok
+                # Centroid Values of variables should be ok
 
-            # Update time
-            self.set_time(initial_time + self.timestep)
+                # Update time
+                self.set_time(initial_time + self.timestep)
 
-            self.update_ghosts()
+                # Update ghosts when the ghost layer is used up
+                self.advance_ghost_layers()
+                if self.ghost_exchange_due_at_step_end():
+                    profile('ghost_exchange', self.update_ghosts)
+                    self.record_ghost_exchange()
 
-            # Update extrema (only uses centroid values)
-            self.update_extrema()
+                # Update extrema (only uses centroid values)
+                profile('extrema', self.update_extrema)
 
-            self.number_of_steps += 1
+                self.number_of_steps += 1
 
-            if self._order_ == 1:
-                self.number_of_first_order_steps += 1
+                if self._order_ == 1:
+                    self.number_of_first_order_steps += 1
 
             # Yield results
             if self.finaltime is not None and\
@@ -1769,9 +1974,10 @@ class Generic_Domain(object):
                 # Distribute to vertices, log and then yield final time
                 # and stop
                 self.set_time(self.finaltime)
-                self.distribute_to_vertices_and_edges()
-                self.update_boundary()
+                profile('extrapolation', self.distribute_to_vertices_and_edges)
+                profile('boundary', self.update_boundary)
                 self.log_operator_timestepping_statistics()
+                self.log_kernel_timing_statistics()
                 yield(self.get_time())
                 break
 
@@ -1784,9 +1990,10 @@ class Generic_Domain(object):
 
                 # Log and then Pass control on to outer loop for more
                 # specific actions
-                self.distribute_to_vertices_and_edges()
-                self.update_boundary()
+                profile('extrapolation', self.distribute_to_vertices_and_edges)
+                profile('boundary', self.update_boundary)
                 self.log_operator_timestepping_statistics()
+                self.log_kernel_timing_statistics()
                 yield(self.get_time())
 
                 # Reinitialise
@@ -1795,7 +2002,19 @@ class Generic_Domain(object):
                 self.recorded_max_timestep = self.evolve_min_timestep
                 self.number_of_steps = 0
                 self.number_of_first_order_steps = 0
-                self.max_speed = num.zeros(N, float)
+                self.max_speed[:] = 0.0
+
+    def use_native_evolve(self):
+        """Return True if the timesteps between yield points are to be
+        taken by evolve_to_yieldstep rather than the python loop in
+        _evolve_base. Overridden by Domain subclasses which support it.
+        """
+
+        return False
+
+    def evolve_to_yieldstep(self, yieldstep, finaltime):
+        msg = 'Method evolve_to_yieldstep must be overridden by Domain subclass'
+        raise Exception(msg)
 
     def evolve_one_euler_step(self, yieldstep, finaltime):
         """One Euler Time Step
@@ -1805,27 +2024,32 @@ class Generic_Domain(object):
         vertices and edges
         """
 
+        profile = self.kernel_profiler.time
+
         # From centroid values calculate edge and vertex values
-        self.distribute_to_vertices_and_edges()
+        profile('extrapolation', self.distribute_to_vertices_and_edges)
 
         # Apply boundary conditions
-        self.update_boundary()
+        profile('boundary', self.update_boundary)
 
         # Compute fluxes across each element edge
-        self.compute_fluxes()
+        profile('flux', self.compute_fluxes)
+
+        # Start reducing the flux timestep over the processors
+        self.post_timestep_reduction()
 
         # Compute forcing terms
-        self.compute_forcing_terms()
+        profile('forcing', self.compute_forcing_terms)
 
         # Update timestep to fit yieldstep and finaltime
-        self.update_timestep(yieldstep, finaltime)
+        profile('timestep', self.update_timestep, yieldstep, finaltime)
 
         if self.max_flux_update_frequency != 1:
             # Update flux_update_frequency using the new timestep
-            self.compute_flux_update_frequency()
+            profile('flux_update_frequency', self.compute_flux_update_frequency)
 
         # Update conserved quantities
-        self.update_conserved_quantities()
+        profile('update', self.update_conserved_quantities)
 
     def evolve_one_rk2_step(self, yieldstep, finaltime):
         """One 2nd order RK timestep
@@ -1835,30 +2059,35 @@ class Generic_Domain(object):
         vertices and edges
         """
 
+        profile = self.kernel_profiler.time
+
         # Save initial initial conserved quantities values
-        self.backup_conserved_quantities()
+        profile('backup', self.backup_conserved_quantities)
 
         ######
         # First euler step
         ######
 
         # From centroid values calculate edge and vertex values
-        self.distribute_to_vertices_and_edges()
+        profile('extrapolation', self.distribute_to_vertices_and_edges)
 
         # Apply boundary conditions
-        self.update_boundary()
+        profile('boundary', self.update_boundary)
 
         # Compute fluxes across each element edge
-        self.compute_fluxes()
+        profile('flux', self.compute_fluxes)
+
+        # Start reducing the flux timestep over the processors
+        self.post_timestep_reduction()
 
         # Compute forcing terms
-        self.compute_forcing_terms()
+        profile('forcing', self.compute_forcing_terms)
 
         # Update timestep to fit yieldstep and finaltime
-        self.update_timestep(yieldstep, finaltime)
+        profile('timestep', self.update_timestep, yieldstep, finaltime)
 
         # Update centroid values of conserved quantities
-        self.update_conserved_quantities()
+        profile('update', self.update_conserved_quantities)
 
         # Update special conditions
         # self.update_special_conditions()
@@ -1867,14 +2096,15 @@ class Generic_Domain(object):
         self.set_relative_time(self.get_relative_time() + self.timestep)
 
         # Update ghosts
-        if self.ghost_layer_width < 4:
-            self.update_ghosts()
+        if self.ghost_exchange_due(1):
+            profile('ghost_exchange', self.update_ghosts)
+            self.record_ghost_exchange(1)
 
         # Update vertex and edge values
-        self.distribute_to_vertices_and_edges()
+        profile('extrapolation', self.distribute_to_vertices_and_edges)
 
         # Update boundary values
-        self.update_boundary()
+        profile('boundary', self.update_boundary)
 
         ######
         # Second Euler step using the same timestep
@@ -1884,13 +2114,13 @@ class Generic_Domain(object):
         ######
 
         # Compute fluxes across each element edge
-        self.compute_fluxes()
+        profile('flux', self.compute_fluxes)
 
         # Compute forcing terms
-        self.compute_forcing_terms()
+        profile('forcing', self.compute_forcing_terms)
 
         # Update conserved quantities
-        self.update_conserved_quantities()
+        profile('update', self.update_conserved_quantities)
 
         ######
         # Combine initial and final values
@@ -1898,7 +2128,7 @@ class Generic_Domain(object):
         ######
 
         # Combine steps
-        self.saxpy_conserved_quantities(0.5, 0.5)
+        profile('saxpy', self.saxpy_conserved_quantities, 0.5, 0.5)
 
         # Update special conditions
         # self.update_special_conditions()
@@ -1915,8 +2145,10 @@ class Generic_Domain(object):
         vertices and edges
         """
 
+        profile = self.kernel_profiler.time
+
         # Save initial initial conserved quantities values
-        self.backup_conserved_quantities()
+        profile('backup', self.backup_conserved_quantities)
 
         initial_time = self.get_relative_time()
 
@@ -1925,22 +2157,25 @@ class Generic_Domain(object):
         ######
 
         # From centroid values calculate edge and vertex values
-        self.distribute_to_vertices_and_edges()
+        profile('extrapolation', self.distribute_to_vertices_and_edges)
 
         # Apply boundary conditions
-        self.update_boundary()
+        profile('boundary', self.update_boundary)
 
         # Compute fluxes across each element edge
-        self.compute_fluxes()
+        profile('flux', self.compute_fluxes)
+
+        # Start reducing the flux timestep over the processors
+        self.post_timestep_reduction()
 
         # Compute forcing terms
-        self.compute_forcing_terms()
+        profile('forcing', self.compute_forcing_terms)
 
         # Update timestep to fit yieldstep and finaltime
-        self.update_timestep(yieldstep, finaltime)
+        profile('timestep', self.update_timestep, yieldstep, finaltime)
 
         # Update conserved quantities
-        self.update_conserved_quantities()
+        profile('update', self.update_conserved_quantities)
 
         # Update special conditions
         # self.update_special_conditions()
@@ -1949,13 +2184,15 @@ class Generic_Domain(object):
         self.set_relative_time(self.relative_time+ self.timestep)
 
         # Update ghosts
-        self.update_ghosts()
+        if self.ghost_exchange_due(1):
+            profile('ghost_exchange', self.update_ghosts)
+            self.record_ghost_exchange(1)
 
         # Update vertex and edge values
-        self.distribute_to_vertices_and_edges()
+        profile('extrapolation', self.distribute_to_vertices_and_edges)
 
         # Update boundary values
-        self.update_boundary()
+        profile('boundary', self.update_boundary)
 
         ######
         # Second Euler step using the same timestep
@@ -1965,13 +2202,13 @@ class Generic_Domain(object):
         ######
 
         # Compute fluxes across each element edge
-        self.compute_fluxes()
+        profile('flux', self.compute_fluxes)
 
         # Compute forcing terms
-        self.compute_forcing_terms()
+        profile('forcing', self.compute_forcing_terms)
 
         # Update conserved quantities
-        self.update_conserved_quantities()
+        profile('update', self.update_conserved_quantities)
 
         ######
         # Combine steps to obtain intermediate
@@ -1979,7 +2216,7 @@ class Generic_Domain(object):
         ######
 
         # Combine steps
-        self.saxpy_conserved_quantities(0.25, 0.75)
+        profile('saxpy', self.saxpy_conserved_quantities, 0.25, 0.75)
 
         # Update special conditions
         # self.update_special_conditions()
@@ -1988,26 +2225,28 @@ class Generic_Domain(object):
         self.set_relative_time(initial_time + self.timestep * 0.5)
 
         # Update ghosts
-        self.update_ghosts()
+        if self.ghost_exchange_due(2):
+            profile('ghost_exchange', self.update_ghosts)
+            self.record_ghost_exchange(2)
 
         # Update vertex and edge values
-        self.distribute_to_vertices_and_edges()
+        profile('extrapolation', self.distribute_to_vertices_and_edges)
 
         # Update boundary values
-        self.update_boundary()
+        profile('boundary', self.update_boundary)
 
         ######
         # Third Euler step
         ######
 
         # Compute fluxes across each element edge
-        self.compute_fluxes()
+        profile('flux', self.compute_fluxes)
 
         # Compute forcing terms
-        self.compute_forcing_terms()
+        profile('forcing', self.compute_forcing_terms)
 
         # Update conserved quantities
-        self.update_conserved_quantities()
+        profile('update', self.update_conserved_quantities)
 
         ######
         # Combine final and initial values
@@ -2020,7 +2259,7 @@ class Generic_Domain(object):
         # self.saxpy_conserved_quantities(2.0/3.0, 1.0/3.0)
 
         # So do this instead!
-        self.saxpy_conserved_quantities(2.0, 1.0)
+        profile('saxpy', self.saxpy_conserved_quantities, 2.0, 1.0)
         for name in self.conserved_quantities:
             Q = self.quantities[name]
             Q.centroid_values[:] = Q.centroid_values / 3.0
@@ -2043,16 +2282,14 @@ class Generic_Domain(object):
     def backup_conserved_quantities(self):
 
         # Backup conserved_quantities centroid values
-        for name in self.conserved_quantities:
-            Q = self.quantities[name]
-            Q.backup_centroid_values()
+        from .quantity_ext import backup_quantities
+        backup_quantities(self)
 
     def saxpy_conserved_quantities(self, a, b):
 
         # Backup conserved_quantities centroid values
-        for name in self.conserved_quantities:
-            Q = self.quantities[name]
-            Q.saxpy_centroid_values(a, b)
+        from .quantity_ext import saxpy_quantities
+        saxpy_quantities(self, a, b)
 
     def conserved_values_to_evolved_values(self, q_cons, q_evol):
         """Needs to be overridden by Domain subclass
@@ -2165,8 +2402,10 @@ class Generic_Domain(object):
         raise Exception(msg)
 
     def apply_fractional_steps(self):
+        profile = self.kernel_profiler.time
         for operator in self.fractional_step_operators:
-            operator()
+            label = getattr(operator, 'label', operator.__class__.__name__)
+            profile('operator:' + label, operator)
 
     def log_operator_timestepping_statistics(self):
         for operator in self.fractional_step_operators:
@@ -2270,13 +2509,12 @@ class Generic_Domain(object):
         timestep = self.timestep
 
         # Update conserved_quantities
-        for name in self.conserved_quantities:
-            Q = self.quantities[name]
-            Q.update(timestep)
+        from .quantity_ext import update_quantities
+        update_quantities(self, timestep)
 
-            # Note that Q.explicit_update is reset by compute_fluxes
-            # Where is Q.semi_implicit_update reset?
-            # It is reset in quantity_ext.c
+        # Note that Q.explicit_update is reset by compute_fluxes
+        # Where is Q.semi_implicit_update reset?
+        # It is reset in quantity_ext.c
 
     def update_ghosts(self, quantities=None):
         """We must send the information from the full cells and
@@ -2301,6 +2539,98 @@ class Generic_Domain(object):
                 Q_cv = self.quantities[q].centroid_values
                 num.put(Q_cv, Idg, num.take(Q_cv, Idf, axis=0))
 
+    def post_ghost_exchange(self, quantities=None):
+        """Start updating the ghost cells, to be finished by
+        complete_ghost_exchange before the ghost cells are next read.
+        Parallel domains post non-blocking communication, here the ghost
+        cells are updated at once.
+        """
+
+        self.update_ghosts(quantities)
+
+    def complete_ghost_exchange(self):
+        """Finish the ghost update started by post_ghost_exchange
+        """
+
+        pass
+
+    # Ghost layers used up by each euler substep: the extrapolation of a
+    # cell reads its neighbours' centroids and the fluxes of a cell read
+    # its neighbours' edge values
+    ghost_layers_per_substep = 2
+
+    def set_ghost_exchange_period(self, period=1):
+        """Exchange the ghost cells at the end of at most every period
+        timesteps. In between the ghost cells are computed redundantly,
+        which is valid while the ghost layer is deep enough: each euler
+        substep leaves ghost_layers_per_substep fewer valid layers. So
+        ghost_layer_width (see distribute) must be at least
+        2*substeps*period, otherwise the ghost cells are exchanged as
+        soon as the valid layers are used up. The ghost cells are also
+        exchanged after every timestep with fractional step operators or
+        monitored quantities, and at yield times.
+        """
+
+        if period < 1:
+            raise ValueError('Ghost exchange period must be at least 1, got %s' % str(period))
+
+        self.ghost_exchange_period = int(period)
+
+    def get_ghost_exchange_period(self):
+
+        return self.ghost_exchange_period
+
+    def record_ghost_exchange(self, substep=0):
+        """Note that the ghost cells were exchanged before euler substep
+        substep of the current timestep (0 at the end of a timestep).
+        ghost_valid_layers counts the valid ghost layers from the start of
+        the timestep.
+        """
+
+        self.ghost_valid_layers = self.ghost_layer_width + \
+            self.ghost_layers_per_substep*substep
+        self.steps_since_ghost_exchange = 0
+
+    def ghost_exchange_due(self, substep):
+        """True if the ghost cells must be exchanged before euler substep
+        substep of the current timestep
+        """
+
+        return self.ghost_valid_layers - self.ghost_layers_per_substep*substep < \
+            self.ghost_layers_per_substep
+
+    def advance_ghost_layers(self):
+        """Use up the ghost layers of a timestep, at its end
+        """
+
+        self.ghost_valid_layers -= \
+            self.ghost_layers_per_substep*self.timestep_fluxcalls
+        self.steps_since_ghost_exchange += 1
+
+    def ghost_exchange_due_at_step_end(self):
+        """True if the ghost cells must be exchanged at the end of the
+        current timestep, after advance_ghost_layers
+        """
+
+        time = self.get_time()
+
+        return self.steps_since_ghost_exchange >= self.ghost_exchange_period or \
+            self.ghost_valid_layers < \
+                self.ghost_layers_per_substep*self.timestep_fluxcalls or \
+            len(self.fractional_step_operators) > 0 or \
+            self.quantities_to_be_monitored is not None or \
+            time >= self.yieldtime or \
+            (self.finaltime is not None and time >= self.finaltime - epsilon)
+
+    def post_timestep_reduction(self):
+        """Start the global reduction of flux_timestep, once the fluxes
+        of the first substep are computed, to be finished by
+        update_timestep. Parallel domains may start a non-blocking
+        allreduce here, sequential domains have nothing to reduce.
+        """
+
+        pass
+
 #    def update_special_conditions(self):
 #        """There may be a need to change the values of the conserved
 #        quantities to satisfy special conditions at the very lowest level
@@ -2330,14 +2660,17 @@ class Generic_Domain(object):
         no reference to non-conserved quantities.
         """
 
-        for name in self.conserved_quantities:
-            Q = self.quantities[name]
-            if self._order_ == 1:
-                Q.extrapolate_first_order()
-            elif self._order_ == 2:
-                Q.extrapolate_second_order()
-            else:
-                raise Exception('Unknown order: %s' % str(self._order_))
+        if self._order_ == 1:
+            for name in self.conserved_quantities:
+                self.quantities[name].extrapolate_first_order()
+        elif self._order_ == 2:
+            for name in self.conserved_quantities:
+                self.quantities[name].compute_gradients()
+
+            from .quantity_ext import extrapolate_quantities_from_gradient
+            extrapolate_quantities_from_gradient(self)
+        else:
+            raise Exception('Unknown order: %s' % str(self._order_))
 
     def centroid_norm(self, quantity, normfunc):
         """Calculate the norm of the centroid values of a specific quantity,
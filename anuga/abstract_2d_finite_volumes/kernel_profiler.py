@@ -0,0 +1,245 @@
+"""Cumulative wall time and call counts of the steps of the evolve loop.
+
+Each Domain owns a Kernel_profiler (domain.kernel_profiler) which the
+evolve loop uses to time extrapolation, protection, boundary updates,
+flux computation, forcing terms, conserved quantity updates, ghost
+exchange, each fractional step operator and sww writes.
+
+Times are exclusive: a timed call made from within another timed call
+(e.g. protect from within extrapolation) is only counted under its own
+name, so the times of all names add up to the time spent in timed code.
+
+The overhead is two clock reads and a few dictionary operations per
+timed call, so the profiler is always on.
+
+Optionally (set_hardware_counters) the hardware performance counters of
+perf_counters_ext (cycles, instructions and last level cache misses,
+Linux only) are read at the start and end of each timed call of the
+kernel_steps as well, and counted exclusively in the same way. The bytes
+moved to and from memory are estimated as cache_line_size bytes per cache
+miss. Each profiler opens its own set of counters. A pickled profiler
+(e.g. with a checkpointed domain) opens a new set when unpickled, and
+goes on without hardware counts if that is not possible.
+"""
+
+import json
+from time import perf_counter as timer
+
+cache_line_size = 64
+
+# Timed steps which are a single call of a C kernel of swDE1_domain.c or
+# quantity.c (with the DE algorithms), the only steps given hardware counts.
+# The other steps (boundary, forcing, timestep, ghost_exchange, operators,
+# sww_write, ...) are mostly Python, so their counts would be meaningless
+kernel_steps = ('protect', 'extrapolation', 'flux', 'flux_update_frequency',
+                'update', 'backup', 'saxpy')
+
+
+class Kernel_profiler(object):
+
+    def __init__(self):
+
+        self.hardware_counters = False
+        self.perf_counters = None
+        self.reset()
+
+    def set_hardware_counters(self, flag=True):
+        """Also count cycles, instructions and cache misses of each timed
+        call of the kernel_steps, with a set of counters owned by this
+        profiler. Raises OSError if the hardware counters are not available.
+        """
+
+        self.close_hardware_counters()
+
+        if flag:
+            self._open_hardware_counters()
+
+        self.hardware_counters = flag
+        self.reset()
+
+    def _open_hardware_counters(self):
+
+        from anuga.utilities.perf_counters_ext import Perf_counters, \
+            perf_counter_names
+
+        self.perf_counters = Perf_counters()
+        self.read_counters = self.perf_counters.read
+        self.counter_names = perf_counter_names
+
+    def close_hardware_counters(self):
+        """Close the counters of this profiler, if open
+        """
+
+        if self.perf_counters is not None:
+            self.perf_counters.close()
+            self.perf_counters = None
+        self.hardware_counters = False
+
+    def __del__(self):
+
+        self.close_hardware_counters()
+
+    def __getstate__(self):
+        """Pickle without the hardware counters, which are opened again
+        when unpickled
+        """
+
+        assert not self._nested, 'Pickled during a timed call'
+
+        state = self.__dict__.copy()
+        state['perf_counters'] = None
+        state.pop('read_counters', None)
+
+        return state
+
+    def __setstate__(self, state):
+
+        self.__dict__.update(state)
+
+        if self.hardware_counters:
+            try:
+                self._open_hardware_counters()
+            except OSError:
+                self.hardware_counters = False
+
+    def get_hardware_counters(self):
+
+        return self.hardware_counters
+
+    def reset(self):
+        """Clear all counts and times
+        """
+
+        self.calls = {}
+        self.times = {}
+        self.counts = {}
+
+        # Time spent in nested timed calls, for each open timed call
+        self._nested = []
+
+        # Counter values at the start of, and counts of nested timed calls
+        # in, each open timed call
+        self._counter_starts = []
+        self._nested_counts = []
+
+    def counted(self, name):
+        """True if the hardware counters are read around calls to name
+        """
+
+        return self.hardware_counters and name in kernel_steps
+
+    def start(self, counted=False):
+        """Start timing a call, returns the start time to pass to stop.
+        If counted also read the hardware counters (see counted).
+        """
+
+        self._nested.append(0.0)
+        if counted:
+            self._nested_counts.append((0, 0, 0))
+            self._counter_starts.append(self.read_counters())
+        return timer()
+
+    def stop(self, name, t0, counted=False):
+        """Record a call to name started at time t0 (from start, with
+        the same counted)
+        """
+
+        elapsed = timer() - t0
+        nested = self._nested.pop()
+        if self._nested:
+            self._nested[-1] += elapsed
+
+        self.calls[name] = self.calls.get(name, 0) + 1
+        self.times[name] = self.times.get(name, 0.0) + elapsed - nested
+
+        if counted:
+            counts = [c1 - c0 for c0, c1 in zip(self._counter_starts.pop(),
+                                                self.read_counters())]
+            nested = self._nested_counts.pop()
+            if self._nested_counts:
+                self._nested_counts[-1] = tuple(
+                    n + c for n, c in zip(self._nested_counts[-1], counts))
+
+            total = self.counts.get(name, (0, 0, 0))
+            self.counts[name] = tuple(t + c - n for t, c, n in
+                                      zip(total, counts, nested))
+
+    def time(self, name, function, *args):
+        """Call function(*args), recording the call under name
+        """
+
+        counted = self.counted(name)
+        t0 = self.start(counted)
+        try:
+            return function(*args)
+        finally:
+            self.stop(name, t0, counted)
+
+    def get_statistics(self):
+        """Dictionary of name: {'calls': calls, 'time': seconds}, with the
+        counts of each hardware counter and the estimated bytes moved for
+        the kernel_steps if hardware counters are used
+        """
+
+        statistics = {}
+        for name in self.calls:
+            statistics[name] = {'calls': self.calls[name],
+                                'time': self.times[name]}
+            if name in self.counts:
+                counts = dict(zip(self.counter_names, self.counts[name]))
+                counts['bytes'] = counts['llc_misses']*cache_line_size
+                statistics[name].update(counts)
+
+        return statistics
+
+    def statistics(self):
+        """Table of calls, total and average time of each name, slowest
+        first, as a string
+        """
+
+        total = sum(self.times.values())
+
+        msg = '%-30s %10s %12s %12s %7s\n' % ('kernel', 'calls', 'time (s)',
+                                             'per call (s)', '%')
+        for name in sorted(self.times, key=self.times.get, reverse=True):
+            calls = self.calls[name]
+            time = self.times[name]
+            msg += '%-30s %10d %12.4f %12.3e %7.2f\n' % \
+                   (name, calls, time, time/calls,
+                    100.0*time/total if total > 0 else 0.0)
+        msg += '%-30s %10s %12.4f\n' % ('total', '', total)
+
+        if self.counts:
+            msg += self.counter_statistics()
+
+        return msg
+
+    def counter_statistics(self):
+        """Table of the hardware counts of each of the kernel_steps, with
+        instructions per cycle and instructions per byte moved, as a string
+        """
+
+        msg = '%-30s %14s %14s %6s %12s %14s %10s\n' % \
+              ('kernel', 'cycles', 'instructions', 'IPC', 'LLC misses',
+               'bytes', 'instr/byte')
+        for name in sorted(self.counts, key=self.times.get, reverse=True):
+            cycles, instructions, misses = self.counts[name]
+            nbytes = misses*cache_line_size
+            msg += '%-30s %14d %14d %6.2f %12d %14d %10.2f\n' % \
+                   (name, cycles, instructions,
+                    float(instructions)/cycles if cycles > 0 else 0.0,
+                    misses, nbytes,
+                    float(instructions)/nbytes if nbytes > 0 else 0.0)
+
+        return msg
+
+    def dump(self, filename, **kwargs):
+        """Write the statistics, and any given keyword values, to filename
+        as JSON
+        """
+
+        data = dict(kwargs)
+        data['kernels'] = self.get_statistics()
+
+        with open(filename, 'w') as fid:
+            json.dump(data, fid, indent=2, sort_keys=True)
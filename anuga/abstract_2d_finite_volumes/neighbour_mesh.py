@@ -78,19 +78,35 @@ class Mesh(General_mesh):
                  tagged_elements=None,
                  geo_reference=None,
                  use_inscribed_circle=False,
+                 ordering=None,
                  verbose=False):
         """
         Build Mesh
 
             Input x,y coordinates (sequence of 2-tuples or Mx2 numeric array of floats)
             triangles (sequence of 3-tuples or Nx3 numeric array of non-negative integers).
+            ordering: None, 'hilbert' or 'morton' (see General_mesh). The
+            boundary and tagged_elements refer to the supplied triangle ids
+            and are renumbered with the triangles.
         """
 
         General_mesh.__init__(self, coordinates, triangles,
                               geo_reference=geo_reference,
                               use_inscribed_circle=use_inscribed_circle,
+                              ordering=ordering,
                               verbose=verbose)
 
+        if self.triangle_permutation is not None:
+            inverse_triangle_permutation = num.argsort(self.triangle_permutation)
+
+            if boundary is not None:
+                boundary = dict(((int(inverse_triangle_permutation[vol_id]), edge_id), tag)
+                                for (vol_id, edge_id), tag in boundary.items())
+
+            if tagged_elements is not None:
+                tagged_elements = dict((tag, inverse_triangle_permutation[num.array(elements, int)])
+                                       for tag, elements in tagged_elements.items())
+
         if verbose: log.critical('Mesh: Initialising')
 
         N = len(self) #Number_of_triangles
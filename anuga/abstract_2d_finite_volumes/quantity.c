@@ -10,6 +10,7 @@
 // Ole Nielsen, GA 2004
 
 #include "math.h"
+#include <string.h>
 
 //Shared code snippets
 #include "util_ext.h"
@@ -983,3 +984,258 @@ int _min_and_max_centroid_values(keyint N,
 
 
 
+
+
+//-------------------------------------------
+// Fused kernels for several quantities
+//
+// These do what the single quantity kernels above do for each of the
+// nq quantities whose arrays are given as arrays of pointers, in one
+// sweep over each array instead of one sweep per step, and with the same
+// operations in the same order, so the results are identical. The loops
+// are threaded if multiprocessor_mode == 1, and written without early
+// returns so that they can be vectorised.
+//-------------------------------------------
+
+int _update_quantities(keyint N,
+		       keyint nq,
+		       double timestep,
+		       double** centroid_values,
+		       double** explicit_update,
+		       double** semi_implicit_update,
+		       int multiprocessor_mode) {
+	// As _update for each quantity. Returns -1 if a semi implicit
+	// denominator was not positive (the values are then not usable)
+
+	keyint q;
+	int error = 0;
+
+	#pragma omp parallel private(q) if(multiprocessor_mode == 1)
+	for (q=0; q<nq; q++) {
+		double* cv = centroid_values[q];
+		double* eu = explicit_update[q];
+		double* si = semi_implicit_update[q];
+		keyint k;
+
+		#pragma omp for simd schedule(static) reduction(|:error) nowait
+		for (k=0; k<N; k++) {
+			double x, s, denominator;
+
+			// Divide semi_implicit update by conserved quantity
+			x = cv[k];
+			s = (x == 0.0) ? 0.0 : si[k]/x;
+
+			// Explicit and semi implicit updates
+			denominator = 1.0 - timestep*s;
+			error |= (denominator <= 0.0);
+			cv[k] = (x + timestep*eu[k])/denominator;
+
+			// Reset semi_implicit_update ready for next time step
+			si[k] = 0.0;
+		}
+	}
+
+	return error ? -1 : 0;
+}
+
+
+int _backup_quantities(keyint N,
+		       keyint nq,
+		       double** centroid_values,
+		       double** centroid_backup_values,
+		       int multiprocessor_mode) {
+
+	keyint q;
+
+	#pragma omp parallel private(q) if(multiprocessor_mode == 1)
+	for (q=0; q<nq; q++) {
+		double* cv = centroid_values[q];
+		double* bv = centroid_backup_values[q];
+		keyint k;
+
+		#pragma omp for simd schedule(static) nowait
+		for (k=0; k<N; k++) {
+			bv[k] = cv[k];
+		}
+	}
+
+	return 0;
+}
+
+
+int _saxpy_quantities(keyint N,
+		      keyint nq,
+		      double a,
+		      double b,
+		      double** centroid_values,
+		      double** centroid_backup_values,
+		      int multiprocessor_mode) {
+
+	keyint q;
+
+	#pragma omp parallel private(q) if(multiprocessor_mode == 1)
+	for (q=0; q<nq; q++) {
+		double* cv = centroid_values[q];
+		double* bv = centroid_backup_values[q];
+		keyint k;
+
+		#pragma omp for simd schedule(static) nowait
+		for (k=0; k<N; k++) {
+			cv[k] = a*cv[k] + b*bv[k];
+		}
+	}
+
+	return 0;
+}
+
+
+int _extrapolate_quantities_from_gradient(keyint N,
+					  keyint nq,
+					  double* centroids,
+					  double* vertex_coordinates,
+					  double** centroid_values,
+					  double** vertex_values,
+					  double** edge_values,
+					  double** x_gradient,
+					  double** y_gradient,
+					  int multiprocessor_mode) {
+	// As _extrapolate_from_gradient, with the vertex offsets of each
+	// triangle computed once for all quantities
+
+	keyint k;
+
+	#pragma omp parallel for schedule(static) if(multiprocessor_mode == 1)
+	for (k=0; k<N; k++) {
+		keyint q, k2 = 2*k, k3 = 3*k, k6 = 6*k;
+		double x, y, dx0, dy0, dx1, dy1, dx2, dy2;
+
+		x = centroids[k2]; y = centroids[k2+1];
+
+		dx0 = vertex_coordinates[k6 + 0] - x;
+		dy0 = vertex_coordinates[k6 + 1] - y;
+		dx1 = vertex_coordinates[k6 + 2] - x;
+		dy1 = vertex_coordinates[k6 + 3] - y;
+		dx2 = vertex_coordinates[k6 + 4] - x;
+		dy2 = vertex_coordinates[k6 + 5] - y;
+
+		for (q=0; q<nq; q++) {
+			double qc = centroid_values[q][k];
+			double a = x_gradient[q][k];
+			double b = y_gradient[q][k];
+			double* qv = vertex_values[q] + k3;
+			double* qe = edge_values[q] + k3;
+			double v0, v1, v2;
+
+			// Extrapolate to Vertices
+			v0 = qc + a*dx0 + b*dy0;
+			v1 = qc + a*dx1 + b*dy1;
+			v2 = qc + a*dx2 + b*dy2;
+
+			qv[0] = v0;
+			qv[1] = v1;
+			qv[2] = v2;
+
+			// Extrapolate to Edges (midpoints)
+			qe[0] = 0.5*(v1 + v2);
+			qe[1] = 0.5*(v2 + v0);
+			qe[2] = 0.5*(v0 + v1);
+		}
+	}
+
+	return 0;
+}
+
+
+// Limit the edge jumps of one quantity on triangle k by the centroid
+// values of its neighbours, as _limit_edges_by_neighbour
+// (boundary_neighbours == 1) or _limit_gradient_by_neighbour (0)
+static inline void _limit_quantity_by_neighbour(keyint k, double beta,
+		double* centroid_values, double* vertex_values,
+		double* edge_values, long* neighbours, int boundary_neighbours) {
+
+	keyint i, k3 = 3*k, n;
+	double qmin, qmax, qn, qc, dq, dqa[3], phi, r;
+
+	qc = centroid_values[k];
+	phi = 1.0;
+
+	for (i=0; i<3; i++) {
+		dq = edge_values[k3+i] - qc;
+		dqa[i] = dq;
+
+		n = neighbours[k3+i];
+		if (n >= 0 || boundary_neighbours) {
+			qn = (n >= 0) ? centroid_values[n] : qc;
+
+			qmin = min(qc, qn);
+			qmax = max(qc, qn);
+
+			r = 1.0;
+
+			if (dq > 0.0) r = (qmax - qc)/dq;
+			if (dq < 0.0) r = (qmin - qc)/dq;
+
+			phi = min( min(r*beta, 1.0), phi);
+		}
+	}
+
+	//Update edge and vertex values using phi limiter
+	edge_values[k3+0] = qc + phi*dqa[0];
+	edge_values[k3+1] = qc + phi*dqa[1];
+	edge_values[k3+2] = qc + phi*dqa[2];
+
+	vertex_values[k3+0] = edge_values[k3+1] + edge_values[k3+2] - edge_values[k3+0];
+	vertex_values[k3+1] = edge_values[k3+2] + edge_values[k3+0] - edge_values[k3+1];
+	vertex_values[k3+2] = edge_values[k3+0] + edge_values[k3+1] - edge_values[k3+2];
+}
+
+
+int _limit_quantities_by_neighbour(keyint N,
+				   keyint nq,
+				   double beta,
+				   double** centroid_values,
+				   double** vertex_values,
+				   double** edge_values,
+				   long* neighbours,
+				   int boundary_neighbours,
+				   int multiprocessor_mode) {
+	// _limit_edges_by_neighbour (boundary_neighbours == 1) or
+	// _limit_gradient_by_neighbour (boundary_neighbours == 0) for each
+	// quantity, in one sweep over the triangles
+
+	keyint k;
+
+	#pragma omp parallel for schedule(static) if(multiprocessor_mode == 1)
+	for (k=0; k<N; k++) {
+		keyint q;
+		for (q=0; q<nq; q++) {
+			_limit_quantity_by_neighbour(k, beta, centroid_values[q],
+					vertex_values[q], edge_values[q], neighbours,
+					boundary_neighbours);
+		}
+	}
+
+	return 0;
+}
+
+
+int _first_touch_copy(keyint N,
+		      keyint nbytes_per_triangle,
+		      char* destination,
+		      char* source) {
+	// Copy the nbytes_per_triangle bytes of each of the N triangles
+	// from source to (untouched) destination, with the static schedule
+	// over triangles used by the threaded kernels. Each page of
+	// destination is then first touched, and so placed on the NUMA node
+	// of, the thread that later works on its triangles.
+
+	keyint k;
+
+	#pragma omp parallel for schedule(static)
+	for (k=0; k<N; k++) {
+		memcpy(destination + k*nbytes_per_triangle,
+		       source + k*nbytes_per_triangle, nbytes_per_triangle);
+	}
+
+	return 0;
+}
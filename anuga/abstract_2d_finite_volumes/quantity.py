@@ -25,6 +25,10 @@ class Quantity(object):
 
     counter = 0
 
+    # Set when the vertex values are out of date with the edge values
+    # (see Domain.set_lazy_vertex_values)
+    vertex_values_stale = False
+
     def __init__(self, domain, vertex_values=None, name=None, register=False):
         """Create Quantity object
         
@@ -113,6 +117,21 @@ class Quantity(object):
         if register:
             self.domain.quantities[self.name] = self
 
+    @property
+    def vertex_values(self):
+        """N x 3 array of values at the vertices of each element, computed
+        from the edge values first if they are out of date.
+        """
+
+        if self.vertex_values_stale:
+            self.domain.compute_vertex_values()
+        return self._vertex_values
+
+    @vertex_values.setter
+    def vertex_values(self, values):
+        self._vertex_values = values
+        self.vertex_values_stale = False
+
     ############################################################################
     # Methods for operator overloading
     ############################################################################
@@ -616,7 +635,7 @@ class Quantity(object):
 
         vol_id  = self.domain.boundary_cells
         edge_id = self.domain.boundary_edges
-        self.boundary_values = (self.edge_values.flat)[3*vol_id+edge_id]
+        self.boundary_values[:] = (self.edge_values.flat)[3*vol_id+edge_id]
 
     ##
     # @brief Set boundary values using a function
@@ -690,20 +709,37 @@ class Quantity(object):
         Pre-condition: vertex_values have been set
         """
         from .quantity_ext import interpolate
-        interpolate(self)
+        self._call_with_double_vertex_values(interpolate)
 
 
     def interpolate_from_vertices_to_edges(self):
         # Call correct module function (either from this module or C-extension)
 
         from .quantity_ext import interpolate_from_vertices_to_edges
-        interpolate_from_vertices_to_edges(self)
+        self._call_with_double_vertex_values(interpolate_from_vertices_to_edges)
 
     def interpolate_from_edges_to_vertices(self):
         # Call correct module function (either from this module or C-extension)
 
         from .quantity_ext import interpolate_from_edges_to_vertices
-        interpolate_from_edges_to_vertices(self)
+        self._call_with_double_vertex_values(interpolate_from_edges_to_vertices)
+
+    def _call_with_double_vertex_values(self, function, *args):
+        """Call the C extension function(self, *args), which expects double
+        precision vertex values, also when they are stored in single precision
+        (see Domain.set_vertex_output_precision).
+        """
+
+        vertex_values = self.vertex_values
+        if vertex_values.dtype == float:
+            return function(self, *args)
+
+        self.vertex_values = vertex_values.astype(float)
+        try:
+            return function(self, *args)
+        finally:
+            vertex_values[:] = self.vertex_values
+            self.vertex_values = vertex_values
 
     #---------------------------------------------
     # Public interface for setting quantity values
@@ -2039,7 +2075,8 @@ class Quantity(object):
                 hasattr(self.domain.mesh, 'node_index')):
             self.build_inverted_triangle_structure()
 
-        set_vertex_values_c(self, num.array(vertex_list), A)
+        self._call_with_double_vertex_values(set_vertex_values_c,
+                                             num.array(vertex_list), A)
         self.interpolate()
 
     def smooth_vertex_values(self, use_cache=False, verbose=False):
@@ -2110,7 +2147,7 @@ class Quantity(object):
                 else:
                     average_vertex_values(ensure_numeric(self.domain.vertex_value_indices),
                                       ensure_numeric(self.domain.number_of_triangles_per_node),
-                                      ensure_numeric(self.vertex_values),
+                                      ensure_numeric(self.vertex_values, float),
                                       A)
                 A = A.astype(precision)
             else:
@@ -2225,13 +2262,13 @@ class Quantity(object):
     def compute_gradients(self):
         # Call correct module function
         # (either from this module or C-extension)
-        return compute_gradients(self)
+        return self._call_with_double_vertex_values(compute_gradients)
 
 
     def compute_local_gradients(self):
         # Call correct module function
         # (either from this module or C-extension)
-        return compute_local_gradients(self)
+        return self._call_with_double_vertex_values(compute_local_gradients)
 
 
 
@@ -2239,43 +2276,43 @@ class Quantity(object):
     def limit(self):
         # Call correct module depending on whether
         # basing limit calculations on edges or vertices
-        limit_old(self)
+        self._call_with_double_vertex_values(limit_old)
 
     def limit_vertices_by_all_neighbours(self):
         # Call correct module function
         # (either from this module or C-extension)
-        limit_vertices_by_all_neighbours(self)
+        self._call_with_double_vertex_values(limit_vertices_by_all_neighbours)
 
     def limit_edges_by_all_neighbours(self):
         # Call correct module function
         # (either from this module or C-extension)
-        limit_edges_by_all_neighbours(self)
+        self._call_with_double_vertex_values(limit_edges_by_all_neighbours)
 
     def limit_edges_by_neighbour(self):
         # Call correct module function
         # (either from this module or C-extension)
-        limit_edges_by_neighbour(self)
+        self._call_with_double_vertex_values(limit_edges_by_neighbour)
 
     def extrapolate_second_order(self):
         # Call correct module function
         # (either from this module or C-extension)
-        compute_gradients(self)
-        extrapolate_from_gradient(self)
+        self._call_with_double_vertex_values(compute_gradients)
+        self._call_with_double_vertex_values(extrapolate_from_gradient)
 
     def extrapolate_second_order_and_limit_by_edge(self):
         # Call correct module function
         # (either from this module or C-extension)
-        extrapolate_second_order_and_limit_by_edge(self)
+        self._call_with_double_vertex_values(extrapolate_second_order_and_limit_by_edge)
 
     def extrapolate_second_order_and_limit_by_vertex(self):
         # Call correct module function
         # (either from this module or C-extension)
-        extrapolate_second_order_and_limit_by_vertex(self)
+        self._call_with_double_vertex_values(extrapolate_second_order_and_limit_by_vertex)
 
     def bound_vertices_below_by_constant(self, bound):
         # Call correct module function
         # (either from this module or C-extension)
-        bound_vertices_below_by_constant(self, bound)
+        self._call_with_double_vertex_values(bound_vertices_below_by_constant, bound)
 
     def bound_vertices_below_by_quantity(self, quantity):
         # Call correct module function
@@ -2283,7 +2320,7 @@ class Quantity(object):
 
         # check consistency
         assert self.domain == quantity.domain
-        bound_vertices_below_by_quantity(self, quantity)
+        self._call_with_double_vertex_values(bound_vertices_below_by_quantity, quantity)
 
     def backup_centroid_values(self):
         # Call correct module function
@@ -0,0 +1,189 @@
+"""Pack the arrays of the quantities of a domain into one block of memory.
+
+Each Quantity allocates its own arrays, so a domain with a dozen
+quantities has more than a hundred separate arrays on the heap. A
+Quantity_arena allocates one anonymous memory map for all of them,
+with every array starting on a 64 byte (cache line) boundary, copies
+the values across and rebinds the quantity attributes to views of the
+block. Pages of the block are only placed when first written, and
+large blocks are marked as candidates for transparent huge pages.
+
+The arrays are laid out either quantity by quantity (policy 'quantity':
+all arrays of stage, then all arrays of xmomentum, ...) or array by
+array (policy 'array': the centroid values of all quantities, then the
+edge values of all quantities, ...). The layout is available as byte
+offsets into the block, so that a kernel can be given the block and
+offsets rather than one pointer per array.
+
+On NUMA machines a page is placed on the node of the thread that first
+writes it. Given the number of triangles, the arrays are copied into
+the block by the threads of the OpenMP kernels, each thread copying the
+triangles the kernels' static schedule gives it (first_touch_copy in
+quantity_ext), so that pages end up next to the threads using them.
+first_touch_array does the same for a single array.
+"""
+
+import mmap
+
+import numpy as num
+
+
+# Arrays allocated by Quantity.__init__, in the order they are packed
+quantity_array_names = ['centroid_values', 'edge_values', 'vertex_values',
+                        'boundary_values', 'explicit_update',
+                        'semi_implicit_update', 'centroid_backup_values',
+                        'x_gradient', 'y_gradient', 'phi']
+
+arena_policies = ['quantity', 'array']
+
+# Cache line and (x86) huge page sizes
+alignment = 64
+huge_page_size = 2*1024*1024
+
+
+def _align(nbytes):
+    return (nbytes + alignment - 1)//alignment*alignment
+
+
+def _allocate(nbytes):
+    """Anonymous memory map of nbytes and a byte array view of it"""
+
+    # Anonymous maps are page aligned and zero filled on first touch
+    buffer = mmap.mmap(-1, max(nbytes, 1))
+    if nbytes >= huge_page_size and hasattr(mmap, 'MADV_HUGEPAGE'):
+        try:
+            buffer.madvise(mmap.MADV_HUGEPAGE)
+        except (AttributeError, OSError):
+            pass
+
+    return buffer, num.frombuffer(buffer, dtype=num.uint8)[:nbytes]
+
+
+def _copy(destination, source, number_of_elements=None):
+    """Copy source to destination, in parallel by triangle if the
+    number_of_elements is given
+    """
+
+    if number_of_elements is None or source.size == 0:
+        destination[...] = source
+        return
+
+    from anuga.abstract_2d_finite_volumes.quantity_ext import first_touch_copy
+
+    # Arrays not indexed by triangle (e.g. boundary values) by row
+    n = number_of_elements
+    if len(source) % n != 0:
+        n = len(source)
+
+    first_touch_copy(destination, num.ascontiguousarray(source), n)
+
+
+def first_touch_array(A, number_of_elements):
+    """Copy of array A in newly mapped memory, first written by the
+    threads of the OpenMP kernels (see module documentation)
+    """
+
+    buffer, base = _allocate(A.nbytes)
+    B = base.view(A.dtype).reshape(A.shape)
+    _copy(B, A, number_of_elements)
+
+    return B
+
+
+class Quantity_arena(object):
+    """One contiguous, aligned allocation for the arrays of the given
+    quantities (dictionary of Quantity objects keyed by name), first
+    written by the OpenMP threads if the number_of_elements is given
+    """
+
+    def __init__(self, quantities, policy='quantity', number_of_elements=None):
+
+        if policy not in arena_policies:
+            msg = 'Unknown quantity arena policy %s. Possible choices are: %s' \
+                  % (str(policy), ', '.join(arena_policies))
+            raise ValueError(msg)
+
+        self.policy = policy
+        self.quantities = quantities
+        self.quantity_names = sorted(quantities.keys())
+        self.number_of_elements = number_of_elements
+
+        # Byte offset of each array in the block
+        self.offsets = {}
+        nbytes = 0
+        for name, array_name in self._layout():
+            A = getattr(quantities[name], array_name)
+            nbytes = _align(nbytes)
+            self.offsets[(name, array_name)] = nbytes
+            nbytes += A.nbytes
+        self.nbytes = max(_align(nbytes), alignment)
+
+        self._pack()
+
+    def _layout(self):
+        """(quantity name, array name) of the arrays in the order of the
+        block
+        """
+
+        if self.policy == 'quantity':
+            return [(name, array_name) for name in self.quantity_names
+                    for array_name in quantity_array_names]
+        else:
+            return [(name, array_name) for array_name in quantity_array_names
+                    for name in self.quantity_names]
+
+    def _pack(self):
+        """Map a new block, copy the quantity arrays into it and rebind
+        them to views of the block
+        """
+
+        self.buffer, self.base = _allocate(self.nbytes)
+
+        for name, array_name in self._layout():
+            Q = self.quantities[name]
+            A = getattr(Q, array_name)
+            offset = self.offsets[(name, array_name)]
+            view = self.base[offset:offset + A.nbytes].view(A.dtype).reshape(A.shape)
+            _copy(view, A, self.number_of_elements)
+            setattr(Q, array_name, view)
+
+    def __getstate__(self):
+        """Pickle (e.g. for checkpointing) without the memory map. The
+        quantities pickle their own arrays, as copies of the block.
+        """
+
+        state = self.__dict__.copy()
+        del state['buffer']
+        del state['base']
+
+        return state
+
+    def __setstate__(self, state):
+        """Map a new block for the unpickled quantities and move their
+        arrays into it
+        """
+
+        self.__dict__.update(state)
+        self._pack()
+
+    def get_offset(self, name, array_name):
+        """Byte offset of array_name of quantity name from the start of
+        the block
+        """
+
+        return self.offsets[(name, array_name)]
+
+    def get_nbytes(self):
+        """Size of the block in bytes
+        """
+
+        return self.nbytes
+
+
+def unpack_quantity_arrays(quantities):
+    """Give each quantity its own copy of its arrays again
+    """
+
+    for Q in quantities.values():
+        for array_name in quantity_array_names:
+            setattr(Q, array_name, getattr(Q, array_name).copy())
@@ -5,6 +5,8 @@ import cython
 import numpy as np
 cimport numpy as np
 
+from libc.stdlib cimport malloc, free
+
 ctypedef long keyint
 
 # declare the interface to the C code
@@ -29,6 +31,12 @@ cdef extern from "quantity.c":
   int _average_centroid_values(keyint N, long* vertex_value_indices, long* number_of_triangles_per_node, double* centroid_values, double* A)
   int _set_vertex_values_c(keyint num_verts, long* vertices, long* node_index, long* number_of_triangles_per_node, long* vertex_value_indices, double* vertex_values, double* A)
   int _min_and_max_centroid_values(keyint N, double* qc, double* qv, long* neighbours, double* qmin, double* qmax)
+  int _update_quantities(keyint N, keyint nq, double timestep, double** centroid_values, double** explicit_update, double** semi_implicit_update, int multiprocessor_mode)
+  int _backup_quantities(keyint N, keyint nq, double** centroid_values, double** centroid_backup_values, int multiprocessor_mode)
+  int _saxpy_quantities(keyint N, keyint nq, double a, double b, double** centroid_values, double** centroid_backup_values, int multiprocessor_mode)
+  int _extrapolate_quantities_from_gradient(keyint N, keyint nq, double* centroids, double* vertex_coordinates, double** centroid_values, double** vertex_values, double** edge_values, double** x_gradient, double** y_gradient, int multiprocessor_mode)
+  int _limit_quantities_by_neighbour(keyint N, keyint nq, double beta, double** centroid_values, double** vertex_values, double** edge_values, long* neighbours, int boundary_neighbours, int multiprocessor_mode)
+  int _first_touch_copy(keyint N, keyint nbytes_per_triangle, char* destination, char* source)
 
 cdef extern from "util_ext.h":
   void _limit_old(int N, double beta, double* qc, double* qv, double* qmin, double* qmax)
@@ -714,3 +722,154 @@ def limit_gradient_by_neighbour(object quantity):
 
   assert err == 0, "Internal function _limit_gradient_by_neighbour failed"
 
+
+#===============================================================================
+# Fused kernels for several quantities of a domain
+#===============================================================================
+
+cdef class _Quantity_pointers:
+  """Arrays of pointers to the named array of each of a list of
+  quantities, for the fused kernels of quantity.c"""
+
+  cdef double** p
+  cdef keyint nq
+  cdef list arrays
+
+  def __cinit__(self, list quantities, str name):
+
+    cdef np.ndarray values
+    cdef keyint q
+
+    self.nq = len(quantities)
+    self.arrays = []
+    self.p = <double**> malloc(max(self.nq, 1)*sizeof(double*))
+    if self.p == NULL:
+      raise MemoryError()
+
+    for q in range(self.nq):
+      values = getattr(quantities[q], name)
+      assert values.dtype == np.float64 and values.flags['C_CONTIGUOUS'], \
+             'Quantity %s must be a C contiguous array of doubles' % name
+      self.arrays.append(values)
+      self.p[q] = <double*> np.PyArray_DATA(values)
+
+  def __dealloc__(self):
+    free(self.p)
+
+
+def _get_quantities(object domain, object names):
+
+  if names is None:
+    names = domain.conserved_quantities
+
+  return [domain.quantities[name] for name in names]
+
+
+def update_quantities(object domain, double timestep, object names=None):
+  """Update centroid values of the named (default conserved) quantities
+  of the domain as update does for each of them, in one call
+  """
+
+  cdef list quantities = _get_quantities(domain, names)
+  cdef _Quantity_pointers centroid_values = _Quantity_pointers(quantities, 'centroid_values')
+  cdef _Quantity_pointers explicit_update = _Quantity_pointers(quantities, 'explicit_update')
+  cdef _Quantity_pointers semi_implicit_update = _Quantity_pointers(quantities, 'semi_implicit_update')
+  cdef keyint N = domain.number_of_elements
+  cdef int multiprocessor_mode = domain.multiprocessor_mode
+  cdef int err
+
+  err = _update_quantities(N, centroid_values.nq, timestep, centroid_values.p,
+                           explicit_update.p, semi_implicit_update.p,
+                           multiprocessor_mode)
+
+  assert err == 0, "quantity_ext.c: update, division by zero in semi implicit update - call Stephen :)"
+
+
+def backup_quantities(object domain, object names=None):
+  """Backup centroid values of the named (default conserved) quantities"""
+
+  cdef list quantities = _get_quantities(domain, names)
+  cdef _Quantity_pointers centroid_values = _Quantity_pointers(quantities, 'centroid_values')
+  cdef _Quantity_pointers centroid_backup_values = _Quantity_pointers(quantities, 'centroid_backup_values')
+  cdef keyint N = domain.number_of_elements
+  cdef int multiprocessor_mode = domain.multiprocessor_mode
+
+  _backup_quantities(N, centroid_values.nq, centroid_values.p,
+                     centroid_backup_values.p, multiprocessor_mode)
+
+
+def saxpy_quantities(object domain, double a, double b, object names=None):
+  """centroid_values = a*centroid_values + b*centroid_backup_values for
+  the named (default conserved) quantities"""
+
+  cdef list quantities = _get_quantities(domain, names)
+  cdef _Quantity_pointers centroid_values = _Quantity_pointers(quantities, 'centroid_values')
+  cdef _Quantity_pointers centroid_backup_values = _Quantity_pointers(quantities, 'centroid_backup_values')
+  cdef keyint N = domain.number_of_elements
+  cdef int multiprocessor_mode = domain.multiprocessor_mode
+
+  _saxpy_quantities(N, centroid_values.nq, a, b, centroid_values.p,
+                    centroid_backup_values.p, multiprocessor_mode)
+
+
+def extrapolate_quantities_from_gradient(object domain, object names=None):
+  """extrapolate_from_gradient for the named (default conserved) quantities"""
+
+  cdef list quantities = _get_quantities(domain, names)
+  cdef _Quantity_pointers centroid_values = _Quantity_pointers(quantities, 'centroid_values')
+  cdef _Quantity_pointers vertex_values = _Quantity_pointers(quantities, 'vertex_values')
+  cdef _Quantity_pointers edge_values = _Quantity_pointers(quantities, 'edge_values')
+  cdef _Quantity_pointers x_gradient = _Quantity_pointers(quantities, 'x_gradient')
+  cdef _Quantity_pointers y_gradient = _Quantity_pointers(quantities, 'y_gradient')
+  cdef np.ndarray[double, ndim=2, mode="c"] centroids = domain.centroid_coordinates
+  cdef np.ndarray[double, ndim=2, mode="c"] vertex_coordinates = domain.vertex_coordinates
+  cdef keyint N = domain.number_of_elements
+  cdef int multiprocessor_mode = domain.multiprocessor_mode
+
+  _extrapolate_quantities_from_gradient(N, centroid_values.nq,
+                                        &centroids[0,0], &vertex_coordinates[0,0],
+                                        centroid_values.p, vertex_values.p,
+                                        edge_values.p, x_gradient.p, y_gradient.p,
+                                        multiprocessor_mode)
+
+
+def _limit_quantities_by_neighbour_ext(object domain, object names, int boundary_neighbours):
+
+  cdef list quantities = _get_quantities(domain, names)
+  cdef _Quantity_pointers centroid_values = _Quantity_pointers(quantities, 'centroid_values')
+  cdef _Quantity_pointers vertex_values = _Quantity_pointers(quantities, 'vertex_values')
+  cdef _Quantity_pointers edge_values = _Quantity_pointers(quantities, 'edge_values')
+  cdef np.ndarray[long, ndim=2, mode="c"] neighbours = domain.neighbours
+  cdef double beta_w = domain.beta_w
+  cdef keyint N = domain.number_of_elements
+  cdef int multiprocessor_mode = domain.multiprocessor_mode
+
+  _limit_quantities_by_neighbour(N, centroid_values.nq, beta_w,
+                                 centroid_values.p, vertex_values.p,
+                                 edge_values.p, &neighbours[0,0],
+                                 boundary_neighbours, multiprocessor_mode)
+
+
+def limit_edges_of_quantities_by_neighbour(object domain, object names=None):
+  """limit_edges_by_neighbour for the named (default conserved) quantities"""
+
+  _limit_quantities_by_neighbour_ext(domain, names, 1)
+
+
+def limit_gradient_of_quantities_by_neighbour(object domain, object names=None):
+  """limit_gradient_by_neighbour for the named (default conserved) quantities"""
+
+  _limit_quantities_by_neighbour_ext(domain, names, 0)
+
+
+def first_touch_copy(np.ndarray destination not None, np.ndarray source not None, keyint N):
+  """Copy source to destination (same size, C contiguous) in N equal
+  parts, one per triangle, split between threads as in the threaded
+  kernels (see quantity_arena.first_touch_array)"""
+
+  assert destination.flags['C_CONTIGUOUS'] and source.flags['C_CONTIGUOUS']
+  assert destination.nbytes == source.nbytes
+  assert N > 0 and source.nbytes % N == 0
+
+  _first_touch_copy(N, source.nbytes//N, <char*> np.PyArray_DATA(destination),
+                    <char*> np.PyArray_DATA(source))
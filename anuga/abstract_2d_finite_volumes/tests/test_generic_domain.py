@@ -360,6 +360,100 @@ class Test_Domain(unittest.TestCase):
 
 
                                       
+    def test_quantity_arena(self):
+        """Quantity arrays packed into one aligned block keep their values
+        """
+
+        from anuga.abstract_2d_finite_volumes.quantity_arena import \
+            quantity_array_names
+
+        a = [0.0, 0.0]
+        b = [0.0, 2.0]
+        c = [2.0,0.0]
+        d = [0.0, 4.0]
+        e = [2.0, 2.0]
+        f = [4.0,0.0]
+
+        points = [a, b, c, d, e, f]
+        #bac, bce, ecf, dbe
+        vertices = [ [1,0,2], [1,2,4], [4,2,5], [3,1,4]]
+
+        domain = Generic_Domain(points, vertices, boundary=None,
+                        conserved_quantities =\
+                        ['stage', 'xmomentum', 'ymomentum'],
+                        other_quantities = ['elevation', 'friction', 'depth'])
+
+        domain.set_quantity('stage', [[1,2,3], [5,5,5],
+                                      [0,0,9], [-6, 3, 3]])
+        domain.set_quantity('elevation', -1)
+        domain.quantities['stage'].explicit_update[:] = [1, 2, 3, 4]
+
+        values = {}
+        for name, Q in domain.quantities.items():
+            for array_name in quantity_array_names:
+                values[(name, array_name)] = getattr(Q, array_name).copy()
+
+        for policy in ['quantity', 'array', None, 'array']:
+            domain.set_quantity_arena(policy)
+            arena = domain.get_quantity_arena()
+
+            for name, Q in domain.quantities.items():
+                for array_name in quantity_array_names:
+                    A = getattr(Q, array_name)
+                    assert num.all(A == values[(name, array_name)])
+                    assert A.flags['C_CONTIGUOUS']
+                    if policy is None:
+                        assert A.base is None
+                    else:
+                        offset = arena.get_offset(name, array_name)
+                        assert A.ctypes.data == arena.base.ctypes.data + offset
+                        assert A.ctypes.data % 64 == 0
+
+            if policy is None:
+                assert arena is None
+                continue
+
+            # Layout of the block
+            assert arena.policy == policy
+            assert arena.get_nbytes() % 64 == 0
+            if policy == 'quantity':
+                assert arena.get_offset('stage', 'phi') < \
+                       arena.get_offset('xmomentum', 'centroid_values')
+            else:
+                assert arena.get_offset('xmomentum', 'centroid_values') < \
+                       arena.get_offset('stage', 'edge_values')
+
+        # Writes go to the block
+        domain.set_quantity('xmomentum', 2.0)
+        offset = arena.get_offset('xmomentum', 'centroid_values')
+        assert num.all(arena.base[offset:offset+32].view(float) == 2.0)
+
+        try:
+            domain.set_quantity_arena('unknown')
+        except ValueError:
+            pass
+        else:
+            raise Exception('Unknown arena policy should raise ValueError')
+
+        # Pickled (checkpointed) without the memory map, unpickled into a
+        # new block
+        import pickle
+        domain_2 = pickle.loads(pickle.dumps(domain))
+        arena_2 = domain_2.get_quantity_arena()
+        assert arena_2.policy == 'array'
+        assert arena_2.base.ctypes.data != arena.base.ctypes.data
+        for name, Q in domain_2.quantities.items():
+            for array_name in quantity_array_names:
+                A = getattr(Q, array_name)
+                assert num.all(A == getattr(domain.quantities[name], array_name))
+                offset = arena_2.get_offset(name, array_name)
+                assert A.ctypes.data == arena_2.base.ctypes.data + offset
+
+        domain_2.set_quantity('xmomentum', 3.0)
+        offset = arena_2.get_offset('xmomentum', 'centroid_values')
+        assert num.all(arena_2.base[offset:offset+32].view(float) == 3.0)
+        assert num.all(domain.quantities['xmomentum'].centroid_values == 2.0)
+
     def test_add_quantity(self):
         """Test that quantities already set can be added to using
         add_quantity
@@ -958,6 +1052,57 @@ class Test_Domain(unittest.TestCase):
         #Test that points are arranged in a counter clock wise order
         domain.check_integrity()
 
+    def test_ghost_exchange_period(self):
+        """Ghost exchanges are skipped while the ghost layer is deep
+        enough for the euler substeps
+        """
+
+        points, vertices, boundary = anuga.rectangular_cross(4, 4)
+
+        def exchanges(ghost_layer_width, method, period, steps=4):
+            domain = Generic_Domain(points, vertices, boundary,
+                                    ghost_layer_width=ghost_layer_width)
+            domain.set_timestepping_method(method)
+            domain.set_ghost_exchange_period(period)
+            domain.yieldtime = 1.0
+
+            result = []
+            for step in range(steps):
+                for substep in range(1, domain.timestep_fluxcalls):
+                    if domain.ghost_exchange_due(substep):
+                        domain.record_ghost_exchange(substep)
+                        result.append(substep)
+                domain.advance_ghost_layers()
+                if domain.ghost_exchange_due_at_step_end():
+                    domain.record_ghost_exchange()
+                    result.append(0)
+            return result
+
+        # The default ghost layer exchanges as before
+        assert exchanges(2, 'euler', 1) == [0, 0, 0, 0]
+        assert exchanges(2, 'rk2', 1) == [1, 0]*4
+        assert exchanges(4, 'rk2', 1) == [0]*4
+        assert exchanges(2, 'rk3', 1) == [1, 2, 0]*4
+
+        # Deep ghost layers
+        assert exchanges(4, 'euler', 2) == [0, 0]
+        assert exchanges(8, 'rk2', 4) == [0, 0]
+        assert exchanges(8, 'rk2', 3) == [0, 0]
+        assert exchanges(6, 'rk3', 4) == [0]*4
+        assert exchanges(12, 'rk3', 2) == [0, 0]
+
+        # Too shallow for the period
+        assert exchanges(4, 'rk3', 2) == [2, 0]*4
+
+        # Exchanged at the yield time
+        domain = Generic_Domain(points, vertices, boundary, ghost_layer_width=8)
+        domain.set_ghost_exchange_period(4)
+        domain.yieldtime = 0.0
+        domain.advance_ghost_layers()
+        assert domain.ghost_exchange_due_at_step_end()
+
+        self.assertRaises(ValueError, domain.set_ghost_exchange_period, 0)
+
 
 #-------------------------------------------------------------
 
@@ -0,0 +1,125 @@
+#!/usr/bin/env python
+
+import unittest
+import time
+
+from anuga.abstract_2d_finite_volumes.kernel_profiler import Kernel_profiler, \
+    cache_line_size
+
+
+class Test_Kernel_profiler(unittest.TestCase):
+    def setUp(self):
+        pass
+
+    def tearDown(self):
+        pass
+
+    def test_exclusive_times(self):
+
+        profiler = Kernel_profiler()
+
+        def inner():
+            time.sleep(0.02)
+
+        def outer():
+            time.sleep(0.01)
+            profiler.time('inner', inner)
+            return 'done'
+
+        assert profiler.time('outer', outer) == 'done'
+        profiler.time('inner', inner)
+
+        statistics = profiler.get_statistics()
+        assert statistics['outer']['calls'] == 1
+        assert statistics['inner']['calls'] == 2
+        assert 0.01 <= statistics['outer']['time'] < statistics['inner']['time']
+        assert statistics['inner']['time'] >= 0.04
+
+        assert 'outer' in profiler.statistics()
+
+        profiler.reset()
+        assert profiler.get_statistics() == {}
+
+    def test_hardware_counts(self):
+        """Counts of nested calls are only counted under their own name,
+        and only kernel steps are counted, with counters stood in for by a
+        function counting its calls
+        """
+
+        profiler = Kernel_profiler()
+
+        reads = [0]
+        def read_counters():
+            reads[0] += 1
+            return (100*reads[0], 10*reads[0], reads[0])
+
+        profiler.hardware_counters = True
+        profiler.read_counters = read_counters
+        profiler.counter_names = ['cycles', 'instructions', 'llc_misses']
+
+        # Reads 1 and 4 around extrapolation, 2 and 3 around protect
+        profiler.time('extrapolation', profiler.time, 'protect', lambda: None)
+
+        statistics = profiler.get_statistics()
+        assert statistics['protect']['cycles'] == 100
+        assert statistics['extrapolation']['cycles'] == 200
+        assert statistics['extrapolation']['instructions'] == 20
+        assert statistics['extrapolation']['llc_misses'] == 2
+        assert statistics['extrapolation']['bytes'] == 2*cache_line_size
+
+        assert 'instr/byte' in profiler.statistics()
+
+        # Python steps are timed but not counted, and do not count
+        # towards an enclosing kernel step
+        profiler.time('boundary', lambda: None)
+        profiler.time('flux', profiler.time, 'forcing', lambda: None)
+
+        statistics = profiler.get_statistics()
+        assert reads[0] == 6
+        assert statistics['boundary']['calls'] == 1
+        assert 'cycles' not in statistics['boundary']
+        assert 'cycles' not in statistics['forcing']
+        assert statistics['flux']['cycles'] == 100
+        assert 'boundary' not in profiler.counter_statistics()
+
+    def test_perf_counters(self):
+        """The hardware counters, where the system provides them, are
+        independent for each profiler
+        """
+
+        profiler = Kernel_profiler()
+        other = Kernel_profiler()
+        try:
+            profiler.set_hardware_counters(True)
+            other.set_hardware_counters(True)
+        except OSError:
+            # No counters (e.g. in a virtual machine or container)
+            return
+
+        profiler.time('flux', sum, range(100000))
+        assert profiler.get_statistics()['flux']['instructions'] > 100000
+
+        # Closing the counters of one profiler leaves the other's open
+        profiler.set_hardware_counters(False)
+        assert profiler.get_hardware_counters() is False
+
+        other.time('flux', sum, range(100000))
+        assert other.get_statistics()['flux']['instructions'] > 100000
+
+        # Pickled without the counters, which are opened again
+        import pickle
+        other = pickle.loads(pickle.dumps(other))
+        assert other.get_hardware_counters() is True
+        assert other.get_statistics()['flux']['calls'] == 1
+        other.time('flux', sum, range(100000))
+        assert other.get_statistics()['flux']['instructions'] > 200000
+
+        other.close_hardware_counters()
+        assert other.get_hardware_counters() is False
+
+#-------------------------------------------------------------
+
+if __name__ == "__main__":
+    suite = unittest.makeSuite(Test_Kernel_profiler, 'test')
+    runner = unittest.TextTestRunner()
+    runner.run(suite)
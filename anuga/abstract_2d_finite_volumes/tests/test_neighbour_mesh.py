@@ -1907,6 +1907,68 @@ class Test_Mesh(unittest.TestCase):
             assert num.allclose(total_length, ref_length)
 
 
+    def test_mesh_ordering(self):
+        """Reordered meshes are permutations of the original mesh
+        """
+
+        points, vertices, boundary = rectangular(8, 6, len1=4.0, len2=3.0)
+        tagged_elements = {'west': [0, 1, 2, 3], 'east': [80, 90]}
+
+        mesh = Mesh(points, vertices, boundary,
+                    tagged_elements=tagged_elements)
+
+        assert mesh.triangle_permutation is None
+        assert num.all(mesh.get_triangle_permutation() == num.arange(len(mesh)))
+
+        for ordering in ['hilbert', 'morton']:
+            ordered = Mesh(points, vertices, boundary,
+                           tagged_elements=tagged_elements,
+                           ordering=ordering)
+
+            tp = ordered.get_triangle_permutation()
+            np = ordered.get_node_permutation()
+
+            assert num.all(num.sort(tp) == num.arange(len(mesh)))
+            assert num.all(num.sort(np) == num.arange(mesh.number_of_nodes))
+            assert not num.all(tp == num.arange(len(mesh)))
+
+            # Same triangles, nodes and geometry
+            assert num.all(np[ordered.triangles] == mesh.triangles[tp])
+            assert num.all(ordered.nodes == mesh.nodes[np])
+            assert num.all(ordered.areas == mesh.areas[tp])
+            assert num.all(ordered.centroid_coordinates ==
+                           mesh.centroid_coordinates[tp])
+            assert num.all(ordered.normals == mesh.normals[tp])
+
+            # Neighbours are renumbered with the triangles
+            inverse = num.argsort(tp)
+            neighbours = mesh.neighbours[tp]
+            assert num.all(ordered.neighbours[neighbours < 0] < 0)
+            assert num.all(ordered.neighbours[neighbours >= 0] ==
+                           inverse[neighbours[neighbours >= 0]])
+
+            # Boundary and tags follow their triangles
+            assert len(ordered.boundary) == len(mesh.boundary)
+            for (vol_id, edge_id), tag in ordered.boundary.items():
+                assert mesh.boundary[(tp[vol_id], edge_id)] == tag
+
+            for tag in tagged_elements:
+                assert num.all(num.sort(tp[ordered.tagged_elements[tag]]) ==
+                               num.sort(tagged_elements[tag]))
+
+            # Curve order keeps consecutive triangles close together
+            c = ordered.centroid_coordinates
+            d = num.sqrt(num.sum((c[1:] - c[:-1])**2, axis=1))
+            assert num.mean(d) < 0.5
+
+        try:
+            Mesh(points, vertices, boundary, ordering='peano')
+        except ValueError:
+            pass
+        else:
+            raise Exception('Unknown ordering should raise ValueError')
+
+
 #-------------------------------------------------------------
 
 if __name__ == "__main__":
@@ -209,6 +209,62 @@ friction  \n \
         self.assertTrue(domain.geo_reference.xllcorner == 140.0,
                       "bad geo_referece")
 
+    def test_pmesh2Domain_mesh_ordering(self):
+        """Node attributes of a mesh file follow the nodes when the
+        domain renumbers them (see config.mesh_ordering)
+        """
+
+        import os
+        import tempfile
+        import anuga.config as config
+        from anuga import rectangular_cross, create_domain_from_file
+        from anuga.load_mesh.loadASCII import export_mesh_file
+
+        points, vertices, boundary = rectangular_cross(8, 6, len1=2., len2=1.)
+        points = num.array(points)
+        x = points[:,0]
+        y = points[:,1]
+
+        for extension in ['.tsh', '.msh']:
+            fileName = tempfile.mktemp(extension)
+            export_mesh_file(fileName,
+                             {'vertices': points,
+                              'vertex_attributes': num.transpose([x + 2*y, 0.01*x*y]).tolist(),
+                              'vertex_attribute_titles': ['elevation', 'friction'],
+                              'triangles': vertices,
+                              'triangle_tags': ['']*len(vertices),
+                              'triangle_neighbors': -num.ones((len(vertices), 3), int),
+                              'geo_reference': Geo_reference(56, 140, 120)})
+
+            domains = {}
+            mesh_ordering = config.mesh_ordering
+            try:
+                for ordering in [None, 'hilbert', 'morton']:
+                    config.mesh_ordering = ordering
+                    domains[ordering] = create_domain_from_file(fileName)
+            finally:
+                config.mesh_ordering = mesh_ordering
+                os.remove(fileName)
+
+            domain_1 = domains[None]
+            assert domain_1.node_permutation is None
+
+            for ordering in ['hilbert', 'morton']:
+                domain_2 = domains[ordering]
+                tp = domain_2.get_triangle_permutation()
+                assert not num.all(tp == num.arange(len(domain_1)))
+
+                for name in ['elevation', 'stage', 'friction']:
+                    Q_1 = domain_1.quantities[name]
+                    Q_2 = domain_2.quantities[name]
+                    assert num.allclose(Q_1.vertex_values[tp], Q_2.vertex_values)
+                    assert num.allclose(Q_1.centroid_values[tp], Q_2.centroid_values)
+
+                # Values of the renumbered nodes
+                X, Y = domain_2.get_vertex_coordinates(absolute=False).T
+                assert num.allclose(domain_2.quantities['elevation'].vertex_values.flat,
+                                    X + 2*Y)
+
 
 
 #-------------------------------------------------------------
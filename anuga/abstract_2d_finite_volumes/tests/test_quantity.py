@@ -3366,6 +3366,88 @@ Parameters
         assert num.allclose(quantity.edge_values, exact_edge_values)
 
 
+    def test_fused_quantity_kernels(self):
+        """The kernels updating several quantities in one call should
+        give identical results to the single quantity kernels
+        """
+
+        from anuga.abstract_2d_finite_volumes.mesh_factory import rectangular
+        from anuga.abstract_2d_finite_volumes import quantity_ext
+
+        names = ['stage', 'xmomentum', 'ymomentum']
+        points, vertices, boundary = rectangular(6, 5)
+
+        def create_domain(multiprocessor_mode):
+            domain = Generic_Domain(points, vertices, boundary,
+                                    conserved_quantities=names)
+            domain.multiprocessor_mode = multiprocessor_mode
+
+            N = len(domain)
+            for i, name in enumerate(names):
+                Q = domain.quantities[name]
+                x = num.arange(N, dtype=float)
+                Q.centroid_values[:] = num.sin(x*(i+1))
+                Q.centroid_values[::7] = 0.0
+                Q.explicit_update[:] = num.cos(x*(i+2))
+                Q.semi_implicit_update[:] = -num.abs(num.sin(x*(i+3)))
+                Q.centroid_backup_values[:] = num.cos(x*(i+4))
+            return domain
+
+        def assert_same(domain_1, domain_2):
+            for name in names:
+                Q_1 = domain_1.quantities[name]
+                Q_2 = domain_2.quantities[name]
+                for values in ['centroid_values', 'vertex_values',
+                               'edge_values', 'semi_implicit_update',
+                               'centroid_backup_values']:
+                    assert num.all(getattr(Q_1, values) == getattr(Q_2, values))
+
+        for multiprocessor_mode in [0, 1]:
+            domain_1 = create_domain(0)
+            domain_2 = create_domain(multiprocessor_mode)
+
+            for name in names:
+                domain_1.quantities[name].update(0.1)
+            quantity_ext.update_quantities(domain_2, 0.1)
+            assert_same(domain_1, domain_2)
+            assert num.all(domain_2.quantities['stage'].semi_implicit_update == 0.0)
+
+            for name in names:
+                domain_1.quantities[name].saxpy_centroid_values(0.25, 0.75)
+            quantity_ext.saxpy_quantities(domain_2, 0.25, 0.75)
+            assert_same(domain_1, domain_2)
+
+            for name in names:
+                domain_1.quantities[name].backup_centroid_values()
+            quantity_ext.backup_quantities(domain_2)
+            assert_same(domain_1, domain_2)
+
+            for name in names:
+                domain_1.quantities[name].extrapolate_second_order()
+            for name in names:
+                domain_2.quantities[name].compute_gradients()
+            quantity_ext.extrapolate_quantities_from_gradient(domain_2)
+            assert_same(domain_1, domain_2)
+
+            for name in names:
+                quantity_ext.limit_gradient_by_neighbour(domain_1.quantities[name])
+            quantity_ext.limit_gradient_of_quantities_by_neighbour(domain_2)
+            assert_same(domain_1, domain_2)
+
+            for name in names:
+                domain_1.quantities[name].extrapolate_second_order()
+                domain_2.quantities[name].extrapolate_second_order()
+            for name in names:
+                domain_1.quantities[name].limit_edges_by_neighbour()
+            quantity_ext.limit_edges_of_quantities_by_neighbour(domain_2)
+            assert_same(domain_1, domain_2)
+
+            # A subset of the quantities
+            domain_1.quantities['stage'].update(0.2)
+            quantity_ext.update_quantities(domain_2, 0.2, ['stage'])
+            assert_same(domain_1, domain_2)
+
+
 #-------------------------------------------------------------
 
 if __name__ == "__main__":
@@ -206,6 +206,37 @@ use_psyco = False      # Use psyco optimisations
 optimise_dry_cells = True # Exclude dry and still cells from flux computation
 optimised_gradient_limiter = True # Use hardwired gradient limiter
 
+multiprocessor_mode = 0 # 0: serial C kernels, 1: OpenMP threaded C kernels
+                        # (DE algorithms). Number of threads from OMP_NUM_THREADS
+edge_based_fluxes = False # Compute DE fluxes by streaming over unique edges
+simd_fluxes = False # Batched, vectorised DE flux function (implies edge_based_fluxes)
+native_evolve = False # Take the DE timesteps between yield points in C
+native_boundaries = False # Evaluate common boundary types in C (DE algorithms)
+active_cell_compaction = False # Leave dry cells away from water out of the DE kernels
+mesh_ordering = None # None, 'hilbert' or 'morton': renumber triangles and nodes
+                     # of new (sequential) domains along a space filling curve
+vertex_output_precision = 'double' # 'single': keep the vertex values of the evolved
+                                   # DE quantities as float32 (see set_vertex_output_precision)
+lazy_vertex_values = False # Compute the vertex values of the evolved DE quantities
+                           # only when accessed, rather than every timestep
+quantity_arena = None # None, 'quantity' or 'array': pack the quantity arrays of
+                      # a domain into one aligned block (see set_quantity_arena)
+numa_first_touch = False # Reallocate quantity and mesh arrays from the OpenMP
+                         # threads at domain construction (see first_touch_arrays)
+kernel_timing_file = None # Write the cumulative kernel times of the evolve loop
+                          # as JSON to this file at each yield step
+hardware_counters = False # Count cycles, instructions and cache misses of the
+                          # evolve loop kernels (Linux, see set_hardware_counters)
+ghost_exchange_overlap = False # Compute the interior cells of parallel domains
+                               # during the ghost exchange (native evolve)
+ghost_exchange_period = 1 # Exchange the ghost cells of parallel domains at
+                          # most every this many timesteps (needs a ghost
+                          # layer width of 2*substeps*period, see
+                          # set_ghost_exchange_period)
+nonblocking_step_reduction = False # Start the per-step allreduce of parallel
+                                   # domains after the fluxes, finish it in
+                                   # update_timestep (see Reduction_batch)
+
 points_file_block_line_size = 1e6 # Number of lines read in from a points file
                                   # when blocking
 
@@ -230,6 +230,10 @@ class SWW_file(Data_format):
                                             domain.tri_l2g,
                                             domain.node_l2g)
 
+        if getattr(domain, 'triangle_permutation', None) is not None:
+            self.writer.store_triangle_permutation(fid,
+                                                   domain.triangle_permutation)
+
         # Get names of static quantities
         static_quantities = {}
         static_quantities_centroid = {}
@@ -867,6 +871,16 @@ class Write_sww(Write_sts):
 
         outfile.variables['tri_full_flag'][:] = tri_full_flag.astype(num.int32)
 
+    def store_triangle_permutation(self, outfile, triangle_permutation):
+        """Store the original id of each volume of a reordered mesh
+        (see General_mesh), so the input numbering can be recovered.
+        """
+
+        outfile.createVariable('triangle_permutation', netcdf_int,
+                               ('number_of_volumes',))
+        outfile.variables['triangle_permutation'][:] = \
+            triangle_permutation.astype(num.int32)
+
     def store_static_quantities(self,
                                 outfile,
                                 sww_precision=num.float32,
@@ -13,6 +13,7 @@ del PytestTester
 
 
 from .parallel_api import distribute
+from .rebalance import rebalance
 from .parallel_api import myid, numprocs, get_processor_name
 from .parallel_api import send, receive
 from .parallel_api import pypar_available, barrier, finalize
@@ -10,6 +10,13 @@ __date__ ="$27/08/2012 8:58:23 PM$"
 
 ghost_layer_width = 2
 
+# Load rebalancing (see rebalance.py)
+rebalance_threshold = 1.1 # Repartition when the most loaded processor has
+                          # this times the mean cost
+dry_cell_cost = 0.2       # Cost of a dry cell relative to a wet cell, when
+                          # not measured from the kernel timing
+riverwall_cell_cost = 2.0 # Cost factor of cells with a riverwall edge
+
 
 if __name__ == "__main__":
     print("Hello World");
@@ -122,6 +122,10 @@ def reorder_new(quantities, epart_order, proc_sum):
 # assigned to processor 1 etc. The boundary and quantites
 # are ordered the same way as the triangles
 #
+#  *) If weights (one per triangle) are given the
+# partition balances the sum of the weights of each
+# processor rather than the number of triangles
+#
 #########################################################
 
 
@@ -133,12 +137,23 @@ def pmesh_divide_metis(domain, n_procs):
     return nodes, ttriangles, boundary, triangles_per_proc, quantities
 
 
-def pmesh_divide_metis_with_map(domain, n_procs):
+def pmesh_divide_metis_with_map(domain, n_procs, weights=None):
+
+    return pmesh_divide_metis_helper(domain, n_procs, weights)
+
 
-    return pmesh_divide_metis_helper(domain, n_procs)
+def metis_vertex_weights(weights):
+    """Positive integer vertex weights for metis from the relative
+    weights of the triangles, scaled to a mean of 100
+    """
 
+    weights = num.asarray(weights, float)
+    weights = 100.0*weights/max(num.mean(weights), 1.0e-30)
 
-def pmesh_divide_metis_helper(domain, n_procs):
+    return num.maximum(1, num.rint(weights)).astype(int).tolist()
+
+
+def pmesh_divide_metis_helper(domain, n_procs, weights=None):
 
     # Initialise the lists
     # List, indexed by processor of # triangles.
@@ -183,7 +198,11 @@ def pmesh_divide_metis_helper(domain, n_procs):
                 if neigh[i][0] < 0:
                     del neigh[i][0]
 
-            cutcount, partvert = pymetis.part_graph(n_procs, neigh)
+            if weights is None:
+                cutcount, partvert = pymetis.part_graph(n_procs, neigh)
+            else:
+                cutcount, partvert = pymetis.part_graph(n_procs, neigh,
+                                                        vweights=metis_vertex_weights(weights))
 
             # print "cutcount: ",cutcount
             # print "partvert: ",len(partvert)
@@ -515,7 +534,10 @@ def ghost_layer(submesh, mesh, p, tupper, tlower, parameters=None):
     layer_cells = {}
     layer_cells[0] = n0
 
-    # Find the subsequent layers of ghost triangles
+    # Find the subsequent layers of ghost triangles. The neighbours of
+    # layer i are in layers i-1, i and i+1, so only the last two layers
+    # are removed, which keeps deep layers (see set_ghost_exchange_period)
+    # linear in the layer width
     for i in range(layer_width-1):
 
         # use previous layer as a start
@@ -524,7 +546,7 @@ def ghost_layer(submesh, mesh, p, tupper, tlower, parameters=None):
         n0 = num.extract(n0 >= 0, n0)
         n0 = num.extract(num.logical_or(n0 < tlower, tupper <= n0), n0)
 
-        for j in range(i+1):
+        for j in range(max(0, i-1), i+1):
             n0 = numset.setdiff1d(n0, layer_cells[j])
 
         layer_cells[i+1] = n0
@@ -1237,6 +1259,65 @@ def build_local_mesh(submesh, lower_t, upper_t, nproc):
         full_send, tri_map, node_map, tri_l2g, node_l2g, ghost_layer_width
 
 
+#########################################################
+#
+# Split the triangles of a local mesh into interior and
+# boundary triangles, so that the ghost exchange can be
+# overlapped with the computation on the interior
+# triangles
+#
+# *) neighbours and number_of_boundaries are those of
+# the local mesh (with the ghost triangles), and
+# tri_full_flag is 1 for full and 0 for ghost triangles
+#
+# -------------------------------------------------------
+#
+# *) The DE kernels need the values of neighbouring
+# triangles at each pass: extrapolation reads the heights
+# (pass 1), then the velocities (pass 2) of the
+# neighbours, and the flux across an edge reads the edge
+# values (pass 3) of both triangles. So with d the
+# distance (in neighbour steps) of a triangle from the
+# nearest ghost triangle, before the ghost cells are
+# received
+#
+#    protection and pass 1 can be done for d >= 1,
+#    pass 2 for d >= 2,
+#    pass 3 for d >= 3 and
+#    the fluxes for d >= 4 (and no boundary edges, whose
+#    boundary values are not yet updated)
+#
+# *) Returns (interior_cells, boundary_cells), each a
+# tuple of the triangles of (protection, pass 1, pass 2,
+# pass 3, fluxes) in increasing order, interior_cells
+# for before and boundary_cells for after the ghost
+# cells are received
+#
+#########################################################
+
+def build_local_overlap_cells(neighbours, number_of_boundaries, tri_full_flag):
+
+    N = len(tri_full_flag)
+
+    # Distance from the ghost triangles, up to 4
+    distance = 4*num.ones(N, int)
+    front = num.flatnonzero(tri_full_flag == 0)
+    distance[front] = 0
+    for d in range(1, 4):
+        n = num.ravel(neighbours[front])
+        n = n[n >= 0]
+        front = num.unique(n[distance[n] > d])
+        distance[front] = d
+
+    interior = [distance >= 1, distance >= 1, distance >= 2, distance >= 3,
+                (distance >= 4) & (number_of_boundaries == 0)]
+
+    interior_cells = tuple(num.flatnonzero(mask) for mask in interior)
+    boundary_cells = tuple(num.flatnonzero(~mask) for mask in interior)
+
+    return interior_cells, boundary_cells
+
+
 #########################################################
 #
 # Handle the communication between the host machine
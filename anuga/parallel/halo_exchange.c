@@ -0,0 +1,35 @@
+// C routines for the packed ghost (halo) exchange of parallel domains,
+// see setup_halo_exchange in parallel_generic_communications.py
+//
+// The centroid values of the nq exchanged quantities at the cells ids[j]
+// are kept contiguous in the buffer, as buffer[j*nq + q], which is the
+// layout of the (n, nq) buffers of communicate_ghosts_asynchronous.
+
+
+// Copy the centroid values of the quantities at the cells ids into buffer
+int _pack_halo(long nq, double** quantities, long n, long* ids, double* buffer){
+
+  long j, q;
+
+  for (j = 0; j < n; j++) {
+    for (q = 0; q < nq; q++) {
+      buffer[j*nq + q] = quantities[q][ids[j]];
+    }
+  }
+
+  return 0;
+}
+
+// Copy buffer into the centroid values of the quantities at the cells ids
+int _unpack_halo(long nq, double** quantities, long n, long* ids, double* buffer){
+
+  long j, q;
+
+  for (j = 0; j < n; j++) {
+    for (q = 0; q < nq; q++) {
+      quantities[q][ids[j]] = buffer[j*nq + q];
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,66 @@
+#cython: wraparound=False, boundscheck=False, cdivision=True, profile=False, nonecheck=False, overflowcheck=False, cdivision_warnings=False, unraisable_tracebacks=False
+import cython
+
+from libc.stdlib cimport malloc, free
+
+# import both numpy and the Cython declarations for numpy
+import numpy as np
+cimport numpy as np
+
+# declare the interface to the C code
+cdef extern from "halo_exchange.c":
+    int _pack_halo(long nq, double** quantities, long n, long* ids, double* buffer)
+    int _unpack_halo(long nq, double** quantities, long n, long* ids, double* buffer)
+
+cdef double** _quantity_pointers(list quantities):
+
+    cdef long q, nq = len(quantities)
+    cdef double** pointers
+    cdef np.ndarray[double, ndim=1, mode="c"] values
+
+    pointers = <double**> malloc(nq * sizeof(double*))
+    for q in range(nq):
+        values = quantities[q]
+        pointers[q] = &values[0]
+
+    return pointers
+
+def pack_halo(list quantities,\
+              np.ndarray[long, ndim=1, mode="c"] ids not None,\
+              np.ndarray[double, ndim=1, mode="c"] buffer not None):
+    """Copy the centroid values (1d arrays) in quantities at the cells
+    ids into buffer, as buffer[j*len(quantities) + q]
+    """
+
+    cdef long nq = len(quantities)
+    cdef long n = ids.shape[0]
+    cdef double** pointers
+
+    if n == 0 or nq == 0:
+        return
+
+    assert buffer.shape[0] >= n*nq
+
+    pointers = _quantity_pointers(quantities)
+    _pack_halo(nq, pointers, n, &ids[0], &buffer[0])
+    free(pointers)
+
+def unpack_halo(list quantities,\
+                np.ndarray[long, ndim=1, mode="c"] ids not None,\
+                np.ndarray[double, ndim=1, mode="c"] buffer not None):
+    """Copy buffer, packed by pack_halo, into the centroid values in
+    quantities at the cells ids
+    """
+
+    cdef long nq = len(quantities)
+    cdef long n = ids.shape[0]
+    cdef double** pointers
+
+    if n == 0 or nq == 0:
+        return
+
+    assert buffer.shape[0] >= n*nq
+
+    pointers = _quantity_pointers(quantities)
+    _unpack_halo(nq, pointers, n, &ids[0], &buffer[0])
+    free(pointers)
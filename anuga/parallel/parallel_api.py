@@ -68,10 +68,13 @@ def collect_value(value):
 
 
 
-def distribute(domain, verbose=False, debug=False, parameters = None):
+def distribute(domain, verbose=False, debug=False, parameters = None, weights = None):
     """ Distribute the domain to all processes
 
     parameters allows user to change size of ghost layer
+
+    weights (one per triangle) give the relative costs of the triangles
+    for the partitioning, by default all triangles cost the same
     """
 
     if not pypar_available or numprocs == 1 : return domain # Bypass
@@ -79,7 +82,7 @@ def distribute(domain, verbose=False, debug=False, parameters = None):
 
     if myid == 0:
         from .sequential_distribute import Sequential_distribute
-        partition = Sequential_distribute(domain, verbose, debug, parameters)
+        partition = Sequential_distribute(domain, verbose, debug, parameters, weights)
 
         partition.distribute(numprocs)
 
@@ -105,6 +108,22 @@ def distribute(domain, verbose=False, debug=False, parameters = None):
             domain_quantities_to_be_stored, domain_smooth, domain_low_froude\
              = receive(0)
 
+    return create_parallel_domain(kwargs, points, vertices, boundary, quantities, boundary_map,
+                                  domain_name, domain_dir, domain_store, domain_store_centroids,
+                                  domain_minimum_storable_height, domain_minimum_allowed_height,
+                                  domain_flow_algorithm, domain_georef,
+                                  domain_quantities_to_be_stored, domain_smooth, domain_low_froude)
+
+
+def create_parallel_domain(kwargs, points, vertices, boundary, quantities, boundary_map,
+                           domain_name, domain_dir, domain_store, domain_store_centroids,
+                           domain_minimum_storable_height, domain_minimum_allowed_height,
+                           domain_flow_algorithm, domain_georef,
+                           domain_quantities_to_be_stored, domain_smooth, domain_low_froude):
+    """Create the parallel domain of this processor from its part of the
+    partition (see Sequential_distribute.extract_submesh)
+    """
+
     #---------------------------------------------------------------------------
     # Now Create parallel domain
     #---------------------------------------------------------------------------
@@ -12,63 +12,67 @@ import numpy as num
 
 import anuga.utilities.parallel_abstraction as pypar
 
+from .reduction_batch import Reduction_batch
+
 
 
 
 def setup_buffers(domain):
-    """Buffers for synchronisation of timesteps
+    """Buffers for synchronisation of timesteps and ghost cells
     """
 
-    domain.local_timestep = num.zeros(1, float)
-    domain.global_timestep = num.zeros(1, float)
-
-    domain.local_timesteps = num.zeros(domain.numproc, float)
+    domain.reduction_batch = Reduction_batch()
+    domain.reduction_batch.add_lane('flux_timestep', 'min')
 
     domain.communication_time = 0.0
     domain.communication_reduce_time = 0.0
     domain.communication_broadcast_time = 0.0
 
+    # Halo exchanges of get_halo_exchange, by quantities
+    domain.halo_exchanges = {}
 
-def communicate_flux_timestep(domain, yieldstep, finaltime):
-    """Calculate local timestep
+
+def post_flux_timestep(domain):
+    """Start the reduction of communicate_flux_timestep without blocking,
+    so that the forcing terms can be computed meanwhile
     """
 
     import time
 
-    #Compute minimal timestep across all processes
-    domain.local_timestep[0] = domain.flux_timestep
+    batch = domain.reduction_batch
+    batch.set_value('flux_timestep', domain.flux_timestep)
+
     t0 = time.time()
 
+    batch.start()
 
+    domain.communication_reduce_time += time.time()-t0
 
 
-    pypar.allreduce(domain.local_timestep, pypar.MIN,
-                      buffer=domain.global_timestep,
-                      bypass=True)
+def communicate_flux_timestep(domain, yieldstep, finaltime):
+    """Calculate local timestep
+    """
 
-    domain.communication_reduce_time += time.time()-t0
+    import time
 
+    #Compute minimal timestep across all processes, together with the
+    #other per-step reductions of the domain (see Reduction_batch).
+    #If post_flux_timestep started the reduction it is only completed.
+    batch = domain.reduction_batch
 
+    t0 = time.time()
 
+    if batch.pending():
+        batch.wait()
+    else:
+        batch.set_value('flux_timestep', domain.flux_timestep)
+        batch.reduce()
 
-#    pypar.reduce(domain.local_timestep, pypar.MIN, 0,
-#                      buffer=domain.global_timestep,
-#                      bypass=True)
-#
-#
-#    domain.communication_reduce_time += time.time()-t0
+    domain.communication_reduce_time += time.time()-t0
 
+    domain.flux_timestep = batch.get_value('flux_timestep')
 
-    #Broadcast minimal timestep to all processors
-    t0 = time.time()
-    #pypar.broadcast(domain.global_timestep, 0)#, bypass=True)
 
-    domain.communication_broadcast_time += time.time()-t0
-
-    #old_flux_timestep = domain.flux_timestep
-    domain.flux_timestep = domain.global_timestep[0]
-    
-    
 
 def communicate_ghosts_blocking(domain):
 
@@ -200,3 +204,124 @@ def communicate_ghosts_asynchronous(domain, quantities=None):
     domain.communication_time += time.time()-t0
 
 
+def setup_halo_exchange(domain, quantities):
+    """Buffers and persistent requests for exchanging the centroid values
+    of quantities with all neighbouring processors.
+
+    The full cells sent to, and ghost cells received from, all
+    neighbours are listed in one index array each, in order of processor,
+    and the values of all quantities for a neighbour are packed into one
+    contiguous slice of a single send (or receive) buffer, by
+    halo_exchange_ext. The MPI requests for each slice are set up once
+    here (send_recv_init) and restarted for each exchange. Ghost cells
+    updated from full cells of the same processor are copied between the
+    buffers without MPI.
+    """
+
+    nq = len(quantities)
+    procs = sorted(domain.full_send_dict.keys())
+    assert procs == sorted(domain.ghost_recv_dict.keys())
+
+    send_ids = [num.asarray(domain.full_send_dict[p][0], dtype=int) for p in procs]
+    recv_ids = [num.asarray(domain.ghost_recv_dict[p][0], dtype=int) for p in procs]
+
+    send_offsets = num.cumsum([0] + [nq*len(ids) for ids in send_ids])
+    recv_offsets = num.cumsum([0] + [nq*len(ids) for ids in recv_ids])
+
+    halo = {}
+    halo['quantities'] = list(quantities)
+    halo['send_ids'] = num.ascontiguousarray(num.concatenate([num.zeros(0, int)] + send_ids))
+    halo['recv_ids'] = num.ascontiguousarray(num.concatenate([num.zeros(0, int)] + recv_ids))
+    halo['send_buffer'] = num.zeros(send_offsets[-1], float)
+    halo['recv_buffer'] = num.zeros(recv_offsets[-1], float)
+
+    send_slices = {}
+    recv_slices = {}
+    halo['local'] = []
+    for i, p in enumerate(procs):
+        send_slice = halo['send_buffer'][send_offsets[i]:send_offsets[i+1]]
+        recv_slice = halo['recv_buffer'][recv_offsets[i]:recv_offsets[i+1]]
+        if p == domain.processor:
+            halo['local'].append((send_slice, recv_slice))
+        else:
+            send_slices[p] = send_slice
+            recv_slices[p] = recv_slice
+
+    halo['requests'] = pypar.send_recv_init(send_slices, recv_slices)
+
+    return halo
+
+
+def get_halo_exchange(domain, quantities=None):
+    """The halo exchange of setup_halo_exchange for quantities (default
+    the conserved quantities) of the domain, set up on first use
+    """
+
+    if quantities is None:
+        quantities = domain.conserved_quantities
+
+    key = tuple(quantities)
+    if key not in domain.halo_exchanges:
+        domain.halo_exchanges[key] = setup_halo_exchange(domain, quantities)
+
+    return domain.halo_exchanges[key]
+
+
+def communicate_ghosts_packed(domain, quantities=None):
+    """Update the ghost cells as communicate_ghosts_asynchronous, with the
+    packing and unpacking in C and persistent requests (see
+    setup_halo_exchange)
+    """
+
+    exchange = post_ghost_exchange(domain, quantities)
+    complete_ghost_exchange(domain, exchange)
+
+
+def post_ghost_exchange(domain, quantities=None):
+    """Start the packed update of the ghost cells of
+    communicate_ghosts_packed, so that computation not needing the ghost
+    cells can go on meanwhile. Returns the pending exchange, to pass to
+    complete_ghost_exchange.
+    """
+
+    import time
+    from .halo_exchange_ext import pack_halo
+
+    t0 = time.time()
+
+    halo = get_halo_exchange(domain, quantities)
+
+    # The send buffer must be left alone until the exchange is completed
+    values = [domain.quantities[q].centroid_values for q in halo['quantities']]
+    pack_halo(values, halo['send_ids'], halo['send_buffer'])
+
+    pypar.startall(halo['requests'])
+
+    for send_slice, recv_slice in halo['local']:
+        recv_slice[:] = send_slice
+
+    domain.communication_time += time.time()-t0
+
+    return halo
+
+
+def complete_ghost_exchange(domain, exchange):
+    """Wait for an exchange started by post_ghost_exchange and copy the
+    received data to the ghost cells
+    """
+
+    import time
+    from .halo_exchange_ext import unpack_halo
+
+    t0 = time.time()
+
+    halo = exchange
+
+    pypar.waitall(halo['requests'])
+
+    values = [domain.quantities[q].centroid_values for q in halo['quantities']]
+    unpack_halo(values, halo['recv_ids'], halo['recv_buffer'])
+
+    domain.communication_time += time.time()-t0
+
+
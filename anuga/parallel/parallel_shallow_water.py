@@ -111,6 +111,15 @@ class Parallel_domain(Domain):
 
         self.ghost_counter = 0
 
+        # Pending exchange of post_ghost_exchange
+        self.ghost_exchange = None
+
+        from anuga.config import nonblocking_step_reduction
+        self.set_nonblocking_step_reduction(nonblocking_step_reduction)
+
+        # Repartitions of the run so far (see rebalance)
+        self.number_of_rebalances = 0
+
 
     def set_name(self, name):
         """Assign name based on processor number
@@ -138,16 +147,96 @@ class Parallel_domain(Domain):
 
         Domain.update_timestep(self, yieldstep, finaltime)
 
+    def set_nonblocking_step_reduction(self, flag=True):
+        """Start the per-step allreduce as soon as the fluxes of the first
+        substep are computed (post_timestep_reduction) and complete it in
+        update_timestep, so that it overlaps the forcing terms. The
+        forcing terms must then leave flux_timestep alone.
+        """
+
+        self.nonblocking_step_reduction = flag
+
+    def get_nonblocking_step_reduction(self):
+
+        return self.nonblocking_step_reduction
+
+    def post_timestep_reduction(self):
+        """Start the allreduce of update_timestep if it is non-blocking.
+        Otherwise only take the local values of the step reductions (see
+        add_step_reduction), so that they are the same either way.
+        """
+
+        if self.nonblocking_step_reduction:
+            generic_comms.post_flux_timestep(self)
+        else:
+            self.reduction_batch.evaluate()
+
+    def add_step_reduction(self, name, op, function):
+        """Reduce function() over all processors with op ('min' or 'sum')
+        every timestep, in the same allreduce as the flux timestep. The
+        result is returned by get_step_reduction(name) once the timestep
+        of the step has been computed.
+
+        function is called once per timestep, after the fluxes of the
+        first substep are computed and before the forcing terms
+        (post_timestep_reduction), whether or not the reduction is
+        non-blocking (set_nonblocking_step_reduction). So it sees the
+        conserved quantities at the start of the step, and must not rely
+        on the forcing terms of the step. To checkpoint the domain function
+        must be picklable (e.g. a module level function, not a lambda).
+        """
+
+        self.reduction_batch.add_lane(name, op, function)
+
+    def remove_step_reduction(self, name):
+
+        self.reduction_batch.remove_lane(name)
 
+    def get_step_reduction(self, name):
+        """Result of the reduction of add_step_reduction on the current
+        timestep
+        """
+
+        return self.reduction_batch.get_value(name)
+
+
+
+    def __getstate__(self):
+        """Pickle (e.g. for checkpointing) without the halo exchanges of
+        the packed ghost update, which hold persistent MPI requests. They
+        are set up again by the next update_ghosts.
+        """
+
+        assert self.ghost_exchange is None, 'Pickled during a ghost exchange'
+
+        state = Domain.__getstate__(self)
+        state['halo_exchanges'] = {}
+
+        return state
 
     def update_ghosts(self, quantities=None):
         """We must send the information from the full cells and
         receive the information for the ghost cells
         """
 
-        generic_comms.communicate_ghosts_asynchronous(self, quantities)
+        generic_comms.communicate_ghosts_packed(self, quantities)
+        #generic_comms.communicate_ghosts_asynchronous(self, quantities)
         #generic_comms.communicate_ghosts_blocking(self)
 
+    def post_ghost_exchange(self, quantities=None):
+        """Start the ghost update with non-blocking communication, to be
+        finished by complete_ghost_exchange
+        """
+
+        self.ghost_exchange = generic_comms.post_ghost_exchange(self, quantities)
+
+    def complete_ghost_exchange(self):
+        """Finish the ghost update started by post_ghost_exchange
+        """
+
+        generic_comms.complete_ghost_exchange(self, self.ghost_exchange)
+        self.ghost_exchange = None
+
     def apply_fractional_steps(self):
 
         for operator in self.fractional_step_operators:
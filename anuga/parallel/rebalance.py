@@ -0,0 +1,364 @@
+"""Weighted repartitioning of parallel domains during a run.
+
+distribute partitions the mesh once, by number of triangles. On
+inundation runs dry cells are cheap and wet and riverwall cells
+expensive, so the processors drift out of balance as the water moves.
+
+cell_costs estimates the cost of each cell from whether it is wet, with
+the cost of a dry cell relative to a wet cell either given or measured
+from the kernel timing of the processors (measure_dry_cell_cost).
+
+rebalance, called by all processors at a yield time, repartitions the
+domain with these costs as metis weights when the most loaded processor
+is above the threshold, and returns the new parallel domain. The full
+cells of all processors are gathered on processor 0, which rebuilds the
+mesh and its quantities and distributes them as distribute does, so the
+ghost layers and the send and receive dictionaries are rebuilt too.
+
+The evolve and kernel settings of the domain are copied to the new
+domain (copy_domain_settings). As after distribute, the boundary
+conditions, operators and riverwalls have to be set on the new domain:
+
+    for t in domain.evolve(yieldstep=yieldstep, finaltime=finaltime):
+        ...
+        if rebalancing is due:
+            domain = rebalance(domain)
+            setup_boundaries_and_operators(domain)
+            break
+"""
+
+from __future__ import print_function
+from __future__ import absolute_import
+
+import numpy as num
+
+import anuga.utilities.parallel_abstraction as pypar
+
+from . import config
+
+
+# Kernels of the evolve loop which are not computation on the cells
+communication_kernels = ['ghost_exchange', 'timestep', 'extrema']
+
+
+def get_kernel_time(domain):
+    """Time spent computing on the cells in the evolve loop since the
+    kernel timing was last reset, leaving out communication and operators
+    """
+
+    statistics = domain.get_kernel_timing()
+
+    return sum(s['time'] for name, s in statistics.items()
+               if name not in communication_kernels and
+               not name.startswith('operator:'))
+
+
+def get_wet_cells(domain):
+    """Boolean array, True for the cells holding water
+    """
+
+    stage = domain.quantities['stage'].centroid_values
+    elevation = domain.quantities['elevation'].centroid_values
+
+    return stage - elevation > domain.minimum_allowed_height
+
+
+def get_riverwall_cells(domain):
+    """Boolean array, True for the cells with a riverwall edge
+    """
+
+    edge_flux_type = getattr(domain, 'edge_flux_type', None)
+    if edge_flux_type is None:
+        return num.zeros(len(domain), bool)
+
+    return num.any(num.reshape(edge_flux_type, (-1, 3)) == 1, axis=1)
+
+
+def measure_dry_cell_cost(domain):
+    """Cost of a dry cell relative to a wet cell, fitted to the kernel
+    time and the number of wet and dry full cells of each processor by
+    least squares. Called by all processors. Returns config.dry_cell_cost
+    if the fit is not determined, e.g. before any timesteps or when all
+    processors have the same proportion of wet cells.
+    """
+
+    full = domain.tri_full_flag == 1
+    wet = get_wet_cells(domain)
+
+    n_wet = float(num.sum(wet & full))
+    n_dry = float(num.sum(~wet & full))
+    t = get_kernel_time(domain)
+
+    # Normal equations of t = a*n_wet + b*n_dry over the processors
+    local = num.array([n_wet*n_wet, n_wet*n_dry, n_dry*n_dry, t*n_wet, t*n_dry])
+    total = num.zeros_like(local)
+    pypar.allreduce(local, pypar.SUM, buffer=total, bypass=True)
+
+    A = num.array([[total[0], total[1]], [total[1], total[2]]])
+    det = num.linalg.det(A)
+    if abs(det) <= 1.0e-12*max(total[0]*total[2], 1.0):
+        return config.dry_cell_cost
+
+    a, b = num.linalg.solve(A, total[3:])
+    if a <= 0.0 or b < 0.0:
+        return config.dry_cell_cost
+
+    return min(b/a, 1.0)
+
+
+def cell_costs(domain, dry_cell_cost=None, riverwall_cell_cost=None):
+    """Relative cost of each cell of the domain: 1 for wet cells and
+    dry_cell_cost for dry cells, times riverwall_cell_cost for cells with
+    a riverwall edge. dry_cell_cost 'measured' uses measure_dry_cell_cost
+    (then all processors must call this).
+    """
+
+    if dry_cell_cost is None:
+        dry_cell_cost = config.dry_cell_cost
+    elif dry_cell_cost == 'measured':
+        dry_cell_cost = measure_dry_cell_cost(domain)
+
+    if riverwall_cell_cost is None:
+        riverwall_cell_cost = config.riverwall_cell_cost
+
+    costs = num.where(get_wet_cells(domain), 1.0, dry_cell_cost)
+    costs[get_riverwall_cells(domain)] *= riverwall_cell_cost
+
+    return costs
+
+
+def load_imbalance(domain, costs):
+    """Largest cost of the full cells of a processor over the mean of
+    the processors. Called by all processors.
+    """
+
+    local = num.array([num.sum(costs[domain.tri_full_flag == 1])])
+    largest = num.zeros(1)
+    total = num.zeros(1)
+    pypar.allreduce(local, pypar.MAX, buffer=largest, bypass=True)
+    pypar.allreduce(local, pypar.SUM, buffer=total, bypass=True)
+
+    if total[0] <= 0.0:
+        return 1.0
+
+    return largest[0]*domain.numproc/total[0]
+
+
+def gather_full_cells(domain, costs):
+    """Full cells of this processor in the global numbering (tri_l2g and
+    node_l2g), with their boundary tags, quantities and costs
+    """
+
+    full = num.flatnonzero(domain.tri_full_flag == 1)
+    tri_l2g = num.asarray(domain.tri_l2g)
+    node_l2g = num.asarray(domain.node_l2g)
+
+    triangles = domain.triangles[full]
+    nodes = num.unique(triangles)
+
+    tri_g2l = -num.ones(len(domain), int)
+    tri_g2l[full] = num.arange(len(full))
+
+    boundary = {}
+    for (k, e), tag in domain.boundary.items():
+        if tri_g2l[k] >= 0:
+            boundary[tri_l2g[k], e] = tag
+
+    cells = {'ids': tri_l2g[full],
+             'triangles': node_l2g[triangles],
+             'node_ids': node_l2g[nodes],
+             'nodes': domain.nodes[nodes],
+             'boundary': boundary,
+             'costs': costs[full],
+             'centroid_values': {},
+             'vertex_values': {}}
+
+    for name, Q in domain.quantities.items():
+        cells['centroid_values'][name] = Q.centroid_values[full]
+        cells['vertex_values'][name] = Q.vertex_values[full]
+
+    return cells
+
+
+def build_global_domain(domain, all_cells):
+    """Sequential domain of the whole mesh, from the full cells of every
+    processor (gather_full_cells), with the settings of domain
+    """
+
+    from anuga import Domain, Quantity
+
+    N = domain.number_of_global_triangles
+
+    points = num.zeros((domain.number_of_global_nodes, 2))
+    triangles = num.zeros((N, 3), int)
+    boundary = {}
+    costs = num.zeros(N)
+    for cells in all_cells:
+        points[cells['node_ids']] = cells['nodes']
+        triangles[cells['ids']] = cells['triangles']
+        boundary.update(cells['boundary'])
+        costs[cells['ids']] = cells['costs']
+
+    # Keep the numbering, so that the quantities can be set by triangle
+    global_domain = Domain(points, triangles, boundary,
+                           geo_reference=domain.geo_reference,
+                           mesh_ordering=False)
+
+    global_domain.set_flow_algorithm(domain.get_flow_algorithm())
+    global_domain.set_name(domain.get_global_name())
+    global_domain.set_datadir(domain.get_datadir())
+    global_domain.set_store(domain.get_store())
+    global_domain.set_store_centroids(domain.get_store_centroids())
+    global_domain.set_low_froude(domain.low_froude)
+    global_domain.set_minimum_storable_height(domain.minimum_storable_height)
+    global_domain.set_minimum_allowed_height(domain.get_minimum_allowed_height())
+    global_domain.set_quantities_to_be_stored(domain.quantities_to_be_stored)
+    global_domain.smooth = domain.smooth
+
+    for name in domain.quantities:
+        if name not in global_domain.quantities:
+            Quantity(global_domain, name=name, register=True)
+
+        vertex_values = num.zeros((N, 3))
+        centroid_values = num.zeros(N)
+        for cells in all_cells:
+            vertex_values[cells['ids']] = cells['vertex_values'][name]
+            centroid_values[cells['ids']] = cells['centroid_values'][name]
+
+        global_domain.set_quantity(name, vertex_values)
+        global_domain.quantities[name].centroid_values[:] = centroid_values
+
+    return global_domain, costs
+
+
+def copy_domain_settings(domain, new_domain):
+    """Set the evolve, kernel and instrumentation settings of domain on
+    new_domain, so that a run carries on with the same algorithm, kernels
+    and threading after rebalance
+    """
+
+    new_domain.set_timestepping_method(domain.get_timestepping_method())
+    new_domain.set_CFL(domain.get_CFL())
+    new_domain.set_evolve_max_timestep(domain.evolve_max_timestep)
+    new_domain.set_ghost_exchange_period(domain.get_ghost_exchange_period())
+    new_domain.set_nonblocking_step_reduction(domain.get_nonblocking_step_reduction())
+
+    new_domain.set_multiprocessor_mode(domain.get_multiprocessor_mode())
+    new_domain.set_edge_based_fluxes(domain.get_edge_based_fluxes())
+    new_domain.set_simd_fluxes(domain.get_simd_fluxes())
+    new_domain.set_native_evolve(domain.get_native_evolve())
+    new_domain.set_native_boundaries(domain.get_native_boundaries())
+    new_domain.set_ghost_exchange_overlap(domain.get_ghost_exchange_overlap())
+    new_domain.set_active_cell_compaction(domain.get_active_cell_compaction())
+    if domain.max_flux_update_frequency != 1:
+        nlevels = int(num.log2(domain.max_flux_update_frequency))
+        new_domain.set_local_extrapolation_and_flux_updating(nlevels)
+
+    new_domain.set_vertex_output_precision(domain.get_vertex_output_precision())
+    new_domain.set_lazy_vertex_values(domain.get_lazy_vertex_values())
+    arena = domain.get_quantity_arena()
+    new_domain.set_quantity_arena(None if arena is None else arena.policy)
+
+    new_domain.set_kernel_timing_file(domain.get_kernel_timing_file())
+    if domain.get_hardware_counters():
+        new_domain.set_hardware_counters(True)
+
+
+def rebalance(domain, costs=None, threshold=None, name=None, verbose=False):
+    """Repartition the parallel domain so that each processor has about
+    the same total cost of cells, if the load imbalance (load_imbalance)
+    is above threshold (default config.rebalance_threshold). Called by
+    all processors at a yield time. Returns the new parallel domain, or
+    domain if it was not repartitioned.
+
+    costs: cost of each cell of the domain, default cell_costs(domain)
+    name: name of the new domain, default the name of domain with the
+          number of the rebalance appended, so that sww files already
+          written are kept
+
+    The settings of domain set through its set_ methods for the evolve
+    loop and its kernels (see copy_domain_settings) carry over to the new
+    domain. Boundary conditions, operators and riverwalls have to be set
+    on the new domain, as on the domain returned by distribute.
+    """
+
+    from .parallel_api import create_parallel_domain
+    from .sequential_distribute import Sequential_distribute
+
+    numprocs = domain.numproc
+    myid = domain.processor
+
+    if numprocs == 1:
+        return domain
+
+    if costs is None:
+        costs = cell_costs(domain)
+
+    if threshold is None:
+        threshold = config.rebalance_threshold
+
+    imbalance = load_imbalance(domain, costs)
+    if imbalance < threshold:
+        return domain
+
+    if verbose and myid == 0:
+        print('Rebalancing at time %g, load imbalance %.3f' % (domain.get_time(), imbalance))
+
+    number_of_rebalances = domain.number_of_rebalances + 1
+    if name is None:
+        name = '%s_%d' % (domain.get_global_name(), number_of_rebalances)
+
+    #---------------------------------------------------------------------------
+    # Repartition the whole mesh on processor 0 with the costs as weights
+    #---------------------------------------------------------------------------
+    cells = gather_full_cells(domain, costs)
+
+    if myid == 0:
+        all_cells = [cells]
+        for p in range(1, numprocs):
+            all_cells.append(pypar.receive(p))
+
+        global_domain, global_costs = build_global_domain(domain, all_cells)
+        global_domain.set_name(name)
+        del all_cells
+
+        parameters = {'ghost_layer_width': domain.ghost_layer_width}
+        partition = Sequential_distribute(global_domain, verbose, False,
+                                          parameters, global_costs)
+        partition.distribute(numprocs)
+
+        for p in range(numprocs):
+            tostore = partition.extract_submesh(p)
+
+            # The partition carries vertex values, the centroid values of
+            # the state are sent as well
+            ids = partition.p2s_map[tostore[0]['tri_l2g']]
+            centroid_values = dict((q, Q.centroid_values[ids])
+                                   for q, Q in global_domain.quantities.items())
+
+            if p == 0:
+                submesh = (tostore, centroid_values)
+            else:
+                pypar.send((tostore, centroid_values), p)
+
+        del global_domain, partition
+    else:
+        pypar.send(cells, 0)
+        submesh = pypar.receive(0)
+
+    #---------------------------------------------------------------------------
+    # Create the new parallel domain at the time of domain
+    #---------------------------------------------------------------------------
+    tostore, centroid_values = submesh
+
+    new_domain = create_parallel_domain(*tostore)
+
+    for q, values in centroid_values.items():
+        new_domain.quantities[q].centroid_values[:] = values
+
+    new_domain.set_starttime(domain.get_starttime())
+    new_domain.set_evolve_starttime(domain.get_relative_time())
+    copy_domain_settings(domain, new_domain)
+    new_domain.number_of_rebalances = number_of_rebalances
+
+    return new_domain
@@ -0,0 +1,216 @@
+"""Batched global reductions of per-step scalars.
+
+Each timestep a parallel domain reduces the flux timestep over all
+processors (MIN). Other per-step scalars, such as the volume through an
+operator or the boundary flux, can be reduced with it, so that there is
+one allreduce per step however many scalars are reduced.
+
+Each scalar is a lane of a Reduction_batch, with op 'min' or 'sum'. The
+local values of the lanes are packed into one buffer, MIN lanes first,
+and reduced by a single allreduce with an operation which takes the
+minimum of the MIN lanes and the sum of the SUM lanes. With only MIN
+lanes MPI's own MIN is used.
+
+The reduction is either blocking (reduce) or started (start) and
+completed later (wait), so that it can overlap computation not needing
+the results. The lane functions are called by evaluate, or else by
+reduce or start, so that a caller can fix the point at which the local
+values are taken whichever way they are reduced.
+
+A batch can be pickled (e.g. with a checkpointed domain) between
+reductions if its lane functions can, so they should be module level
+functions rather than lambdas. The reduction operation is not pickled,
+it is created again by the next reduction.
+"""
+
+from functools import partial
+
+import numpy as num
+
+import anuga.utilities.parallel_abstraction as pypar
+
+
+def min_sum(inbuf, outbuf, datatype, n_min):
+    """Combine buffers of doubles by the minimum of the first n_min
+    values and the sum of the others
+    """
+
+    a = num.frombuffer(inbuf, dtype=float)
+    b = num.frombuffer(outbuf, dtype=float)
+    num.minimum(a[:n_min], b[:n_min], out=b[:n_min])
+    b[n_min:] += a[n_min:]
+
+
+def min_sum_function(n_min):
+    """Reduction function (see pypar.create_op) of min_sum with n_min
+    MIN values
+    """
+
+    return partial(min_sum, n_min=n_min)
+
+
+class Reduction_batch(object):
+
+    def __init__(self):
+
+        self.min_lanes = []
+        self.sum_lanes = []
+        self.functions = {}
+
+        self.request = None
+        self.evaluated = False
+        self.op = None
+        self.created_op = False
+        self._setup()
+
+    def add_lane(self, name, op='min', function=None):
+        """Reduce the scalar name with op ('min' or 'sum'). If function is
+        given the local value is function() at each reduction, otherwise
+        it is set with set_value. To pickle the batch function must be
+        picklable (e.g. a module level function).
+        """
+
+        if op not in ['min', 'sum']:
+            raise ValueError("Reduction op must be 'min' or 'sum', got %s" % str(op))
+
+        if name in self.min_lanes or name in self.sum_lanes:
+            raise ValueError('Reduction lane %s already exists' % name)
+
+        if op == 'min':
+            self.min_lanes.append(name)
+        else:
+            self.sum_lanes.append(name)
+
+        if function is not None:
+            self.functions[name] = function
+
+        self._setup()
+
+    def remove_lane(self, name):
+
+        if name in self.min_lanes:
+            self.min_lanes.remove(name)
+        else:
+            self.sum_lanes.remove(name)
+
+        self.functions.pop(name, None)
+        self._setup()
+
+    def get_lanes(self):
+
+        return self.min_lanes + self.sum_lanes
+
+    def _setup(self):
+        """Buffers and reduction operation for the current lanes
+        """
+
+        assert self.request is None, 'Lanes changed during a reduction'
+
+        lanes = self.min_lanes + self.sum_lanes
+        self.index = dict((name, i) for i, name in enumerate(lanes))
+        self.local_values = num.zeros(len(lanes), float)
+        self.global_values = num.zeros(len(lanes), float)
+        self.evaluated = False
+
+        # Created by the next reduction
+        if self.created_op:
+            pypar.free_op(self.op)
+        self.op = None
+        self.created_op = False
+
+    def _get_op(self):
+        """Reduction operation for the current lanes, None if sequential
+        """
+
+        if self.op is None and pypar.pypar_available and pypar.size() > 1:
+            if not self.sum_lanes:
+                self.op = pypar.MIN
+            else:
+                self.op = pypar.create_op(min_sum_function(len(self.min_lanes)))
+                self.created_op = True
+
+        return self.op
+
+    def __getstate__(self):
+        """Pickle without the reduction operation, which is created again
+        by the next reduction
+        """
+
+        assert self.request is None, 'Pickled during a reduction'
+
+        state = self.__dict__.copy()
+        state['op'] = None
+        state['created_op'] = False
+
+        return state
+
+    def set_value(self, name, value):
+        """Set the local value of name for the next reduction
+        """
+
+        self.local_values[self.index[name]] = value
+
+    def evaluate(self):
+        """Set the local values of the lanes with a function now, rather
+        than at the next start or reduce
+        """
+
+        for name, function in self.functions.items():
+            self.local_values[self.index[name]] = function()
+
+        self.evaluated = True
+
+    def _evaluate(self):
+
+        if not self.evaluated:
+            self.evaluate()
+        self.evaluated = False
+
+    def start(self):
+        """Start reducing the local values, complete with wait
+        """
+
+        assert self.request is None, 'Reduction already started'
+
+        self._evaluate()
+
+        op = self._get_op()
+        if op is None:
+            # Sequential, the global values are the local values
+            self.global_values[:] = self.local_values
+        else:
+            self.request = pypar.iallreduce(self.local_values, op,
+                                            self.global_values)
+
+    def pending(self):
+        """True if a reduction has been started and not waited for
+        """
+
+        return self.request is not None
+
+    def wait(self):
+        """Complete the reduction started by start
+        """
+
+        if self.request is not None:
+            pypar.wait(self.request)
+            self.request = None
+
+    def reduce(self):
+        """Reduce the local values
+        """
+
+        self._evaluate()
+
+        op = self._get_op()
+        if op is None:
+            self.global_values[:] = self.local_values
+        else:
+            pypar.allreduce(self.local_values, op,
+                            buffer=self.global_values, bypass=True)
+
+    def get_value(self, name):
+        """Global value of name from the last reduction
+        """
+
+        return self.global_values[self.index[name]]
@@ -26,7 +26,7 @@ from anuga.parallel.parallel_shallow_water import Parallel_domain
 
 class Sequential_distribute(object):
 
-    def __init__(self, domain, verbose=False, debug=False, parameters=None):
+    def __init__(self, domain, verbose=False, debug=False, parameters=None, weights=None):
 
         if debug:
             verbose = True
@@ -35,6 +35,7 @@ class Sequential_distribute(object):
         self.verbose = verbose
         self.debug = debug
         self.parameters = parameters
+        self.weights = weights
 
 
     def distribute(self, numprocs=1):
@@ -76,7 +77,7 @@ class Sequential_distribute(object):
 
         new_nodes, new_triangles, new_boundary, triangles_per_proc, quantities, \
                s2p_map, p2s_map = \
-               pmesh_divide_metis_with_map(domain, numprocs)
+               pmesh_divide_metis_with_map(domain, numprocs, weights=self.weights)
 
 
         # Build the mesh that should be assigned to each processor,
@@ -217,13 +218,13 @@ class Sequential_distribute(object):
 
 
 
-def sequential_distribute_dump(domain, numprocs=1, verbose=False, partition_dir='.', debug=False, parameters = None):
+def sequential_distribute_dump(domain, numprocs=1, verbose=False, partition_dir='.', debug=False, parameters = None, weights = None):
     """ Distribute the domain, create parallel domain and pickle result
     """
 
     from os.path import join
 
-    partition = Sequential_distribute(domain, verbose, debug, parameters)
+    partition = Sequential_distribute(domain, verbose, debug, parameters, weights)
 
     partition.distribute(numprocs)
 
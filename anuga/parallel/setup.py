@@ -1,4 +1,11 @@
 
+from __future__ import division, print_function
+
+from Cython.Build import cythonize
+import Cython.Compiler.Options
+Cython.Compiler.Options.annotate = True
+
+
 def configuration(parent_package='',top_path=None):
     
     from numpy.distutils.misc_util import Configuration
@@ -9,6 +16,11 @@ def configuration(parent_package='',top_path=None):
 
     config.add_data_dir('tests')
     config.add_data_dir('data')
+
+    config.add_extension('halo_exchange_ext',
+                         sources=['halo_exchange_ext.pyx'])
+
+    config.ext_modules = cythonize(config.ext_modules, annotate=True)
     
     return config
     
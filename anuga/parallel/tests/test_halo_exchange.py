@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+
+import unittest
+
+import numpy as num
+
+import anuga
+from anuga import Domain
+
+from anuga.parallel.halo_exchange_ext import pack_halo, unpack_halo
+from anuga.parallel.parallel_shallow_water import Parallel_domain
+
+
+class Test_halo_exchange(unittest.TestCase):
+    def setUp(self):
+        pass
+
+    def tearDown(self):
+        pass
+
+    def test_pack_unpack(self):
+
+        quantities = [num.arange(10, dtype=float), 10.0 + num.arange(10, dtype=float)]
+        ids = num.array([7, 2, 5], int)
+
+        buffer = num.zeros(6, float)
+        pack_halo(quantities, ids, buffer)
+        assert num.all(buffer == [7, 17, 2, 12, 5, 15])
+
+        ghost_ids = num.array([0, 1, 9], int)
+        unpack_halo(quantities, ghost_ids, buffer)
+        assert num.all(quantities[0][ghost_ids] == [7, 2, 5])
+        assert num.all(quantities[1][ghost_ids] == [17, 12, 15])
+
+        # Nothing to exchange
+        pack_halo(quantities, num.zeros(0, int), num.zeros(0, float))
+        unpack_halo([], ghost_ids, buffer)
+
+    def test_packed_update_ghosts(self):
+        """The packed exchange updates the ghost cells as the python
+        update of ghost cells from full cells of the same processor
+        """
+
+        def create_domain(domain_class):
+            points, vertices, boundary = anuga.rectangular_cross(10, 10)
+
+            x = num.mean(num.array(points)[num.array(vertices), 0], axis=1)
+            ghost = num.flatnonzero(x > 0.8)
+            full = num.flatnonzero(x < 0.2)
+
+            domain = domain_class(points, vertices, boundary,
+                                  full_send_dict={0: [full, full]},
+                                  ghost_recv_dict={0: [ghost, ghost]},
+                                  processor=0, numproc=1)
+            domain.set_quantity('stage', lambda x, y: x + 2*y, location='centroids')
+            domain.set_quantity('xmomentum', lambda x, y: x*y, location='centroids')
+            domain.set_quantity('ymomentum', lambda x, y: x - y, location='centroids')
+            return domain
+
+        domain_1 = create_domain(Domain)
+        domain_2 = create_domain(Parallel_domain)
+        domain_3 = create_domain(Parallel_domain)
+
+        domain_1.update_ghosts()
+        domain_2.update_ghosts()
+        domain_3.post_ghost_exchange()
+        domain_3.complete_ghost_exchange()
+
+        for name in ['stage', 'xmomentum', 'ymomentum']:
+            Q_1 = domain_1.quantities[name].centroid_values
+            Q_2 = domain_2.quantities[name].centroid_values
+            Q_3 = domain_3.quantities[name].centroid_values
+            assert num.any(Q_1 != create_domain(Domain).quantities[name].centroid_values)
+            assert num.all(Q_1 == Q_2)
+            assert num.all(Q_1 == Q_3)
+
+        # Other quantities have their own exchange
+        domain_1.update_ghosts(['elevation', 'stage'])
+        domain_2.update_ghosts(['elevation', 'stage'])
+        assert len(domain_2.halo_exchanges) == 2
+        assert num.all(domain_1.quantities['elevation'].centroid_values ==
+                       domain_2.quantities['elevation'].centroid_values)
+
+    def test_pickle_after_update_ghosts(self):
+        """A parallel domain can be pickled (checkpointed) after a ghost
+        update, without its persistent requests, and sets up its halo
+        exchange again on the next ghost update
+        """
+
+        import pickle
+
+        points, vertices, boundary = anuga.rectangular_cross(10, 10)
+
+        x = num.mean(num.array(points)[num.array(vertices), 0], axis=1)
+        ghost = num.flatnonzero(x > 0.8)
+        full = num.flatnonzero(x < 0.2)
+
+        domain = Parallel_domain(points, vertices, boundary,
+                                 full_send_dict={0: [full, full]},
+                                 ghost_recv_dict={0: [ghost, ghost]},
+                                 processor=0, numproc=1)
+        domain.set_quantity('stage', lambda x, y: x + 2*y, location='centroids')
+        domain.update_ghosts()
+        assert len(domain.halo_exchanges) == 1
+
+        assert domain.__getstate__()['halo_exchanges'] == {}
+        assert len(domain.halo_exchanges) == 1
+
+        copy = pickle.loads(pickle.dumps(domain))
+        assert copy.halo_exchanges == {}
+
+        stage = copy.quantities['stage'].centroid_values
+        stage[full] += 1.0
+        copy.update_ghosts()
+        assert len(copy.halo_exchanges) == 1
+        assert num.all(stage[ghost] == stage[full])
+
+
+#-------------------------------------------------------------
+
+if __name__ == "__main__":
+    suite = unittest.makeSuite(Test_halo_exchange, 'test')
+    runner = unittest.TextTestRunner()
+    runner.run(suite)
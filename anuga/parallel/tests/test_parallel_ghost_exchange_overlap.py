@@ -0,0 +1,195 @@
+"""
+Parallel run with the ghost exchange overlapped with the computation of
+the interior cells (see Domain.set_ghost_exchange_overlap), checked
+against the sequential run at gauge points
+"""
+from __future__ import print_function
+from __future__ import division
+
+
+#------------------------------------------------------------------------------
+# Import necessary modules
+#------------------------------------------------------------------------------
+from builtins import range
+from future.utils import raise_
+import unittest
+import os
+import sys
+import numpy as num
+
+import anuga
+
+from anuga import Reflective_boundary
+from anuga import Dirichlet_boundary
+from anuga import rectangular_cross_domain
+
+from anuga import distribute, myid, numprocs, barrier, finalize
+
+# Setup to skip test if mpi4py not available
+import sys
+try:
+    import mpi4py
+except ImportError:
+    pass
+
+import pytest
+
+#--------------------------------------------------------------------------
+# Setup parameters
+#--------------------------------------------------------------------------
+yieldstep = 0.25
+finaltime = 1.0
+nprocs = 4
+N = 29
+M = 29
+verbose = False
+
+
+#---------------------------------
+# Setup Functions
+#---------------------------------
+def topography(x,y):
+    return -x/2.0
+
+###########################################################################
+# Setup Test
+##########################################################################
+def run_simulation(parallel=False, G=None, verbose=False):
+
+    #--------------------------------------------------------------------------
+    # Setup computational domain and quantities
+    #--------------------------------------------------------------------------
+    domain = rectangular_cross_domain(M, N)
+    domain.set_flow_algorithm('DE1')
+    domain.set_native_evolve(True)
+    domain.set_quantity('elevation', topography)
+    domain.set_quantity('friction', 0.0)
+    domain.set_quantity('stage', expression='elevation')
+
+    #--------------------------------------------------------------------------
+    # Create the parallel domain
+    #--------------------------------------------------------------------------
+    if parallel:
+        if myid == 0 and verbose : print('DISTRIBUTING PARALLEL DOMAIN')
+        domain = distribute(domain, verbose=False)
+        domain.set_native_evolve(True)
+        domain.set_ghost_exchange_overlap(True)
+
+    domain.set_name('ghost_exchange_overlap')
+    domain.set_datadir('.')
+    domain.set_quantities_to_be_stored(None)
+
+    Br = Reflective_boundary(domain)
+    Bd = Dirichlet_boundary([-0.2,0.,0.])
+    domain.set_boundary({'left': Br, 'right': Bd, 'top': Br, 'bottom': Br})
+
+    #------------------------------------------------------------------------------
+    # Gauges at the full triangles of the processor
+    #------------------------------------------------------------------------------
+    interpolation_points = [[0.4,0.5], [0.6,0.5], [0.8,0.5], [0.9,0.5]]
+
+    gauge_values = []
+    tri_ids = []
+    for i, point in enumerate(interpolation_points):
+        gauge_values.append([])
+
+        try:
+            k = domain.get_triangle_containing_point(point)
+            if domain.tri_full_flag[k] == 1:
+                tri_ids.append(k)
+            else:
+                tri_ids.append(-1)
+        except:
+            tri_ids.append(-2)
+
+    #------------------------------------------------------------------------------
+    # Evolve system through time
+    #------------------------------------------------------------------------------
+    number_of_steps = 0
+    for t in domain.evolve(yieldstep = yieldstep, finaltime = finaltime):
+        if myid == 0 and verbose : domain.write_time()
+        number_of_steps += domain.number_of_steps
+
+        stage = domain.get_quantity('stage')
+
+        for i in range(4):
+            if tri_ids[i] > -1:
+                gauge_values[i].append(stage.centroid_values[tri_ids[i]])
+
+    if not parallel:
+        G = []
+        for i in range(4):
+            G.append(gauge_values[i])
+
+    success = True
+
+    for i in range(4):
+        if tri_ids[i] > -1:
+            success = success and num.allclose(gauge_values[i], G[i])
+
+    assert_(success)
+
+    # With the overlap the protection is split in two for each of the
+    # two rk2 substeps
+    if parallel:
+        protect_calls = domain.get_kernel_timing()['protect']['calls']
+        assert_(protect_calls > 3*number_of_steps)
+
+    # A parallel domain can be checkpointed after its ghost exchanges,
+    # and the copy sets up its exchanges with the other processors again
+    if parallel:
+        import pickle
+        copy = pickle.loads(pickle.dumps(domain))
+        assert_(copy.halo_exchanges == {})
+
+        stage = copy.quantities['stage'].centroid_values
+        expected = stage.copy()
+        ghosts = num.flatnonzero(copy.tri_full_flag == 0)
+        stage[ghosts] = num.nan
+        copy.update_ghosts()
+        assert_(num.all(stage == expected))
+
+    return G
+
+
+@pytest.mark.skipif('mpi4py' not in sys.modules,
+                    reason="requires the mpi4py module")
+class Test_parallel_ghost_exchange_overlap(unittest.TestCase):
+    def test_parallel_ghost_exchange_overlap(self):
+        if verbose : print("Expect this test to fail if not run from the parallel directory.")
+
+        cmd = anuga.mpicmd(os.path.abspath(__file__))
+        result = os.system(cmd)
+
+        assert_(result == 0)
+
+# Because we are doing assertions outside of the TestCase class
+# the PyUnit defined assert_ function can't be used.
+def assert_(condition, msg="Assertion Failed"):
+    if condition == False:
+        raise_(AssertionError, msg)
+
+if __name__=="__main__":
+    if numprocs == 1:
+        runner = unittest.TextTestRunner()
+        suite = unittest.makeSuite(Test_parallel_ghost_exchange_overlap, 'test')
+        runner.run(suite)
+    else:
+
+        barrier()
+        if myid == 0 and verbose: print('SEQUENTIAL START')
+
+        G = run_simulation(parallel=False, verbose=verbose)
+        G = num.array(G,float)
+
+        barrier()
+
+        if myid ==0 and verbose: print('PARALLEL START')
+
+        from anuga.utilities.parallel_abstraction import global_except_hook
+        import sys
+        sys.excepthook = global_except_hook
+
+        run_simulation(parallel=True, G=G, verbose=verbose)
+
+        finalize()
@@ -0,0 +1,200 @@
+"""
+Parallel run repartitioned half way by rebalance, checked against the
+sequential run at gauge points
+"""
+from __future__ import print_function
+from __future__ import division
+
+
+#------------------------------------------------------------------------------
+# Import necessary modules
+#------------------------------------------------------------------------------
+from builtins import range
+from future.utils import raise_
+import unittest
+import os
+import sys
+import numpy as num
+
+import anuga
+
+from anuga import Reflective_boundary
+from anuga import Dirichlet_boundary
+from anuga import rectangular_cross_domain
+
+from anuga import distribute, rebalance, myid, numprocs, barrier, finalize
+
+# Setup to skip test if mpi4py not available
+import sys
+try:
+    import mpi4py
+except ImportError:
+    pass
+
+import pytest
+
+#--------------------------------------------------------------------------
+# Setup parameters
+#--------------------------------------------------------------------------
+yieldstep = 0.25
+rebalance_time = 0.5
+finaltime = 1.0
+N = 29
+M = 29
+verbose = False
+
+#---------------------------------
+# Setup Functions
+#---------------------------------
+def topography(x,y):
+    return -x/2.0
+
+def set_boundaries(domain):
+
+    Br = Reflective_boundary(domain)
+    Bd = Dirichlet_boundary([-0.2,0.,0.])
+    domain.set_boundary({'left': Br, 'right': Bd, 'top': Br, 'bottom': Br})
+
+def set_kernel_settings(domain):
+    """Settings which leave the results unchanged, and which have to
+    survive the rebalance"""
+
+    domain.set_multiprocessor_mode(1)
+    domain.set_native_evolve(True)
+    domain.set_native_boundaries(True)
+    domain.set_ghost_exchange_overlap(True)
+    domain.set_lazy_vertex_values(True)
+    domain.set_vertex_output_precision('single')
+    domain.set_quantity_arena('quantity')
+
+def assert_kernel_settings(domain):
+
+    assert_(domain.get_multiprocessor_mode() == 1)
+    assert_(domain.get_native_evolve())
+    assert_(domain.get_native_boundaries())
+    assert_(domain.get_ghost_exchange_overlap())
+    assert_(domain.get_lazy_vertex_values())
+    assert_(domain.get_vertex_output_precision() == 'single')
+    assert_(domain.get_quantity_arena().policy == 'quantity')
+
+def get_gauge_triangles(domain):
+    """Full triangles of the domain holding the gauge points"""
+
+    interpolation_points = [[0.4,0.5], [0.6,0.5], [0.8,0.5], [0.9,0.5]]
+
+    tri_ids = []
+    for point in interpolation_points:
+        try:
+            k = domain.get_triangle_containing_point(point)
+            if domain.tri_full_flag[k] == 1:
+                tri_ids.append(k)
+            else:
+                tri_ids.append(-1)
+        except:
+            tri_ids.append(-2)
+
+    return tri_ids
+
+def record_gauges(domain, tri_ids, gauge_values):
+
+    stage = domain.get_quantity('stage')
+    for i in range(4):
+        if tri_ids[i] > -1:
+            gauge_values[i].append(stage.centroid_values[tri_ids[i]])
+        else:
+            gauge_values[i].append(None)
+
+###########################################################################
+# Setup Test
+##########################################################################
+def run_simulation(parallel=False, G=None, verbose=False):
+
+    domain = rectangular_cross_domain(M, N)
+    domain.set_quantity('elevation', topography)
+    domain.set_quantity('friction', 0.0)
+    domain.set_quantity('stage', expression='elevation')
+
+    if parallel:
+        if myid == 0 and verbose : print('DISTRIBUTING PARALLEL DOMAIN')
+        domain = distribute(domain, verbose=False)
+        set_kernel_settings(domain)
+
+    domain.set_name('rebalance')
+    domain.set_datadir('.')
+    domain.set_store(False)
+    set_boundaries(domain)
+
+    gauge_values = [[], [], [], []]
+    tri_ids = get_gauge_triangles(domain)
+
+    for t in domain.evolve(yieldstep = yieldstep, finaltime = rebalance_time):
+        record_gauges(domain, tri_ids, gauge_values)
+
+    if parallel:
+        # Force the repartition, with most of the cost on the wet cells
+        domain = rebalance(domain, threshold=0.0, verbose=verbose)
+        assert_(domain.number_of_rebalances == 1)
+        assert_(domain.get_time() == rebalance_time)
+        assert_kernel_settings(domain)
+
+        domain.set_store(False)
+        set_boundaries(domain)
+        tri_ids = get_gauge_triangles(domain)
+
+    for t in domain.evolve(yieldstep = yieldstep, finaltime = finaltime):
+        if t == rebalance_time:
+            continue
+        record_gauges(domain, tri_ids, gauge_values)
+
+    if not parallel:
+        return gauge_values
+
+    success = True
+    for i in range(4):
+        for value, expected in zip(gauge_values[i], G[i]):
+            if value is not None:
+                success = success and num.allclose(value, expected)
+
+    assert_(success)
+
+
+@pytest.mark.skipif('mpi4py' not in sys.modules,
+                    reason="requires the mpi4py module")
+class Test_parallel_rebalance(unittest.TestCase):
+    def test_parallel_rebalance(self):
+        if verbose : print("Expect this test to fail if not run from the parallel directory.")
+
+        cmd = anuga.mpicmd(os.path.abspath(__file__))
+        result = os.system(cmd)
+
+        assert_(result == 0)
+
+# Because we are doing assertions outside of the TestCase class
+# the PyUnit defined assert_ function can't be used.
+def assert_(condition, msg="Assertion Failed"):
+    if condition == False:
+        raise_(AssertionError, msg)
+
+if __name__=="__main__":
+    if numprocs == 1:
+        runner = unittest.TextTestRunner()
+        suite = unittest.makeSuite(Test_parallel_rebalance, 'test')
+        runner.run(suite)
+    else:
+
+        barrier()
+        if myid == 0 and verbose: print('SEQUENTIAL START')
+
+        G = run_simulation(parallel=False, verbose=verbose)
+
+        barrier()
+
+        if myid ==0 and verbose: print('PARALLEL START')
+
+        from anuga.utilities.parallel_abstraction import global_except_hook
+        import sys
+        sys.excepthook = global_except_hook
+
+        run_simulation(parallel=True, G=G, verbose=verbose)
+
+        finalize()
@@ -0,0 +1,146 @@
+#!/usr/bin/env python
+
+import unittest
+
+import numpy as num
+
+import anuga
+from anuga import Domain
+
+from anuga.parallel import config
+from anuga.parallel.distribute_mesh import pmesh_divide_metis_helper
+from anuga.parallel.distribute_mesh import metis_vertex_weights
+from anuga.parallel.parallel_shallow_water import Parallel_domain
+from anuga.parallel.rebalance import cell_costs, load_imbalance, rebalance
+from anuga.parallel.rebalance import copy_domain_settings
+
+
+class Test_rebalance(unittest.TestCase):
+    def setUp(self):
+        pass
+
+    def tearDown(self):
+        pass
+
+    def test_cell_costs(self):
+
+        points, vertices, boundary = anuga.rectangular_cross(4, 4)
+        domain = Parallel_domain(points, vertices, boundary,
+                                 processor=0, numproc=1)
+        domain.set_quantity('elevation', 0.0)
+        domain.set_quantity('stage', lambda x, y: 1.0*(x < 0.5))
+
+        x = domain.centroid_coordinates[:, 0]
+
+        costs = cell_costs(domain, dry_cell_cost=0.25)
+        assert num.all(costs[x < 0.5] == 1.0)
+        assert num.all(costs[x > 0.5] == 0.25)
+
+        costs = cell_costs(domain)
+        assert num.all(costs[x > 0.5] == config.dry_cell_cost)
+
+        # Riverwall cells cost more
+        domain.edge_flux_type[3*5 + 1] = 1
+        costs = cell_costs(domain, dry_cell_cost=0.25, riverwall_cell_cost=4.0)
+        assert costs[5] == 4.0*(1.0 if x[5] < 0.5 else 0.25)
+
+        assert load_imbalance(domain, costs) == 1.0
+
+        # Nothing to repartition on one processor
+        assert rebalance(domain, costs, threshold=0.0) is domain
+        assert domain.number_of_rebalances == 0
+
+    def test_copy_domain_settings(self):
+        """The evolve and kernel settings carry over to the rebalanced
+        domain rather than falling back to the config defaults
+        """
+
+        points, vertices, boundary = anuga.rectangular_cross(4, 4)
+        domain = Parallel_domain(points, vertices, boundary,
+                                 processor=0, numproc=1)
+        new_domain = Parallel_domain(points, vertices, boundary,
+                                     processor=0, numproc=1)
+
+        domain.set_flow_algorithm('DE0')
+        new_domain.set_flow_algorithm('DE0')
+
+        domain.set_CFL(0.5)
+        domain.set_evolve_max_timestep(0.01)
+        domain.set_ghost_exchange_period(2)
+        domain.set_nonblocking_step_reduction(True)
+        domain.set_multiprocessor_mode(1)
+        domain.set_edge_based_fluxes(True)
+        domain.set_simd_fluxes(True)
+        domain.set_native_evolve(True)
+        domain.set_native_boundaries(True)
+        domain.set_ghost_exchange_overlap(True)
+        domain.set_active_cell_compaction(True)
+        domain.set_local_extrapolation_and_flux_updating(nlevels=2)
+        domain.set_vertex_output_precision('single')
+        domain.set_lazy_vertex_values(True)
+        domain.set_quantity_arena('array')
+        domain.set_kernel_timing_file('kernel_timing.json')
+        try:
+            domain.set_hardware_counters(True)
+        except OSError:
+            pass
+
+        copy_domain_settings(domain, new_domain)
+
+        assert new_domain.get_timestepping_method() == domain.get_timestepping_method()
+        assert new_domain.get_CFL() == 0.5
+        assert new_domain.evolve_max_timestep == 0.01
+        assert new_domain.get_ghost_exchange_period() == 2
+        assert new_domain.get_nonblocking_step_reduction()
+        assert new_domain.get_multiprocessor_mode() == 1
+        assert new_domain.get_edge_based_fluxes()
+        assert new_domain.get_simd_fluxes()
+        assert new_domain.get_native_evolve()
+        assert new_domain.get_native_boundaries()
+        assert new_domain.get_ghost_exchange_overlap()
+        assert new_domain.get_active_cell_compaction()
+        assert new_domain.max_flux_update_frequency == 4
+        assert new_domain.get_vertex_output_precision() == 'single'
+        assert new_domain.quantities['stage'].vertex_values.dtype == num.float32
+        assert new_domain.get_lazy_vertex_values()
+        assert new_domain.get_quantity_arena().policy == 'array'
+        assert new_domain.get_kernel_timing_file() == 'kernel_timing.json'
+        assert new_domain.get_hardware_counters() == domain.get_hardware_counters()
+
+        domain.set_hardware_counters(False)
+        new_domain.set_hardware_counters(False)
+
+    def test_metis_vertex_weights(self):
+
+        weights = metis_vertex_weights([0.5, 1.5, 0.0, 2.0])
+        assert weights == [50, 150, 1, 200]
+
+    def test_weighted_metis_partition(self):
+        """With weights the partition balances the weights rather than
+        the number of triangles
+        """
+
+        domain = Domain(*anuga.rectangular_cross(10, 10))
+        x = domain.centroid_coordinates[:, 0]
+        weights = num.where(x < 0.5, 9.0, 1.0)
+
+        nodes, triangles, boundary, triangles_per_proc, quantities, \
+            tri_index, p2s_map = pmesh_divide_metis_helper(domain, 2)
+        assert abs(triangles_per_proc[0] - triangles_per_proc[1]) <= 0.05*len(domain)
+
+        nodes, triangles, boundary, triangles_per_proc, quantities, \
+            tri_index, p2s_map = pmesh_divide_metis_helper(domain, 2, weights)
+
+        w = weights[p2s_map]
+        w0 = num.sum(w[:triangles_per_proc[0]])
+        w1 = num.sum(w[triangles_per_proc[0]:])
+        assert abs(w0 - w1) <= 0.1*num.sum(weights)
+        assert abs(triangles_per_proc[0] - triangles_per_proc[1]) > 0.2*len(domain)
+
+
+#-------------------------------------------------------------
+
+if __name__ == "__main__":
+    suite = unittest.makeSuite(Test_rebalance, 'test')
+    runner = unittest.TextTestRunner()
+    runner.run(suite)
@@ -0,0 +1,190 @@
+#!/usr/bin/env python
+
+import unittest
+
+import numpy as num
+
+import anuga
+
+from functools import partial
+
+from anuga.parallel.reduction_batch import Reduction_batch, min_sum_function
+from anuga.parallel.parallel_shallow_water import Parallel_domain
+
+
+# Lane functions, module level so that the batches can be pickled
+def volume():
+    return 2.5
+
+def speed():
+    return 3.0
+
+def max_stage(domain):
+    return domain.quantities['stage'].centroid_values.max()
+
+
+class Test_reduction_batch(unittest.TestCase):
+    def setUp(self):
+        pass
+
+    def tearDown(self):
+        pass
+
+    def test_lanes(self):
+
+        batch = Reduction_batch()
+        batch.add_lane('timestep', 'min')
+        batch.add_lane('volume', 'sum', volume)
+        batch.add_lane('speed', 'min', speed)
+
+        # Min lanes first
+        assert batch.get_lanes() == ['timestep', 'speed', 'volume']
+
+        batch.set_value('timestep', 0.1)
+        batch.reduce()
+        assert batch.get_value('timestep') == 0.1
+        assert batch.get_value('volume') == 2.5
+        assert batch.get_value('speed') == 3.0
+
+        batch.set_value('timestep', 0.2)
+        batch.start()
+        batch.wait()
+        assert batch.get_value('timestep') == 0.2
+
+        # Local values taken by evaluate are used by the next reduction
+        volumes = [1.0, 2.0]
+        batch.add_lane('moving', 'sum', lambda: volumes[0])
+        batch.evaluate()
+        volumes[0] = 5.0
+        batch.reduce()
+        assert batch.get_value('moving') == 1.0
+        batch.reduce()
+        assert batch.get_value('moving') == 5.0
+        batch.remove_lane('moving')
+
+        batch.remove_lane('speed')
+        assert batch.get_lanes() == ['timestep', 'volume']
+
+        self.assertRaises(ValueError, batch.add_lane, 'volume', 'sum')
+        self.assertRaises(ValueError, batch.add_lane, 'mass', 'max')
+
+    def test_pickle(self):
+        """A batch is pickled without its reduction operation"""
+
+        import pickle
+
+        batch = Reduction_batch()
+        batch.add_lane('timestep', 'min')
+        batch.add_lane('volume', 'sum', volume)
+        batch.set_value('timestep', 0.1)
+        batch.reduce()
+
+        batch = pickle.loads(pickle.dumps(batch))
+        assert batch.op is None
+        assert not batch.created_op
+        assert batch.get_lanes() == ['timestep', 'volume']
+        assert batch.get_value('timestep') == 0.1
+
+        batch.set_value('timestep', 0.2)
+        batch.reduce()
+        assert batch.get_value('timestep') == 0.2
+        assert batch.get_value('volume') == 2.5
+
+        batch.start()
+        self.assertRaises(AssertionError, pickle.dumps, batch)
+        batch.wait()
+
+        # The reduction function too
+        min_sum = pickle.loads(pickle.dumps(min_sum_function(1)))
+        b = num.array([4.0, 0.5])
+        min_sum(num.array([1.0, 5.0]), b, None)
+        assert num.all(b == [1.0, 5.5])
+
+    def test_min_sum_function(self):
+
+        min_sum = min_sum_function(2)
+
+        a = num.array([1.0, 5.0, 2.0, 3.0])
+        b = num.array([4.0, 0.5, 1.0, -1.0])
+        min_sum(a, b, None)
+
+        assert num.all(b == [1.0, 0.5, 3.0, 2.0])
+
+    def test_step_reduction(self):
+        """Per-step reductions of a parallel domain are available after
+        each timestep
+        """
+
+        points, vertices, boundary = anuga.rectangular_cross(5, 5)
+        domain = Parallel_domain(points, vertices, boundary,
+                                 processor=0, numproc=1)
+        domain.set_store(False)
+        domain.set_quantity('stage', lambda x, y: 0.5 + 0.5*(x < 0.5))
+        domain.set_boundary({'left': anuga.Reflective_boundary(domain),
+                             'right': anuga.Reflective_boundary(domain),
+                             'top': anuga.Reflective_boundary(domain),
+                             'bottom': anuga.Reflective_boundary(domain)})
+
+        domain.add_step_reduction('max_stage', 'sum', partial(max_stage, domain))
+
+        for t in domain.evolve(yieldstep=0.01, finaltime=0.01):
+            pass
+
+        assert domain.get_time() == 0.01
+        assert domain.get_step_reduction('flux_timestep') > 0.0
+        assert 0.5 < domain.get_step_reduction('max_stage') <= 1.0
+
+        # Pickled (checkpointed) with its step reductions
+        import pickle
+        domain = pickle.loads(pickle.dumps(domain))
+        for t in domain.evolve(yieldstep=0.01, finaltime=0.02):
+            pass
+
+        assert domain.get_time() == 0.02
+        assert 0.5 < domain.get_step_reduction('max_stage') <= 1.0
+
+    def test_nonblocking_step_reduction(self):
+        """The timesteps, and the values of the step reductions, are the
+        same with the reduction started before the forcing terms
+        """
+
+        timesteps = []
+        momenta = []
+        for flag in [False, True]:
+            points, vertices, boundary = anuga.rectangular_cross(5, 5)
+            domain = Parallel_domain(points, vertices, boundary,
+                                     processor=0, numproc=1)
+            domain.set_store(False)
+            domain.set_nonblocking_step_reduction(flag)
+            domain.set_quantity('elevation', lambda x, y: -x/10.0)
+            domain.set_quantity('friction', 0.03)
+            domain.set_quantity('stage', lambda x, y: 0.5 + 0.5*(x < 0.5))
+            Br = anuga.Reflective_boundary(domain)
+            domain.set_boundary({'left': Br, 'right': Br, 'top': Br, 'bottom': Br})
+
+            # Changed by the friction forcing term
+            values = []
+            def momentum(domain=domain):
+                xmomentum = domain.quantities['xmomentum'].centroid_values
+                values.append(num.sum(num.abs(xmomentum)))
+                return values[-1]
+            domain.add_step_reduction('momentum', 'sum', momentum)
+
+            for t in domain.evolve(yieldstep=0.01, finaltime=0.02):
+                pass
+
+            assert not domain.reduction_batch.pending()
+            timesteps.append((domain.number_of_steps, domain.recorded_min_timestep))
+            momenta.append(values)
+
+        assert timesteps[0] == timesteps[1]
+        assert len(momenta[0]) > 1
+        assert momenta[0] == momenta[1]
+
+
+#-------------------------------------------------------------
+
+if __name__ == "__main__":
+    suite = unittest.makeSuite(Test_reduction_batch, 'test')
+    runner = unittest.TextTestRunner()
+    runner.run(suite)
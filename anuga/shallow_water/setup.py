@@ -30,9 +30,22 @@ def configuration(parent_package='',top_path=None):
                          sources=['swb2_domain_ext.pyx'],
                          include_dirs=[util_dir])
 
+    if sys.platform == 'darwin':
+        extra_args = None
+    else:
+        extra_args = ['-fopenmp']
+
+    # sqrt without errno, so the batched flux function can be vectorised
+    if sys.platform == 'win32':
+        extra_compile_args = extra_args
+    else:
+        extra_compile_args = (extra_args or []) + ['-fno-math-errno']
+
     config.add_extension('swDE1_domain_ext',
                          sources=['swDE1_domain_ext.pyx'],
-                         include_dirs=[util_dir])
+                         include_dirs=[util_dir],
+                         extra_compile_args=extra_compile_args,
+                         extra_link_args=extra_args)
 
     config.ext_modules = cythonize(config.ext_modules, annotate=True)
 
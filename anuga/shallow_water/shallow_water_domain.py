@@ -173,6 +173,14 @@ class Domain(Generic_Domain):
 
     """
 
+    first_touch_array_names = Generic_Domain.first_touch_array_names + \
+        ['edge_flux_type', 'edge_flux_work', 'pressuregrad_work',
+         'x_centroid_work', 'y_centroid_work', 'flux_update_frequency',
+         'update_next_flux', 'update_extrapolation',
+         'triangle_flux_update_frequency', 'flux_update_cells',
+         'edge_timestep', 'active_cells', 'extrapolation_cells',
+         'active_cell_distance', 'active_cell_changed', 'active_cell_state']
+
     def __init__(self,
                  coordinates=None,
                  vertices=None,
@@ -194,6 +202,7 @@ class Domain(Generic_Domain):
                  number_of_full_nodes=None,
                  number_of_full_triangles=None,
                  ghost_layer_width=2,
+                 mesh_ordering=None,
                  **kwargs):
 
         """Instantiate a shallow water domain.
@@ -238,7 +247,8 @@ class Domain(Generic_Domain):
                             numproc,
                             number_of_full_nodes=number_of_full_nodes,
                             number_of_full_triangles=number_of_full_triangles,
-                            ghost_layer_width=ghost_layer_width)
+                            ghost_layer_width=ghost_layer_width,
+                            mesh_ordering=mesh_ordering)
 
         #-------------------------------
         # Operator Data Structures
@@ -253,6 +263,29 @@ class Domain(Generic_Domain):
         #-------------------------------
         self.set_flow_algorithm()
 
+        #-------------------------------
+        # Serial or threaded C kernels
+        #-------------------------------
+        from anuga.config import multiprocessor_mode, edge_based_fluxes, simd_fluxes
+        from anuga.config import native_evolve, native_boundaries
+        from anuga.config import active_cell_compaction, vertex_output_precision
+        from anuga.config import lazy_vertex_values, quantity_arena, ghost_exchange_overlap
+        self.set_multiprocessor_mode(multiprocessor_mode)
+        self.edge_structure = None
+        self.c_domain_struct = None
+        self.set_edge_based_fluxes(edge_based_fluxes)
+        self.set_simd_fluxes(simd_fluxes)
+        self.set_native_evolve(native_evolve)
+        self.boundary_structure = None
+        self.set_native_boundaries(native_boundaries)
+        self.set_active_cell_compaction(active_cell_compaction)
+        self.vertex_output_precision = 'double'
+        self.set_vertex_output_precision(vertex_output_precision)
+        self.set_lazy_vertex_values(lazy_vertex_values)
+        self.set_quantity_arena(quantity_arena)
+        self.overlap_cells = None
+        self.set_ghost_exchange_overlap(ghost_exchange_overlap)
+
         #-------------------------------
         # datetime and timezone
         #-------------------------------
@@ -314,6 +347,12 @@ class Domain(Generic_Domain):
         max_time_substeps=3 # Maximum number of substeps supported by any timestepping method
         # boundary_flux_sum holds boundary fluxes on each sub-step [unused substeps = 0.]
         self.boundary_flux_sum=num.array([0.]*max_time_substeps)
+        # Edges of full triangles which are on the boundary, or next to a ghost
+        # triangle. These are the edges which contribute to boundary_flux_sum
+        neighbours = self.neighbours.flatten()
+        full_edge = num.repeat(self.tri_full_flag, 3) == 1
+        ghost_neighbour = (neighbours >= 0) & (self.tri_full_flag[num.maximum(neighbours, 0)] == 0)
+        self.boundary_flux_edges = num.flatnonzero(full_edge & ((neighbours < 0) | ghost_neighbour)).astype(int)
         from anuga.operators.boundary_flux_integral_operator import boundary_flux_integral_operator
         self.boundary_flux_integral=boundary_flux_integral_operator(self)
         # Make an integer counting how many times we call compute_fluxes_central -- so we know which substep we are on
@@ -345,6 +384,15 @@ class Domain(Generic_Domain):
         # (Only do this if one or more of the fluxes on that triangle will be computed on
         # the next timestep, assuming only the flux computation uses edge/vertex values)
         self.update_extrapolation=num.zeros(old_div(len(self.edge_coordinates[:,0]),3)).astype(int)+1
+        # Work array: smallest flux_update_frequency of the edges of each triangle
+        self.triangle_flux_update_frequency=num.zeros(old_div(len(self.edge_coordinates[:,0]),3)).astype(int)+1
+        # Number of edges due for a flux update, and number of edges,
+        # summed over timesteps (see get_flux_update_statistics)
+        self.flux_update_statistics=num.zeros(2).astype(int)
+        # Triangles with a flux due on the next flux computation, listed by
+        # compute_flux_update_frequency (-1: not listed yet, visit all)
+        self.flux_update_cells=num.zeros(old_div(len(self.edge_coordinates[:,0]),3)).astype(int)
+        self.number_of_flux_update_cells=num.zeros(1).astype(int)-1
 
         # edge_timestep [wavespeed/radius] -- not updated every timestep
         self.edge_timestep=num.zeros(len(self.edge_coordinates[:,0]))+1.0e+100
@@ -353,6 +401,41 @@ class Domain(Generic_Domain):
         # extrapolation/flux updating is used)
         self.allow_timestep_increase=num.zeros(1).astype(int)+1
 
+        # State of the DE flux computation kept between calls. This is held
+        # by the domain (not the C code) so that several domains can be
+        # evolved in one process, or concurrently in separate threads
+        #   flux_call -- counts calls, flags fluxes already computed
+        #   flux_base_call -- call at the start of the timestepping method
+        #   flux_last_timestep_fluxcalls -- timestep_fluxcalls of the last call
+        #   flux_cyclic_number_of_steps -- steps in the flux update cycle
+        #   flux_local_timestep -- timestep from the last full flux update
+        self.flux_call=num.zeros(1).astype(int)
+        self.flux_base_call=num.ones(1).astype(int)
+        self.flux_last_timestep_fluxcalls=num.ones(1).astype(int)
+        self.flux_cyclic_number_of_steps=num.zeros(1).astype(int)-1
+        self.flux_local_timestep=num.zeros(1)
+
+        # Lists of the cells the DE kernels loop over when active cell
+        # compaction is on (see set_active_cell_compaction)
+        #   active_cells -- cells whose fluxes are computed
+        #   extrapolation_cells -- cells protected and extrapolated
+        #   active_cell_distance -- neighbours from the nearest source, or -1
+        #   active_cell_changed -- flux call the centroid values last changed
+        #   number_of_active_cells -- list lengths and flux call built for
+        #   active_cell_state -- centroid stage, xmom, ymom, bed last seen
+        N = self.number_of_elements
+        self.active_cells=num.zeros(N).astype(int)
+        self.extrapolation_cells=num.zeros(N).astype(int)
+        self.active_cell_distance=num.zeros(N).astype(int)-1
+        self.active_cell_changed=num.zeros(N).astype(int)
+        self.number_of_active_cells=num.zeros(3).astype(int)
+        self.active_cell_state=num.zeros((N,4))+num.nan
+
+        # Place the pages of the arrays next to the OpenMP threads
+        from anuga.config import numa_first_touch
+        if numa_first_touch:
+            self.first_touch_arrays()
+
     def _set_config_defaults(self):
         """Set the default values in this routine. That way we can inherit class
         and just redefine the defaults for the new class
@@ -1325,6 +1408,393 @@ class Domain(Generic_Domain):
                 raise Exception('Local extrapolation and flux updating only supported for discontinuous flow algorithms')
 
 
+    def set_multiprocessor_mode(self, multiprocessor_mode=0):
+        """Set the mode used to run the C kernels of the DE algorithms
+        and the fused quantity kernels (update, backup and saxpy of the
+        conserved quantities)
+
+        multiprocessor_mode == 0  serial kernels
+                            == 1  OpenMP threaded kernels, which give
+                                  the same results as the serial kernels
+
+        The number of threads can be set via OMP_NUM_THREADS or
+        set_omp_num_threads.
+        """
+
+        if multiprocessor_mode in [0, 1]:
+            self.multiprocessor_mode = multiprocessor_mode
+        else:
+            raise Exception('multiprocessor_mode must be 0 (serial) or 1 (openmp)')
+
+    def get_multiprocessor_mode(self):
+        """Get the mode used to run the C kernels of the DE algorithms
+
+        See set_multiprocessor_mode for possible choices.
+        """
+
+        return self.multiprocessor_mode
+
+    def set_edge_based_fluxes(self, flag=True):
+        """Compute the DE fluxes by streaming over a precomputed list of
+        unique edges (built on first use) rather than over the edges of
+        each triangle. Gives the same results as the triangle based
+        computation.
+        """
+
+        self.edge_based_fluxes = flag
+
+    def get_edge_based_fluxes(self):
+        """Get flag for edge based flux computation
+        """
+
+        return self.edge_based_fluxes
+
+    def set_simd_fluxes(self, flag=True):
+        """Compute the DE fluxes for blocks of edges at a time with a
+        vectorised flux function, using the edge based flux computation.
+        Results agree with the scalar flux function to rounding error.
+        """
+
+        self.simd_fluxes = flag
+
+    def get_simd_fluxes(self):
+        """Get flag for vectorised flux computation
+        """
+
+        return self.simd_fluxes
+
+    def set_omp_num_threads(self, num_threads):
+        """Set the number of threads used when multiprocessor_mode == 1
+        """
+
+        from .swDE1_domain_ext import set_omp_num_threads
+
+        set_omp_num_threads(int(num_threads))
+
+    def set_native_evolve(self, flag=True):
+        """Take the timesteps between yield points of the DE algorithms
+        in a single call to C (see evolve_to_yieldstep). Python is then
+        only called for boundaries, forcing terms other than Manning
+        friction, update_timestep and fractional step operators. Gives
+        the same results as the python timestepping loop.
+        """
+
+        self.native_evolve = flag
+
+    def get_native_evolve(self):
+        """Get flag for native DE timestepping
+        """
+
+        return self.native_evolve
+
+    def set_ghost_exchange_overlap(self, flag=True):
+        """With native evolve, overlap the ghost exchange of parallel
+        domains with the DE protection, extrapolation and fluxes of the
+        cells which do not depend on the ghost cells (see
+        build_local_overlap_cells in anuga.parallel.distribute_mesh).
+        The exchange is posted, the interior cells computed, and the
+        exchange completed before the rest. Gives the same results. Not
+        used with active cell compaction, max_flux_update_frequency other
+        than 1 or edge based fluxes.
+        """
+
+        if flag and self.overlap_cells is None:
+            from anuga.parallel.distribute_mesh import build_local_overlap_cells
+            self.overlap_cells = build_local_overlap_cells(self.neighbours,
+                self.number_of_boundaries, self.tri_full_flag)
+
+        self.ghost_exchange_overlap = flag
+
+    def get_ghost_exchange_overlap(self):
+        """Get flag for overlapping the ghost exchange with computation
+        """
+
+        return self.ghost_exchange_overlap
+
+    def use_native_evolve(self):
+        """Native timestepping is used if requested and supported by the
+        flow algorithm
+        """
+
+        return self.native_evolve and \
+            self.compute_fluxes_method == 'DE' and \
+            self.get_using_discontinuous_elevation() and \
+            self.timestepping_method in ['euler', 'rk2', 'rk3']
+
+    def evolve_to_yieldstep(self, yieldstep, finaltime):
+        """Take DE timesteps until the next yield time or finaltime
+        """
+
+        from .swDE1_domain_ext import evolve_to_yieldstep
+
+        evolve_to_yieldstep(self, yieldstep, finaltime)
+
+    def set_native_boundaries(self, flag=True):
+        """Evaluate Reflective, Dirichlet, Transmissive, Time and Flather
+        boundaries of the DE algorithms in C, from index arrays built on
+        first use. Other boundary types are still evaluated by their
+        evaluate_segment method. Gives the same boundary values.
+        """
+
+        self.native_boundaries = flag
+
+    def get_native_boundaries(self):
+        """Get flag for native boundary evaluation
+        """
+
+        return self.native_boundaries
+
+    def set_active_cell_compaction(self, flag=True):
+        """Restrict the DE protection, extrapolation and (cell based)
+        flux computation to the cells within two neighbours of water,
+        of a boundary or of a recent change. Gives the same results,
+        but does nothing if max_flux_update_frequency is not 1.
+        """
+
+        self.active_cell_compaction = flag
+
+    def get_active_cell_compaction(self):
+        """Get flag for active cell compaction
+        """
+
+        return self.active_cell_compaction
+
+    def set_vertex_output_precision(self, precision='double'):
+        """Precision of the vertex values of stage, xmomentum, ymomentum
+        and height, 'double' or 'single'.
+
+        This is an output option: the vertex values are only written by
+        the DE kernels for use from python (and sww files), never read
+        back by them. With 'single' (DE algorithms only) these four
+        vertex_values arrays are float32, which halves their memory. The
+        kernels still compute in double precision from, and read and write,
+        the double precision centroid and edge values, so the evolution
+        and the kernel memory traffic are unchanged.
+
+        The vertex values are rounded to single precision, i.e. to a
+        relative error of about 6e-8. Initial conditions set at the
+        vertices are rounded as well, so set the precision after them to
+        reproduce the double precision evolution exactly.
+        """
+
+        if precision not in ['double', 'single']:
+            msg = "Vertex output precision must be 'double' or 'single', got %s" \
+                  % str(precision)
+            raise ValueError(msg)
+
+        if precision == 'single' and self.get_compute_fluxes_method() != 'DE':
+            msg = 'Single precision vertex output is only supported by the DE '
+            msg += 'flow algorithms'
+            raise Exception(msg)
+
+        if precision == self.vertex_output_precision:
+            return
+
+        dtype = num.float32 if precision == 'single' else float
+        for name in ['stage', 'xmomentum', 'ymomentum', 'height']:
+            Q = self.quantities[name]
+            Q.vertex_values = Q.vertex_values.astype(dtype)
+
+        self.vertex_output_precision = precision
+        self.invalidate_domain_struct()
+
+        # Move the converted arrays into the block
+        if self.quantity_arena is not None:
+            self.set_quantity_arena(self.quantity_arena.policy)
+
+    def get_vertex_output_precision(self):
+        """Get precision of the vertex values of the evolved quantities
+        """
+
+        return self.vertex_output_precision
+
+    def set_quantity_arena(self, policy='quantity'):
+        """Pack the arrays of all quantities into one aligned block of
+        memory, see Generic_Domain.set_quantity_arena
+        """
+
+        Generic_Domain.set_quantity_arena(self, policy)
+        self.invalidate_domain_struct()
+
+    def first_touch_arrays(self):
+        """Reallocate the quantity, mesh and DE work arrays from the
+        OpenMP threads, see Generic_Domain.first_touch_arrays
+        """
+
+        Generic_Domain.first_touch_arrays(self)
+        self.invalidate_domain_struct()
+
+    def set_lazy_vertex_values(self, flag=True):
+        """Leave the vertex values of stage, xmomentum, ymomentum and height
+        out of the DE extrapolation, which only needs the edge values. They
+        are computed from the edge values when next accessed (for instance
+        by get_values, or when storing to the sww file), with the same
+        result as computing them every timestep.
+        """
+
+        if not flag:
+            # Bring the vertex values up to date before the kernels
+            # compute them again
+            for name in ['stage', 'xmomentum', 'ymomentum', 'height']:
+                if self.quantities[name].vertex_values_stale:
+                    self.compute_vertex_values()
+                    break
+
+        self.lazy_vertex_values = flag
+
+    def get_lazy_vertex_values(self):
+        """Get flag for computing vertex values only when accessed
+        """
+
+        return self.lazy_vertex_values
+
+    def compute_vertex_values(self):
+        """Compute the vertex values of stage, xmomentum, ymomentum and
+        height from their edge values (see set_lazy_vertex_values)
+        """
+
+        from .swDE1_domain_ext import compute_vertex_values
+
+        # Clear first, as building the C domain structure reads the
+        # vertex values
+        for name in ['stage', 'xmomentum', 'ymomentum', 'height']:
+            self.quantities[name].vertex_values_stale = False
+
+        compute_vertex_values(self)
+
+    def get_number_of_active_cells(self):
+        """Number of cells in the last flux computation with active
+        cell compaction
+        """
+
+        return int(self.number_of_active_cells[0])
+
+    def build_boundary_structure(self):
+        """Sort the boundary edges into those evaluated in C, with their
+        boundary type and slot in the array of boundary values, and the
+        tags left to python.
+        """
+
+        from anuga.abstract_2d_finite_volumes.generic_boundary_conditions \
+            import Dirichlet_boundary, Transmissive_boundary, Time_boundary
+        from .boundaries import Reflective_boundary, \
+            Flather_external_stage_zero_velocity_boundary as Flather_boundary
+
+        # Boundary types in swDE1_domain.c
+        reflective, dirichlet, transmissive, flather = 0, 1, 2, 3
+
+        evolved = self.evolved_quantities == ['stage', 'xmomentum', 'ymomentum']
+
+        ids = []
+        types = []
+        slots = []
+        valued_boundaries = []
+        python_tags = []
+
+        for tag in self.tag_boundary_cells:
+            B = self.boundary_map[tag]
+
+            if B is None:
+                continue
+
+            kind = type(B)
+            slot = -1
+            if kind is Reflective_boundary:
+                boundary_type = reflective
+            elif kind is Dirichlet_boundary and evolved and len(B.dirichlet_values) == 3:
+                boundary_type = dirichlet
+            elif kind is Time_boundary and evolved and B.default_boundary is None:
+                boundary_type = dirichlet
+            elif kind is Transmissive_boundary and evolved:
+                boundary_type = transmissive
+            elif kind is Flather_boundary:
+                boundary_type = flather
+            else:
+                python_tags.append(tag)
+                continue
+
+            if boundary_type in [dirichlet, flather]:
+                slot = len(valued_boundaries)
+                valued_boundaries.append(B)
+
+            segment_edges = self.tag_boundary_cells[tag]
+            ids.extend(segment_edges)
+            types.extend([boundary_type]*len(segment_edges))
+            slots.extend([slot]*len(segment_edges))
+
+        ids = num.array(ids, int)
+        edges = 3*self.boundary_cells[ids] + self.boundary_edges[ids]
+
+        return {'boundaries' : [self.boundary_map[tag] for tag in self.tag_boundary_cells],
+                'ids' : ids,
+                'edges' : num.array(edges, int),
+                'types' : num.array(types, int),
+                'slots' : num.array(slots, int),
+                'values' : num.zeros(3*max(len(valued_boundaries), 1)),
+                'valued_boundaries' : valued_boundaries,
+                'python_tags' : python_tags}
+
+    def update_boundary(self):
+        """Update boundary values of all boundary objects, in C for the
+        common boundary types if native boundaries are set.
+        """
+
+        if not (self.native_boundaries and self.compute_fluxes_method == 'DE'):
+            Generic_Domain.update_boundary(self)
+            return
+
+        from anuga.abstract_2d_finite_volumes.generic_boundary_conditions \
+            import Dirichlet_boundary, Time_boundary
+        from anuga.config import g as gravity
+        from .swDE1_domain_ext import evaluate_boundaries
+
+        # Rebuild if any boundary object has been replaced
+        S = self.boundary_structure
+        boundaries = [self.boundary_map[tag] for tag in self.tag_boundary_cells]
+        if S is None or len(S['boundaries']) != len(boundaries) or \
+           any(B is not C for B, C in zip(S['boundaries'], boundaries)):
+            S = self.boundary_structure = self.build_boundary_structure()
+
+        # Time dependent values, once per call
+        values = S['values']
+        for slot, B in enumerate(S['valued_boundaries']):
+            if type(B) is Dirichlet_boundary:
+                values[3*slot:3*slot+3] = B.dirichlet_values
+            elif type(B) is Time_boundary:
+                values[3*slot:3*slot+3] = B.get_boundary_values()
+            else:
+                value = B.function(B.domain.get_time())
+                try:
+                    values[3*slot] = float(value)
+                except:
+                    values[3*slot] = float(value[0])
+
+        evaluate_boundaries(self, S['ids'], S['edges'], S['types'], S['slots'],
+                            values, gravity)
+
+        for tag in S['python_tags']:
+            self.boundary_map[tag].evaluate_segment(self, self.tag_boundary_cells[tag])
+
+    def __getstate__(self):
+        """Pickle (e.g. for checkpointing) without the C domain structure,
+        which holds raw pointers. It is rebuilt on the next kernel call.
+        """
+
+        state = self.__dict__.copy()
+        state['c_domain_struct'] = None
+
+        return state
+
+    def invalidate_domain_struct(self):
+        """Discard the C domain structure cached by the DE kernels.
+
+        The structure holds pointers to the domain, quantity and riverwall
+        arrays and is rebuilt on the next kernel call. Must be called
+        after any of those arrays is replaced rather than updated in place.
+        """
+
+        self.c_domain_struct = None
+
     def get_compute_fluxes_method(self):
         """Get method for computing fluxes.
 
@@ -1450,6 +1920,11 @@ class Domain(Generic_Domain):
         if self.flow_algorithm == 'DE1_7':
             self._set_DE1_7_defaults()
 
+        # Only the DE kernels write single precision vertex values
+        if getattr(self, 'vertex_output_precision', 'double') == 'single' and \
+               self.get_compute_fluxes_method() != 'DE':
+            self.set_vertex_output_precision('double')
+
 
     def get_flow_algorithm(self):
         """
@@ -2091,8 +2566,15 @@ class Domain(Generic_Domain):
             # Flux calculation and gravity incorporated in same
             # procedure
 
-            from .swDE1_domain_ext import compute_fluxes_ext_central \
-                                      as compute_fluxes_ext
+            if self.edge_based_fluxes or self.simd_fluxes:
+                from .swDE1_domain_ext import compute_fluxes_ext_central_edges \
+                                          as compute_fluxes_ext
+            elif self.multiprocessor_mode == 1:
+                from .swDE1_domain_ext import compute_fluxes_ext_central_openmp \
+                                          as compute_fluxes_ext
+            else:
+                from .swDE1_domain_ext import compute_fluxes_ext_central \
+                                          as compute_fluxes_ext
 
             timestep = self.evolve_max_timestep
 
@@ -2171,9 +2653,13 @@ class Domain(Generic_Domain):
         elif self.compute_fluxes_method=='DE':
 
             # Do protection step
-            self.protect_against_infinitesimal_and_negative_heights()
+            self.kernel_profiler.time('protect',
+                self.protect_against_infinitesimal_and_negative_heights)
             # Do extrapolation step
-            from .swDE1_domain_ext import extrapolate_second_order_edge_sw as extrapol2
+            if self.multiprocessor_mode == 1:
+                from .swDE1_domain_ext import extrapolate_second_order_edge_sw_openmp as extrapol2
+            else:
+                from .swDE1_domain_ext import extrapolate_second_order_edge_sw as extrapol2
             extrapol2(self)
 
         else:
@@ -2401,9 +2887,8 @@ class Domain(Generic_Domain):
         Xmom = self.quantities['xmomentum']
         Ymom = self.quantities['ymomentum']
 
-        Stage.update(timestep)
-        Xmom.update(timestep)
-        Ymom.update(timestep)
+        from anuga.abstract_2d_finite_volumes.quantity_ext import update_quantities
+        update_quantities(self, timestep, ['stage', 'xmomentum', 'ymomentum'])
 
         if self.get_using_discontinuous_elevation():
 
@@ -2708,7 +3193,7 @@ class Domain(Generic_Domain):
            self.writer has been initialised
         """
 
-        self.writer.store_timestep()
+        self.kernel_profiler.time('sww_write', self.writer.store_timestep)
 
 
     def sww_merge(self,  *args, **kwargs):
@@ -3016,6 +3501,40 @@ class Domain(Generic_Domain):
 
         compute_flux_update_frequency_ext(self, self.timestep)
 
+    def get_flux_update_statistics(self):
+        """
+            Statistics of local flux updating (see
+            set_local_extrapolation_and_flux_updating)
+
+            Returns a dictionary with
+              histogram -- number of edges (counted from both sides) with
+                           each flux_update_frequency 1,2,4,..
+              fraction_skipped -- fraction of edge fluxes not computed,
+                           over the timesteps since the last
+                           reset_flux_update_statistics
+        """
+
+        frequencies = 2**num.arange(int(num.log2(self.max_flux_update_frequency))+1)
+        counts = num.bincount(self.flux_update_frequency,
+                              minlength=self.max_flux_update_frequency+1)
+
+        histogram = dict((int(f), int(counts[f])) for f in frequencies)
+
+        computed, total = self.flux_update_statistics
+        if total > 0:
+            fraction_skipped = 1.0 - float(computed)/total
+        else:
+            fraction_skipped = 0.0
+
+        return {'histogram': histogram, 'fraction_skipped': fraction_skipped}
+
+    def reset_flux_update_statistics(self):
+        """
+            Restart the count of skipped edge fluxes
+        """
+
+        self.flux_update_statistics[:] = 0
+
     def report_water_volume_statistics(self, verbose=True, returnStats=False):
         """
         Compute the volume, boundary flux integral, fractional step volume integral, and their difference
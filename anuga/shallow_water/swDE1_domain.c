@@ -17,11 +17,30 @@
 
 #include "math.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h> 
 #include "sw_domain.h"
 
+#if defined(_OPENMP)
+   #include "omp.h"
+#endif
+
 const double pi = 3.14159265358979;
 
+// Runtime instruction set dispatch for the batched flux function:
+// gcc builds a clone for each target and picks one when the module loads.
+// The arguments are never NaN, so fmax/fmin can be inlined, which (with
+// -fno-math-errno for sqrt) lets the flux loop vectorise
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+   #define FLUX_TARGET_CLONES __attribute__((optimize("no-trapping-math","finite-math-only"))) \
+                              __attribute__((target_clones("avx512f","avx2","default")))
+#else
+   #define FLUX_TARGET_CLONES
+#endif
+
+// Number of edges passed to _flux_function_central_batch at a time
+#define FLUX_BATCH_SIZE 8
+
 // Trick to compute n modulo d (n%d in python) when d is a power of 2
 unsigned int Mod_of_power_2(unsigned int n, unsigned int d)
 {
@@ -311,8 +330,9 @@ int _flux_function_central(double *q_left, double *q_right,
   double s_min, s_max, soundspeed_left, soundspeed_right;
   double denom, inverse_denominator;
   double tmp, local_fr, v_right, v_left;
-  // Workspace (allocate once, use many)
-  static double q_left_rotated[3], q_right_rotated[3], flux_right[3], flux_left[3];
+  // Workspace (on the stack, as this function is called concurrently
+  // from the threaded flux computation)
+  double q_left_rotated[3], q_right_rotated[3], flux_right[3], flux_left[3];
 
   if(h_left==0. && h_right==0.){
     // Quick exit
@@ -477,8 +497,129 @@ int _flux_function_central(double *q_left, double *q_right,
   return 0;
 }
 
+// Batched version of _flux_function_central, which computes the fluxes
+// through nb edges at once. The arrays hold one lane per edge, with the
+// three components of q_left, q_right and edgeflux stored as
+// q_left[0*nb + j], q_left[1*nb + j], q_left[2*nb + j] for edge j.
+//
+// The loop over edges is written without branches (the dry edge, low
+// froude and small wavespeed cases are selected per lane) so that it is
+// vectorised, and the function is compiled for several instruction sets
+// with the best chosen at load time (FLUX_TARGET_CLONES). Results agree
+// with _flux_function_central to rounding, as the vector instruction
+// sets may contract multiply-adds.
+FLUX_TARGET_CLONES
+int _flux_function_central_batch(long nb,
+                                 double *q_left, double *q_right,
+                                 double *h_left, double *h_right,
+                                 double *hle, double *hre,
+                                 double *n1, double *n2,
+                                 double epsilon,
+                                 double *ze,
+                                 double g,
+                                 double *edgeflux, double *max_speed,
+                                 double *pressure_flux,
+                                 long low_froude)
+{
+  long j;
+  // Weights selecting the low_froude option, uniform over the lanes
+  double froude_1 = (low_froude == 1) ? 1.0 : 0.0;
+  double froude_2 = (low_froude == 2) ? 1.0 : 0.0;
+  double froude_0 = 1.0 - froude_1 - froude_2;
+
+  #pragma omp simd
+  for (j = 0; j < nb; j++) {
+    double wl, wr, uhl, vhl, uhr, vhr;
+    double u_left, v_left, uh_left, vh_left;
+    double u_right, v_right, uh_right, vh_right;
+    double inv_hle, inv_hre, soundspeed_left, soundspeed_right;
+    double s_max, s_min, denom, inverse_denominator;
+    double local_fr, local_fr_1, local_fr_2, fr2;
+    double f0, f1, f2, smsm, dry, small, zero, pf, pf_small;
+    double hl = h_left[j], hr = h_right[j];
+    double nx = n1[j], ny = n2[j];
+
+    // Align x- and y-momentum with x-axis
+    wl = q_left[j];
+    wr = q_right[j];
+    uhl =  nx*q_left[nb + j] + ny*q_left[2*nb + j];
+    vhl = -ny*q_left[nb + j] + nx*q_left[2*nb + j];
+    uhr =  nx*q_right[nb + j] + ny*q_right[2*nb + j];
+    vhr = -ny*q_right[nb + j] + nx*q_right[2*nb + j];
+
+    // Compute speeds in x-direction
+    inv_hle = 1.0/(hle[j] > 0.0 ? hle[j] : 1.0);
+    u_left  = hle[j] > 0.0 ? uhl*inv_hle : 0.0;
+    uh_left = hle[j] > 0.0 ? hl*u_left : 0.0;
+    v_left  = hle[j] > 0.0 ? vhl*inv_hle : 0.0;
+    vh_left = hle[j] > 0.0 ? hl*inv_hle*vhl : 0.0;
+
+    inv_hre = 1.0/(hre[j] > 0.0 ? hre[j] : 1.0);
+    u_right  = hre[j] > 0.0 ? uhr*inv_hre : 0.0;
+    uh_right = hre[j] > 0.0 ? hr*u_right : 0.0;
+    v_right  = hre[j] > 0.0 ? vhr*inv_hre : 0.0;
+    vh_right = hre[j] > 0.0 ? hr*inv_hre*vhr : 0.0;
+
+    // Maximal and minimal wave speeds
+    soundspeed_left  = sqrt(g*hl);
+    soundspeed_right = sqrt(g*hr);
+
+    // Something that scales like the Froude number
+    fr2 = (u_right*u_right + u_left*u_left + v_right*v_right + v_left*v_left)/
+          (soundspeed_left*soundspeed_left + soundspeed_right*soundspeed_right + 1.0e-10);
+    local_fr_1 = sqrt(fmax(0.001, fmin(1.0, fr2)));
+    local_fr_2 = sqrt(fmin(1.0, 0.01 + fmax(sqrt(fr2)-0.01, 0.0)));
+    local_fr = froude_1*local_fr_1 + froude_2*local_fr_2 + froude_0;
+
+    s_max = fmax(fmax(u_left + soundspeed_left, u_right + soundspeed_right), 0.0);
+    s_min = fmin(fmin(u_left - soundspeed_left, u_right - soundspeed_right), 0.0);
+
+    // Flux computation
+    denom = s_max - s_min;
+    inverse_denominator = 1.0/fmax(denom, 1.0e-100);
+    smsm = s_max*s_min;
+
+    f0 = (s_max*(u_left*hl) - s_min*(u_right*hr)
+          + smsm*(fmax(wr, ze[j]) - fmax(wl, ze[j])))*inverse_denominator;
+    f1 = (s_max*(u_left*uh_left) - s_min*(u_right*uh_right)
+          + local_fr*smsm*(uh_right - uh_left))*inverse_denominator;
+    f2 = (s_max*(u_left*vh_left) - s_min*(u_right*vh_right)
+          + local_fr*smsm*(vh_right - vh_left))*inverse_denominator;
+
+    // Masks for both sides dry (h_left, h_right >= 0), and both wave
+    // speeds very small, in which cases the flux is zero
+    dry = (hl + hr == 0.0) ? 1.0 : 0.0;
+    small = (denom < epsilon) ? 1.0 : 0.0;
+    zero = fmax(dry, small);
+
+    // Rotate back
+    edgeflux[j]        = (zero > 0.0) ? 0.0 : f0;
+    edgeflux[nb + j]   = (zero > 0.0) ? 0.0 : nx*f1 - ny*f2;
+    edgeflux[2*nb + j] = (zero > 0.0) ? 0.0 : ny*f1 + nx*f2;
+
+    max_speed[j] = (zero > 0.0) ? 0.0 : fmax(s_max, -s_min);
+
+    pf_small = 0.5*g*0.5*(hl*hl + hr*hr);
+    pf = 0.5*g*(s_max*hl*hl - s_min*hr*hr)*inverse_denominator;
+    pf = (small > 0.0) ? pf_small : pf;
+    pressure_flux[j] = (dry > 0.0) ? 0.0 : pf;
+  }
+
+  return 0;
+}
+
 ////////////////////////////////////////////////////////////////
 
+// Largest power of 2 not greater than n (n >= 1)
+static inline long _round_down_to_power_of_2(long n){
+#if defined(__GNUC__)
+    return 1L << (8*sizeof(long) - 1 - __builtin_clzl((unsigned long) n));
+#else
+    while (n & (n - 1)) n &= n - 1;
+    return n;
+#endif
+}
+
 int _compute_flux_update_frequency(struct domain *D, double timestep){
     // Compute the 'flux_update_frequency' for each edge.
     //
@@ -490,12 +631,17 @@ int _compute_flux_update_frequency(struct domain *D, double timestep){
     // For example, an edge with flux_update_frequency = 4 would
     // only have the flux updated every 4 timesteps
     //
+    // Both sides of an edge always have the same flux_update_frequency, and
+    // the fluxes due for update were computed on the last flux call, so
+    // the new frequency of an edge can be found from either side. This is
+    // done in two passes over the triangles, each only writing values of
+    // its own triangle, so they are threaded when multiprocessor_mode == 1
+    // and give the same results for any number of threads.
     //
     // Local variables
-    int k, i, k3, ki, m, n, nm, ii, ii2;
-    long fuf;
-    double notSoFast=1.0;
-    static int cyclic_number_of_steps=-1;
+    long k, number_of_cells;
+    long number_of_computed_edges = 0;
+    long cyclic_number_of_steps;
 
     // QUICK EXIT
     if(D->max_flux_update_frequency==1){
@@ -503,131 +649,105 @@ int _compute_flux_update_frequency(struct domain *D, double timestep){
     }
 
     // Count the steps
-    cyclic_number_of_steps++;
+    cyclic_number_of_steps = D->flux_cyclic_number_of_steps[0] + 1;
     if(cyclic_number_of_steps==D->max_flux_update_frequency){
         // The flux was just updated in every cell
         cyclic_number_of_steps=0;
     }
+    D->flux_cyclic_number_of_steps[0] = cyclic_number_of_steps;
 
 
-    // PART 1: ONLY OCCURS FOLLOWING FLUX UPDATE
-
+    // PART 1: Recompute the frequency of the edges whose flux (and
+    // edge_timestep) was just updated, and keep the smallest frequency
+    // of the edges of each triangle.
+    // Experiences suggests this is numerically important
+    #pragma omp parallel for schedule(static) if(D->multiprocessor_mode == 1)
     for ( k = 0; k < D->number_of_elements; k++){
+        long i, ki, n, nm, fuf, fuf_n, fuf_min;
+        double notSoFast=1.0;
+
+        fuf_min = D->max_flux_update_frequency;
         for ( i = 0; i < 3; i++){
             ki = k*3 + i;
-            if((Mod_of_power_2(cyclic_number_of_steps, D->flux_update_frequency[ki])==0)){
-                // The flux was just updated, along with the edge_timestep
-                // So we better recompute the flux_update_frequency
-                n=D->neighbours[ki];
-                if(n>=0){
-                    m = D->neighbour_edges[ki];
-                    nm = n * 3 + m; // Linear index (triangle n, edge m)
-                }
-
-                // Check if we have already done this edge
-                // (Multiply already_computed_flux by -1 on the first update,
-                // and again on the 2nd)
-                if(D->already_computed_flux[ki] > 0 ){
-                    // We have not fixed this flux value yet
-                    D->already_computed_flux[ki] *=-1;
-                    if(n>=0){
-                        D->already_computed_flux[nm] *=-1;
-                    }
-                }else{
-                    // We have fixed this flux value already
-                    D->already_computed_flux[ki] *=-1;
-                    if(n>=0){
-                        D->already_computed_flux[nm] *=-1;
-                    }
-                    continue;
-                }
+            fuf = D->flux_update_frequency[ki];
 
+            if((Mod_of_power_2(cyclic_number_of_steps, fuf)==0)){
                 // Basically int( edge_ki_timestep/timestep ) with upper limit + tweaks
                 // notSoFast is ideally = 1.0, but in practice values < 1.0 can enhance stability
                 // NOTE: edge_timestep[ki]/timestep can be very large [so int overflows].
                 //       Do not pull the (int) inside the min term
                 fuf = (int)fmin((D->edge_timestep[ki]/timestep)*notSoFast,D->max_flux_update_frequency*1.);
                 // Account for neighbour
+                n=D->neighbours[ki];
                 if(n>=0){
-                    fuf = fmin( (int)fmin(D->edge_timestep[nm]/timestep*notSoFast, D->max_flux_update_frequency*1.), fuf);
+                    nm = n * 3 + D->neighbour_edges[ki]; // Linear index (triangle n, edge m)
+                    fuf_n = (int)fmin(D->edge_timestep[nm]/timestep*notSoFast, D->max_flux_update_frequency*1.);
+                    if(fuf_n < fuf) fuf = fuf_n;
                 }
 
                 // Deal with notSoFast<1.0
                 if(fuf<1){
                     fuf=1;
                 }
-                // Deal with large fuf
-                if(fuf> D->max_flux_update_frequency){
-                    fuf = D->max_flux_update_frequency;
-                }
-                //// Deal with intermediate cases
-                ii=2;
-                while(ii< D->max_flux_update_frequency){
-                    // Set it to 1,2,4, 8, ...
-                    ii2=2*ii;
-                    if((fuf>ii) && (fuf<ii2)){
-                        fuf = ii;
-                        continue;
-                    }
-                    ii=ii2;
-                }
-
-                // Set the values
-                D->flux_update_frequency[ki]=fuf;
-                if(n>=0){
-                    D->flux_update_frequency[nm]= fuf;
-                }
-
+                // Set it to 1,2,4, 8, ... (fuf <= max_flux_update_frequency)
+                fuf = _round_down_to_power_of_2(fuf);
             }
+
+            if(fuf < fuf_min) fuf_min = fuf;
         }
+
+        D->triangle_flux_update_frequency[k] = fuf_min;
     }
 
     //// PART 2 -- occcurs every timestep
 
-    // At this point, both edges have the same flux_update_frequency.
-    // Next, ensure that flux_update_frequency varies within a constant over each triangle
-    // Experiences suggests this is numerically important
-    // (But, it can result in the same edge having different flux_update_freq)
-    for( k=0; k< D->number_of_elements; k++){
-        k3=3*k;
-        ii = 1*fmin(D->flux_update_frequency[k3],
-                 fmin(D->flux_update_frequency[k3+1],
-                     D->flux_update_frequency[k3+2]));
-
-        D->flux_update_frequency[k3]=fmin(ii, D->flux_update_frequency[k3]);
-        D->flux_update_frequency[k3+1]=fmin(ii, D->flux_update_frequency[k3+1]);
-        D->flux_update_frequency[k3+2]=fmin(ii,D->flux_update_frequency[k3+2]);
-
-    }
-
-    // Now enforce the same flux_update_frequency on each edge
-    // (Could have been broken above when we limited the variation on each triangle)
-    // This seems to have nice behaviour. Notice how an edge
+    // Enforce the same flux_update_frequency on each edge, the smallest of
+    // the two triangles sharing it. This seems to have nice behaviour. Notice how an edge
     // with a large flux_update_frequency, near an edge with a small flux_update_frequency,
     // will have its flux_update_frequency updated after a few timesteps (i.e. before max_flux_update_frequency timesteps)
     // OTOH, could this cause oscillations in flux_update_frequency?
+    #pragma omp parallel for schedule(static) reduction(+:number_of_computed_edges) if(D->multiprocessor_mode == 1)
     for( k = 0; k < D->number_of_elements; k++){
+        long i, ki, n, fuf;
+
         D->update_extrapolation[k]=0;
         for( i = 0; i< 3; i++){
             ki=3*k+i;
+            fuf = D->triangle_flux_update_frequency[k];
             // Account for neighbour
             n=D->neighbours[ki];
-            if(n>=0){
-                m = D->neighbour_edges[ki];
-                nm = n * 3 + m; // Linear index (triangle n, edge m)
-                D->flux_update_frequency[ki]=fmin(D->flux_update_frequency[ki], D->flux_update_frequency[nm]);
+            if(n>=0 && D->triangle_flux_update_frequency[n] < fuf){
+                fuf = D->triangle_flux_update_frequency[n];
             }
+            D->flux_update_frequency[ki]=fuf;
+
             // Do we need to update the extrapolation?
             // (We do if the next flux computation will actually compute a flux!)
-            if(Mod_of_power_2((cyclic_number_of_steps+1),D->flux_update_frequency[ki])==0){
+            if(Mod_of_power_2((cyclic_number_of_steps+1),fuf)==0){
                 D->update_next_flux[ki]=1;
                 D->update_extrapolation[k]=1;
+                number_of_computed_edges++;
             }else{
                 D->update_next_flux[ki]=0;
             }
         }
     }
 
+    // List the triangles with a flux due, so the next flux computation
+    // and extrapolation only visit those
+    number_of_cells = 0;
+    for( k = 0; k < D->number_of_elements; k++){
+        if(D->update_extrapolation[k]==1){
+            D->flux_update_cells[number_of_cells++] = k;
+        }
+    }
+    D->number_of_flux_update_cells[0] = number_of_cells;
+
+    // Statistics, the number of edges (counted from both sides) due for
+    // update on the next flux computation, and the number of edges
+    D->flux_update_statistics[0] += number_of_computed_edges;
+    D->flux_update_statistics[1] += 3*D->number_of_elements;
+
     // Check whether the timestep can be increased in the next compute_fluxes call
     if(cyclic_number_of_steps+1==D->max_flux_update_frequency){
         // All fluxes will be updated on the next timestep
@@ -734,6 +854,161 @@ double adjust_edgeflux_with_weir(double *edgeflux,
     return 0;
 }
 
+// Active cell compaction
+//
+// Dry cells away from any water are left out of the DE kernels. A cell
+// is a source if it holds water or momentum (stage differs from bed, or
+// nonzero momentum), has a boundary edge, or had its centroid values
+// changed (by the kernels or from python) within the last
+// timestep_fluxcalls flux computations. Changes are found by comparing
+// with the centroid values copied into active_cell_state on the last
+// call.
+//
+// The extrapolation of a cell only depends on the centroid values of the
+// cell and its neighbours, and the fluxes of a cell only on those within
+// two neighbours, so elsewhere the stored edge values and fluxes (which
+// are zero) are already those the full loops would compute. active_cells
+// lists the cells within two neighbours of a source and
+// extrapolation_cells those within one, both in increasing order so
+// fluxes are computed from the same side as the full loop.
+// number_of_active_cells holds the lengths of the two lists and the flux
+// call they were built for.
+
+static int _compare_cell_ids(const void *a, const void *b){
+    long x = *(const long*) a;
+    long y = *(const long*) b;
+    return (x > y) - (x < y);
+}
+
+int _update_active_cells(struct domain *D){
+
+    long k, n, i, j, d, start, end, count, call;
+    long N = D->number_of_elements;
+    double *s;
+
+    // Id of the next flux computation
+    call = D->flux_call[0] + 1;
+
+    // Forget the cells found on the last call
+    for (j = 0; j < D->number_of_active_cells[0]; j++){
+        D->active_cell_distance[D->active_cells[j]] = -1;
+    }
+
+    // Sources
+    count = 0;
+    for (k = 0; k < N; k++){
+        s = D->active_cell_state + 4*k;
+        if ((D->stage_centroid_values[k] != s[0]) | (D->xmom_centroid_values[k] != s[1]) |
+            (D->ymom_centroid_values[k] != s[2]) | (D->bed_centroid_values[k] != s[3])){
+            s[0] = D->stage_centroid_values[k];
+            s[1] = D->xmom_centroid_values[k];
+            s[2] = D->ymom_centroid_values[k];
+            s[3] = D->bed_centroid_values[k];
+            D->active_cell_changed[k] = call;
+        }
+
+        if ((D->stage_centroid_values[k] != D->bed_centroid_values[k]) |
+            (D->xmom_centroid_values[k] != 0.0) | (D->ymom_centroid_values[k] != 0.0) |
+            (D->number_of_boundaries[k] > 0) |
+            (call - D->active_cell_changed[k] <= D->timestep_fluxcalls)){
+            D->active_cell_distance[k] = 0;
+            D->active_cells[count++] = k;
+        }
+    }
+
+    // Neighbours of sources, and their neighbours
+    start = 0;
+    for (d = 1; d <= 2; d++){
+        end = count;
+        for (j = start; j < end; j++){
+            k = D->active_cells[j];
+            for (i = 0; i < 3; i++){
+                n = D->neighbours[3*k + i];
+                if (n >= 0 && D->active_cell_distance[n] < 0){
+                    D->active_cell_distance[n] = d;
+                    D->active_cells[count++] = n;
+                }
+            }
+        }
+        start = end;
+    }
+
+    qsort(D->active_cells, count, sizeof(long), _compare_cell_ids);
+
+    D->number_of_active_cells[1] = 0;
+    for (j = 0; j < count; j++){
+        k = D->active_cells[j];
+        if (D->active_cell_distance[k] <= 1){
+            D->extrapolation_cells[D->number_of_active_cells[1]++] = k;
+        }
+    }
+    D->number_of_active_cells[0] = count;
+    D->number_of_active_cells[2] = call;
+
+    return 0;
+}
+
+// Store the vertex values of triangle k (k3 = 3*k) computed from its edge
+// values e0, e1, e2, in the single precision vertex values of the quantity
+// when they are used (see Domain.set_vertex_output_precision), otherwise in
+// the double precision ones.
+static inline void _store_vertex_values(double *vertex_values,
+                                        float *vertex_values_single,
+                                        long k3,
+                                        double e0, double e1, double e2){
+  if (vertex_values_single) {
+    vertex_values_single[k3]   = (float) (e1 + e2 - e0);
+    vertex_values_single[k3+1] = (float) (e0 + e2 - e1);
+    vertex_values_single[k3+2] = (float) (e0 + e1 - e2);
+  } else {
+    vertex_values[k3]   = e1 + e2 - e0;
+    vertex_values[k3+1] = e0 + e2 - e1;
+    vertex_values[k3+2] = e0 + e1 - e2;
+  }
+}
+
+// Active cell compaction relies on every flux being computed each
+// timestep
+static inline int _use_active_cells(struct domain *D){
+    return (D->active_cell_compaction == 1) && (D->max_flux_update_frequency == 1);
+}
+
+// The cells the flux computation loops over, or NULL for all cells
+static inline long* _get_active_cells(struct domain *D, long *number_of_cells){
+
+    *number_of_cells = D->number_of_elements;
+    if (!_use_active_cells(D)) return NULL;
+
+    if (D->number_of_active_cells[2] != D->flux_call[0] + 1) _update_active_cells(D);
+    *number_of_cells = D->number_of_active_cells[0];
+    return D->active_cells;
+}
+
+// The cells the protection and extrapolation loop over, or NULL for all
+// cells
+static inline long* _get_extrapolation_cells(struct domain *D, long *number_of_cells){
+
+    *number_of_cells = D->number_of_elements;
+    if (!_use_active_cells(D)) return NULL;
+
+    if (D->number_of_active_cells[2] != D->flux_call[0] + 1) _update_active_cells(D);
+    *number_of_cells = D->number_of_active_cells[1];
+    return D->extrapolation_cells;
+}
+
+// With local flux updating, the cells with a flux due on the next flux
+// computation (those with update_extrapolation == 1), listed in
+// increasing order by _compute_flux_update_frequency. Returns NULL for
+// all cells.
+static inline long* _get_flux_update_cells(struct domain *D, long *number_of_cells){
+
+    *number_of_cells = D->number_of_elements;
+    if (D->max_flux_update_frequency == 1 || D->number_of_flux_update_cells[0] < 0) return NULL;
+
+    *number_of_cells = D->number_of_flux_update_cells[0];
+    return D->flux_update_cells;
+}
+
 // Computational function for flux computation
 double _compute_fluxes_central(struct domain *D, double timestep){
 
@@ -749,21 +1024,32 @@ double _compute_fluxes_central(struct domain *D, double timestep){
     // Workspace (making them static actually made function slightly slower (Ole))
     double ql[3], qr[3], edgeflux[3]; // Work array for summing up fluxes
     double bedslope_work;
-    static double local_timestep;
-    long RiverWall_count, substep_count;
+    long rw = -1, substep_count;
     double hle, hre, zc, zc_n, Qfactor, s1, s2, h1, h2;
     double pressure_flux, hc, hc_n, tmp;
     double h_left_tmp, h_right_tmp;
-    static long call = 0; // Static local variable flagging already computed flux
-    static long timestep_fluxcalls=1;
-    static long base_call = 1;
     double speed_max_last, weir_height;
+    double local_timestep;
+    long call, j, number_of_cells, number_of_flux_cells;
+    long* cells;
+    long* flux_cells;
+
+    // Cells to loop over (all of them unless active cell compaction is
+    // on), and for the fluxes only those with a flux due
+    cells = _get_active_cells(D, &number_of_cells);
+    flux_cells = _get_flux_update_cells(D, &number_of_flux_cells);
+    if (cells) {
+        flux_cells = cells;
+        number_of_flux_cells = number_of_cells;
+    }
 
-    call++; // Flag 'id' of flux calculation for this timestep
+    // State between calls is kept in the domain, so kernels are reentrant
+    D->flux_call[0]++; // Flag 'id' of flux calculation for this timestep
+    call = D->flux_call[0];
 
-    if (D->timestep_fluxcalls != timestep_fluxcalls) {
-    	timestep_fluxcalls = D->timestep_fluxcalls;
-    	base_call = call;
+    if (D->timestep_fluxcalls != D->flux_last_timestep_fluxcalls[0]) {
+    	D->flux_last_timestep_fluxcalls[0] = D->timestep_fluxcalls;
+    	D->flux_base_call[0] = call;
     }
 
     // Set explicit_update to zero for all conserved_quantities.
@@ -772,24 +1058,29 @@ double _compute_fluxes_central(struct domain *D, double timestep){
     memset((char*) D->xmom_explicit_update, 0, D->number_of_elements * sizeof (double));
     memset((char*) D->ymom_explicit_update, 0, D->number_of_elements * sizeof (double));
 
-
-    // Counter for riverwall edges
-    RiverWall_count=0;
     // Which substep of the timestepping method are we on?
-    substep_count=(call-base_call)%D->timestep_fluxcalls;
+    substep_count=(call-D->flux_base_call[0])%D->timestep_fluxcalls;
 
-    //printf("call = %d substep_count = %d base_call = %d \n",call,substep_count, base_call);
+    //printf("call = %d substep_count = %d base_call = %d \n",call,substep_count, D->flux_base_call[0]);
 
     // Fluxes are not updated every timestep,
     // but all fluxes ARE updated when the following condition holds
     if(D->allow_timestep_increase[0]==1){
         // We can only increase the timestep if all fluxes are allowed to be updated
-        // If this is not done the timestep can't increase (since local_timestep is static)
-        local_timestep=1.0e+100;
+        // If this is not done the timestep can't increase (since local_timestep persists)
+        D->flux_local_timestep[0]=1.0e+100;
+    }
+    local_timestep = D->flux_local_timestep[0];
+
+    // Triangles without a flux due, or left out by active cell
+    // compaction, have no speed
+    if(substep_count==0 && flux_cells){
+        memset((char*) D->max_speed, 0, D->number_of_elements * sizeof (double));
     }
 
     // For all triangles
-    for (k = 0; k < D->number_of_elements; k++) {
+    for (j = 0; j < number_of_flux_cells; j++) {
+        k = flux_cells ? flux_cells[j] : j;
         speed_max_last = 0.0;
 
         // Loop through neighbours and compute edge flux for each
@@ -800,12 +1091,6 @@ double _compute_fluxes_central(struct domain *D, double timestep){
 
             if ((D->already_computed_flux[ki] == call) || (D->update_next_flux[ki]!=1)) {
                 // We've already computed the flux across this edge
-                // Check if it is a riverwall
-                if(D->edge_flux_type[ki] == 1){
-                    // Update counter of riverwall edges == index of
-                    // riverwall_elevation + riverwall_rowIndex
-                    RiverWall_count += 1;
-                }
                 continue;
             }
 
@@ -855,12 +1140,11 @@ double _compute_fluxes_central(struct domain *D, double timestep){
                 if( n>=0 && D->edge_flux_type[nm] != 1){
                     printf("Riverwall Error\n");
                 }
-                // Update counter of riverwall edges == index of
-                // riverwall_elevation + riverwall_rowIndex
-                RiverWall_count += 1;
+                // Index of riverwall_elevation + riverwall_rowIndex
+                rw = D->riverwall_index[ki];
 
                 // Set central bed to riverwall elevation
-                z_half = fmax(D->riverwall_elevation[RiverWall_count-1], z_half) ;
+                z_half = fmax(D->riverwall_elevation[rw], z_half) ;
 
             }
 
@@ -880,13 +1164,13 @@ double _compute_fluxes_central(struct domain *D, double timestep){
             // Force weir discharge to match weir theory
             // FIXME: Switched off at the moment
             if(D->edge_flux_type[ki]==1){
-                weir_height = fmax(D->riverwall_elevation[RiverWall_count-1] - fmin(zl, zr), 0.); // Reference weir height
+                weir_height = fmax(D->riverwall_elevation[rw] - fmin(zl, zr), 0.); // Reference weir height
 
                 // If the weir is not higher than both neighbouring cells, then
                 // do not try to match the weir equation. If we do, it seems we
                 // can get mass conservation issues (caused by large weir
                 // fluxes in such situations)
-                if(D->riverwall_elevation[RiverWall_count-1] > fmax(zc, zc_n)){
+                if(D->riverwall_elevation[rw] > fmax(zc, zc_n)){
                     ////////////////////////////////////////////////////////////////////////////////////
                     // Use first-order h's for weir -- as the 'upstream/downstream' heads are
                     //  measured away from the weir itself
@@ -901,7 +1185,7 @@ double _compute_fluxes_central(struct domain *D, double timestep){
 
                         //////////////////////////////////////////////////////////////////////////////////
                         // Get Qfactor index - multiply the idealised weir discharge by this constant factor
-                        ii = D->riverwall_rowIndex[RiverWall_count-1] * D->ncol_riverwall_hydraulic_properties;
+                        ii = D->riverwall_rowIndex[rw] * D->ncol_riverwall_hydraulic_properties;
                         Qfactor = D->riverwall_hydraulic_properties[ii];
 
                         // Get s1, submergence ratio at which we start blending with the shallow water solution
@@ -1070,7 +1354,8 @@ double _compute_fluxes_central(struct domain *D, double timestep){
     // }
 
     // Now add up stage, xmom, ymom explicit updates
-    for(k=0; k < D->number_of_elements; k++){
+    for(j=0; j < number_of_cells; j++){
+        k = cells ? cells[j] : j;
         hc = fmax(D->stage_centroid_values[k] - D->bed_centroid_values[k],0.);
 
         for(i=0;i<3;i++){
@@ -1108,184 +1393,883 @@ double _compute_fluxes_central(struct domain *D, double timestep){
 
     }  // end cell k
 
+    D->flux_local_timestep[0] = local_timestep;
+
     // Ensure we only update the timestep on the first call within each rk2/rk3 step
     if(substep_count == 0) timestep=local_timestep;
 
     return timestep;
 }
 
-// Protect against the water elevation falling below the triangle bed
-double  _protect(int N,
-         double minimum_allowed_height,
-         double maximum_allowed_speed,
-         double epsilon,
-         double* wc,
-         double* wv,
-         double* zc,
-         double* zv,
-         double* xmomc,
-         double* ymomc,
-         double* areas,
-         double* xc,
-         double* yc) {
+// Values either side of a single edge, edge i of triangle k (linear
+// index ki), shared with edge m of triangle n (linear index nm), or with
+// a boundary when n < 0. rw is the riverwall index of the edge, or -1.
+struct edge_state {
+    long k, ki, n, nm, rw;
+    double n1, n2, length;
+    double ql[3], qr[3];
+    double zl, zr, zc, zc_n, hc, hc_n, hle, hre;
+    double z_half, h_left, h_right;
+};
+
+// Gather the values either side of edge E->ki
+static inline int _get_edge_state(struct domain *D, struct edge_state *E){
+
+    long k = E->k, ki = E->ki, n = E->n, nm = E->nm, m;
+
+    // Get left hand side values from triangle k, edge i
+    E->ql[0] = D->stage_edge_values[ki];
+    E->ql[1] = D->xmom_edge_values[ki];
+    E->ql[2] = D->ymom_edge_values[ki];
+    E->zl = D->bed_edge_values[ki];
+    E->hc = D->height_centroid_values[k];
+    E->zc = D->bed_centroid_values[k];
+    E->hle= D->height_edge_values[ki];
+
+    // Get right hand side values either from neighbouring triangle
+    // or from boundary array (Quantities at neighbour on nearest face).
+    E->hc_n = E->hc;
+    E->zc_n = D->bed_centroid_values[k];
+    if (n < 0) {
+        // Neighbour is a boundary condition
+        m = -n - 1; // Convert negative flag to boundary index
+
+        E->qr[0] = D->stage_boundary_values[m];
+        E->qr[1] = D->xmom_boundary_values[m];
+        E->qr[2] = D->ymom_boundary_values[m];
+        E->zr = E->zl; // Extend bed elevation to boundary
+        E->hre= fmax(E->qr[0]-E->zr,0.);//hle;
+    } else {
+        // Neighbour is a real triangle
+        E->hc_n = D->height_centroid_values[n];
+        E->zc_n = D->bed_centroid_values[n];
+
+        E->qr[0] = D->stage_edge_values[nm];
+        E->qr[1] = D->xmom_edge_values[nm];
+        E->qr[2] = D->ymom_edge_values[nm];
+        E->zr = D->bed_edge_values[nm];
+        E->hre = D->height_edge_values[nm];
+    }
 
-  int k;
-  double hc, bmin;
-  double mass_error = 0.;
-  // This acts like minimum_allowed height, but scales with the vertical
-  // distance between the bed_centroid_value and the max bed_edge_value of
-  // every triangle.
-  //double minimum_relative_height=0.05;
-  //int mass_added = 0;
+    // Audusse magic
+    E->z_half = fmax(E->zl, E->zr);
 
-  // Protect against inifintesimal and negative heights
-  //if (maximum_allowed_speed < epsilon) {
-    for (k=0; k<N; k++) {
-      hc = wc[k] - zc[k];
-      if (hc < minimum_allowed_height*1.0 ){
-            // Set momentum to zero and ensure h is non negative
-            xmomc[k] = 0.;
-            ymomc[k] = 0.;
-        if (hc <= 0.0){
-             bmin = zc[k];
-             // Minimum allowed stage = bmin
+    //// Account for riverwalls
+    if(E->rw >= 0){
+        // Set central bed to riverwall elevation
+        E->z_half = fmax(D->riverwall_elevation[E->rw], E->z_half) ;
+    }
 
-             // WARNING: ADDING MASS if wc[k]<bmin
-             if(wc[k] < bmin){
-                 mass_error += (bmin-wc[k])*areas[k];
-                 //mass_added = 1; //Flag to warn of added mass
+    // Define h left/right for Audusse flux method
+    E->h_left = fmax(E->hle+E->zl-E->z_half,0.);
+    E->h_right = fmax(E->hre+E->zr-E->z_half,0.);
 
-                 wc[k] = bmin;
+    return 0;
+}
 
-                 // FIXME: Set vertex values as well. Seems that this shouldn't be
-                 // needed. However, from memory this is important at the first
-                 // time step, for 'dry' areas where the designated stage is
-                 // less than the bed centroid value
-                 wv[3*k] = bmin; //min(bmin, wc[k]); //zv[3*k]-minimum_allowed_height);
-                 wv[3*k+1] = bmin; //min(bmin, wc[k]); //zv[3*k+1]-minimum_allowed_height);
-                 wv[3*k+2] = bmin; //min(bmin, wc[k]); //zv[3*k+2]-minimum_allowed_height);
+// Given the flux through edge E->ki from the flux function, apply the
+// weir adjustment for riverwalls, and write the edge flux and pressure
+// gradient terms on both sides of the edge, and the edge timesteps on
+// the first substep.
+static inline int _update_edge_flux(struct domain *D, struct edge_state *E,
+        double *edgeflux, double pressure_flux,
+        long substep_count, double *max_speed_local){
+
+    long k = E->k, ki = E->ki, n = E->n, nm = E->nm, rw = E->rw;
+    double length = E->length;
+    double bedslope_work, weir_height, tmp;
+    double Qfactor, s1, s2, h1, h2;
+    double h_left_tmp, h_right_tmp;
+    long ii, ki3, nm3;
+
+    ki3 = 3*ki;
+
+    // Force weir discharge to match weir theory
+    if(rw >= 0){
+        weir_height = fmax(D->riverwall_elevation[rw] - fmin(E->zl, E->zr), 0.); // Reference weir height
+
+        // If the weir is not higher than both neighbouring cells, then
+        // do not try to match the weir equation (see the serial version)
+        if(D->riverwall_elevation[rw] > fmax(E->zc, E->zc_n)){
+            // Use first-order h's for weir -- as the 'upstream/downstream' heads are
+            //  measured away from the weir itself
+            h_left_tmp = fmax(D->stage_centroid_values[k] - E->z_half, 0.);
+            if(n >= 0){
+                h_right_tmp = fmax(D->stage_centroid_values[n] - E->z_half, 0.);
+            }else{
+                h_right_tmp = fmax(E->hc_n + E->zr - E->z_half, 0.);
             }
-        }
-      }
-    }
-
-  //if(mass_added == 1){
-  //  printf("Cumulative mass protection: %f m^3 \n", mass_error);
-  //}
 
-  return mass_error;
-}
+            if( (h_left_tmp > 0.) || (h_right_tmp > 0.)){
 
-// Protect against the water elevation falling below the triangle bed
-double  _protect_new(struct domain *D) {
+                // Hydraulic properties: Qfactor, s1, s2, h1, h2
+                ii = D->riverwall_rowIndex[rw] * D->ncol_riverwall_hydraulic_properties;
+                Qfactor = D->riverwall_hydraulic_properties[ii];
+                s1 = D->riverwall_hydraulic_properties[ii + 1];
+                s2 = D->riverwall_hydraulic_properties[ii + 2];
+                h1 = D->riverwall_hydraulic_properties[ii + 3];
+                h2 = D->riverwall_hydraulic_properties[ii + 4];
 
-  int k;
-  double hc, bmin;
-  double mass_error = 0.;
+                // Weir flux adjustment
+                adjust_edgeflux_with_weir(edgeflux, h_left_tmp, h_right_tmp, D->g,
+                                          weir_height, Qfactor,
+                                          s1, s2, h1, h2, max_speed_local);
+            }
+        }
+    }
 
-  double* wc;
-  double* zc;
-  double* wv;
-  double* xmomc;
-  double* ymomc;
-  double* areas;
+    // Multiply edgeflux by edgelength
+    edgeflux[0] *= length;
+    edgeflux[1] *= length;
+    edgeflux[2] *= length;
 
-  double minimum_allowed_height;
+    D->edge_flux_work[ki3 + 0 ] = -edgeflux[0];
+    D->edge_flux_work[ki3 + 1 ] = -edgeflux[1];
+    D->edge_flux_work[ki3 + 2 ] = -edgeflux[2];
 
-  minimum_allowed_height = D->minimum_allowed_height;
+    // bedslope_work contains all gravity related terms
+    bedslope_work = length*(- D->g *0.5*(E->h_left*E->h_left - E->hle*E->hle -(E->hle+E->hc)*(E->zl-E->zc))+pressure_flux);
 
-  wc = D->stage_centroid_values;
-  zc = D->bed_centroid_values;
-  wv = D->stage_vertex_values;
-  xmomc = D->xmom_centroid_values;
-  ymomc = D->ymom_centroid_values;
-  areas = D->areas;
+    D->pressuregrad_work[ki] = bedslope_work;
 
-  // This acts like minimum_allowed height, but scales with the vertical
-  // distance between the bed_centroid_value and the max bed_edge_value of
-  // every triangle.
-  //double minimum_relative_height=0.05;
-  //int mass_added = 0;
+    D->already_computed_flux[ki] = D->flux_call[0]; // #k Done
 
-  // Protect against inifintesimal and negative heights
-  //if (maximum_allowed_speed < epsilon) {
-    for (k=0; k<D->number_of_elements; k++) {
-      hc = wc[k] - zc[k];
-      if (hc < minimum_allowed_height*1.0 ){
-            // Set momentum to zero and ensure h is non negative
-            xmomc[k] = 0.;
-            ymomc[k] = 0.;
-        if (hc <= 0.0){
-             bmin = zc[k];
-             // Minimum allowed stage = bmin
+    // Update neighbour n with same flux but reversed sign
+    if (n >= 0) {
+        nm3 = nm*3;
+        D->edge_flux_work[nm3 + 0 ] = edgeflux[0];
+        D->edge_flux_work[nm3 + 1 ] = edgeflux[1];
+        D->edge_flux_work[nm3 + 2 ] = edgeflux[2];
+        bedslope_work = length*(-D->g * 0.5 *( E->h_right*E->h_right - E->hre*E->hre- (E->hre+E->hc_n)*(E->zr-E->zc_n)) + pressure_flux);
+        D->pressuregrad_work[nm] = bedslope_work;
 
-             // WARNING: ADDING MASS if wc[k]<bmin
-             if(wc[k] < bmin){
-                 mass_error += (bmin-wc[k])*areas[k];
-                 //mass_added = 1; //Flag to warn of added mass
+        D->already_computed_flux[nm] = D->flux_call[0]; // #n Done
+    }
 
-                 wc[k] = bmin;
+    // Update timestep based on edge i and possibly neighbour n
+    // NOTE: We should only change the timestep on the 'first substep'
+    //  of the timestepping method [substep_count==0]
+    if(substep_count==0){
 
-                 // FIXME: Set vertex values as well. Seems that this shouldn't be
-                 // needed. However, from memory this is important at the first
-                 // time step, for 'dry' areas where the designated stage is
-                 // less than the bed centroid value
-                 wv[3*k] = bmin; //min(bmin, wc[k]); //zv[3*k]-minimum_allowed_height);
-                 wv[3*k+1] = bmin; //min(bmin, wc[k]); //zv[3*k+1]-minimum_allowed_height);
-                 wv[3*k+2] = bmin; //min(bmin, wc[k]); //zv[3*k+2]-minimum_allowed_height);
-            }
+        // Compute the 'edge-timesteps' (useful for setting flux_update_frequency)
+        tmp = 1.0 / fmax(*max_speed_local, D->epsilon);
+        D->edge_timestep[ki] = D->radii[k] * tmp ;
+        if (n >= 0) {
+            D->edge_timestep[nm] = D->radii[n] * tmp;
         }
-      }
     }
 
-  //if(mass_added == 1){
-  //  printf("Cumulative mass protection: %f m^3 \n", mass_error);
-  //}
-
-  return mass_error;
+    return 0;
 }
 
+// Flux through a single edge, see struct edge_state for the arguments.
+// Used by the threaded and edge based flux computations, which must
+// agree exactly with _compute_fluxes_central.
+static inline int _compute_edge_flux(struct domain *D,
+        long k, long ki, long n, long nm, long rw,
+        double n1, double n2, double length,
+        long substep_count, double *max_speed_local){
 
+    struct edge_state E;
+    double edgeflux[3], pressure_flux;
+    // FIXME: limiting_threshold is not used for DE1
+    double limiting_threshold = 10*D->H0;
 
+    E.k = k; E.ki = ki; E.n = n; E.nm = nm; E.rw = rw;
+    E.n1 = n1; E.n2 = n2; E.length = length;
 
-int find_qmin_and_qmax(double dq0, double dq1, double dq2,
-               double *qmin, double *qmax){
-  // Considering the centroid of an FV triangle and the vertices of its
-  // auxiliary triangle, find
-  // qmin=min(q)-qc and qmax=max(q)-qc,
-  // where min(q) and max(q) are respectively min and max over the
-  // four values (at the centroid of the FV triangle and the auxiliary
-  // triangle vertices),
-  // and qc is the centroid
-  // dq0=q(vertex0)-q(centroid of FV triangle)
-  // dq1=q(vertex1)-q(vertex0)
-  // dq2=q(vertex2)-q(vertex0)
+    _get_edge_state(D, &E);
 
-  // This is a simple implementation
-  *qmax = fmax(fmax(dq0, fmax(dq0+dq1, dq0+dq2)), 0.0) ;
-  *qmin = fmin(fmin(dq0, fmin(dq0+dq1, dq0+dq2)), 0.0) ;
+    // Edge flux computation (triangle k, edge i)
+    _flux_function_central(E.ql, E.qr,
+        E.h_left, E.h_right,
+        E.hle, E.hre,
+        E.n1, E.n2,
+        D->epsilon, E.z_half, limiting_threshold, D->g,
+        edgeflux, max_speed_local, &pressure_flux, E.hc, E.hc_n, D->low_froude);
 
-  return 0;
+    _update_edge_flux(D, &E, edgeflux, pressure_flux, substep_count, max_speed_local);
+
+    return 0;
 }
 
-int limit_gradient(double *dqv, double qmin, double qmax, double beta_w){
-  // Given provisional jumps dqv from the FV triangle centroid to its
-  // vertices/edges, and jumps qmin (qmax) between the centroid of the FV
-  // triangle and the minimum (maximum) of the values at the auxiliary triangle
-  // vertices (which are centroids of neighbour mesh triangles), calculate a
-  // multiplicative factor phi by which the provisional vertex jumps are to be
-  // limited
+// Sum the edge fluxes and pressure gradients of each triangle into
+// the explicit updates, and accumulate the flux through the boundary
+// into boundary_flux_sum. Both sums are done in the same order as
+// _compute_fluxes_central. If cells is not NULL only the listed cells
+// are summed, and the explicit updates of the others are zero.
+static inline int _sum_explicit_updates(struct domain *D, long substep_count,
+                                        long number_of_cells, long* cells){
 
-  int i;
-  double r=1000.0, r0=1.0, phi=1.0;
-  static double TINY = 1.0e-100; // to avoid machine accuracy problems.
-  // FIXME: Perhaps use the epsilon used elsewhere.
+    long j, kj;
 
-  // Any provisional jump with magnitude < TINY does not contribute to
-  // the limiting process.
-  //return 0;
+    if (cells) {
+        memset((char*) D->stage_explicit_update, 0, D->number_of_elements * sizeof (double));
+        memset((char*) D->xmom_explicit_update, 0, D->number_of_elements * sizeof (double));
+        memset((char*) D->ymom_explicit_update, 0, D->number_of_elements * sizeof (double));
+    }
 
-  for (i=0;i<3;i++){
+    // Now add up stage, xmom, ymom explicit updates
+    #pragma omp parallel for schedule(static) if(D->multiprocessor_mode == 1)
+    for(j=0; j < number_of_cells; j++){
+        long k, i, ki, ki2, ki3;
+        double inv_area;
+
+        k = cells ? cells[j] : j;
+
+        // Set explicit_update to zero for all conserved_quantities.
+        // This assumes compute_fluxes called before forcing terms
+        D->stage_explicit_update[k] = 0.;
+        D->xmom_explicit_update[k] = 0.;
+        D->ymom_explicit_update[k] = 0.;
+
+        for(i=0;i<3;i++){
+            ki=3*k+i;
+            ki2=ki*2;
+            ki3 = ki*3;
+
+            D->stage_explicit_update[k] += D->edge_flux_work[ki3+0];
+            D->xmom_explicit_update[k] += D->edge_flux_work[ki3+1];
+            D->ymom_explicit_update[k] += D->edge_flux_work[ki3+2];
+
+            D->xmom_explicit_update[k] -= D->normals[ki2]*D->pressuregrad_work[ki];
+            D->ymom_explicit_update[k] -= D->normals[ki2+1]*D->pressuregrad_work[ki];
+        }
+
+        // Normalise triangle k by area and store for when all conserved
+        // quantities get updated
+        inv_area = 1.0 / D->areas[k];
+        D->stage_explicit_update[k] *= inv_area;
+        D->xmom_explicit_update[k] *= inv_area;
+        D->ymom_explicit_update[k] *= inv_area;
+    }
+
+    // Fluxes through the boundary edges of full triangles, and the edges
+    // between full and ghost triangles, in the same order as the serial loop
+    for(j=0; j < D->number_of_boundary_flux_edges; j++){
+        kj = D->boundary_flux_edges[j];
+        D->boundary_flux_sum[substep_count] += D->edge_flux_work[3*kj];
+    }
+
+    return 0;
+}
+
+// Threaded version of _compute_fluxes_central
+//
+// Each edge is computed once, by a single owning triangle. The owner is
+// the triangle the serial loop would compute the edge from: triangle k
+// owns edge i if its flux is due for update and the neighbour n has not
+// got to it first (n < k with its own flux due for update). The owner
+// writes the work arrays on both sides of the edge, and as no other
+// thread touches those slots the loop is race free.
+//
+// The timestep is found with a min reduction, and boundary_flux_sum is
+// accumulated over the precomputed boundary_flux_edges in edge order,
+// so the results are identical to the serial version for any number
+// of threads. With active cell compaction, edges owned by a cell left
+// out of the loop keep their (zero) fluxes.
+//
+// The flux call is split into _begin_flux_call, the loop over cells in
+// _compute_fluxes_central_cells and _finish_flux_call, so that the loop
+// can be made in parts (see _openmp_compute_fluxes_central_part).
+
+// Start a flux call, returns the substep of the timestepping method
+static inline long _begin_flux_call(struct domain *D){
+
+    long call;
+
+    // State between calls is kept in the domain, so kernels are reentrant
+    D->flux_call[0]++; // Flag 'id' of flux calculation for this timestep
+    call = D->flux_call[0];
+
+    if (D->timestep_fluxcalls != D->flux_last_timestep_fluxcalls[0]) {
+    	D->flux_last_timestep_fluxcalls[0] = D->timestep_fluxcalls;
+    	D->flux_base_call[0] = call;
+    }
+
+    // Fluxes are not updated every timestep,
+    // but all fluxes ARE updated when the following condition holds
+    if(D->allow_timestep_increase[0]==1){
+        D->flux_local_timestep[0]=1.0e+100;
+    }
+
+    // Which substep of the timestepping method are we on?
+    return (call-D->flux_base_call[0])%D->timestep_fluxcalls;
+}
+
+// Edge fluxes owned by the given cells, returns local_timestep_min
+// reduced with the CFL timesteps of their edges
+static inline double _compute_fluxes_central_cells(struct domain *D, long substep_count,
+                                                   long number_of_flux_cells, long* flux_cells,
+                                                   double local_timestep_min){
+
+    long j;
+
+    // For all triangles
+    #pragma omp parallel for schedule(static) reduction(min:local_timestep_min) if(D->multiprocessor_mode == 1)
+    for (j = 0; j < number_of_flux_cells; j++) {
+
+        double max_speed_local, speed_max_last;
+        long k, i, m, n, ki, ki2, nm = 0, rw;
+
+        k = flux_cells ? flux_cells[j] : j;
+        speed_max_last = 0.0;
+
+        // Loop through neighbours and compute edge flux for each
+        for (i = 0; i < 3; i++) {
+            ki = k * 3 + i; // Linear index to edge i of triangle k
+            ki2 = 2 * ki; //k*6 + i*2
+
+            n = D->neighbours[ki];
+            if (n >= 0) {
+                m = D->neighbour_edges[ki];
+                nm = n * 3 + m; // Linear index (triangle n, edge m)
+            }
+
+            // Skip edges which are not updated, or are owned by neighbour n
+            if (D->update_next_flux[ki] != 1) continue;
+            if (n >= 0 && n < k && D->update_next_flux[nm] == 1) continue;
+
+            //// Account for riverwalls
+            rw = -1;
+            if(D->edge_flux_type[ki] == 1){
+                if( n>=0 && D->edge_flux_type[nm] != 1){
+                    printf("Riverwall Error\n");
+                }
+                // Index of riverwall_elevation + riverwall_rowIndex
+                rw = D->riverwall_index[ki];
+            }
+
+            _compute_edge_flux(D, k, ki, n, nm, rw,
+                D->normals[ki2], D->normals[ki2 + 1], D->edgelengths[ki],
+                substep_count, &max_speed_local);
+
+            // Update timestep based on edge i and possibly neighbour n
+            // NOTE: We should only change the timestep on the 'first substep'
+            //  of the timestepping method [substep_count==0]
+            if(substep_count==0){
+
+                // Update the timestep
+                if ((D->tri_full_flag[k] == 1)) {
+
+                    speed_max_last = fmax(speed_max_last, max_speed_local);
+
+                    if (max_speed_local > D->epsilon) {
+                        // Apply CFL condition for triangles joining this edge (triangle k and triangle n)
+
+                        // CFL for triangle k
+                        local_timestep_min = fmin(local_timestep_min, D->edge_timestep[ki]);
+
+                        if (n >= 0) {
+                            // Apply CFL condition for neigbour n (which is on the ith edge of triangle k)
+                            local_timestep_min = fmin(local_timestep_min, D->edge_timestep[nm]);
+                        }
+                    }
+                }
+            }
+
+        } // End edge i (and neighbour n)
+        // Keep track of maximal speeds
+        if(substep_count==0) D->max_speed[k] = speed_max_last; //max_speed;
+
+    } // End triangle k
+
+    return local_timestep_min;
+}
+
+// Finish a flux call, returns the timestep
+static inline double _finish_flux_call(struct domain *D, long substep_count,
+                                       long number_of_cells, long* cells,
+                                       double local_timestep_min, double timestep){
+
+    _sum_explicit_updates(D, substep_count, number_of_cells, cells);
+
+    D->flux_local_timestep[0] = local_timestep_min;
+
+    // Ensure we only update the timestep on the first call within each rk2/rk3 step
+    if(substep_count == 0) timestep=local_timestep_min;
+
+    return timestep;
+}
+
+double _openmp_compute_fluxes_central(struct domain *D, double timestep){
+
+    long substep_count, number_of_cells, number_of_flux_cells;
+    long* cells;
+    long* flux_cells;
+    double local_timestep_min;
+
+    // Cells to loop over (all of them unless active cell compaction is
+    // on), and for the fluxes only those with a flux due
+    cells = _get_active_cells(D, &number_of_cells);
+    flux_cells = _get_flux_update_cells(D, &number_of_flux_cells);
+    if (cells) {
+        flux_cells = cells;
+        number_of_flux_cells = number_of_cells;
+    }
+
+    substep_count = _begin_flux_call(D);
+    local_timestep_min = D->flux_local_timestep[0];
+
+    // Triangles without a flux due, or left out by active cell
+    // compaction, have no speed
+    if(substep_count==0 && flux_cells){
+        memset((char*) D->max_speed, 0, D->number_of_elements * sizeof (double));
+    }
+
+    local_timestep_min = _compute_fluxes_central_cells(D, substep_count,
+            number_of_flux_cells, flux_cells, local_timestep_min);
+
+    return _finish_flux_call(D, substep_count, number_of_cells, cells,
+                             local_timestep_min, timestep);
+}
+
+// Part of an _openmp_compute_fluxes_central call: the fluxes owned by the
+// given cells. The first part begins the flux call and the last finishes
+// it, returning the timestep, and the minimum CFL timestep is kept in
+// flux_local_timestep in between. Every edge must be owned by a cell of
+// exactly one part, and the edge values of the cells and their neighbours
+// must be up to date when a part is computed. Only for use without active
+// cell compaction and with max_flux_update_frequency == 1, when all
+// fluxes are due every timestep.
+double _openmp_compute_fluxes_central_part(struct domain *D, double timestep,
+                                           long number_of_flux_cells, long* flux_cells,
+                                           int first, int last){
+
+    long substep_count;
+
+    if (first) {
+        substep_count = _begin_flux_call(D);
+    } else {
+        substep_count = (D->flux_call[0]-D->flux_base_call[0])%D->timestep_fluxcalls;
+    }
+
+    D->flux_local_timestep[0] = _compute_fluxes_central_cells(D, substep_count,
+            number_of_flux_cells, flux_cells, D->flux_local_timestep[0]);
+
+    if (!last) {
+        return timestep;
+    }
+
+    return _finish_flux_call(D, substep_count, D->number_of_elements, NULL,
+                             D->flux_local_timestep[0], timestep);
+}
+
+// Edge based version of _compute_fluxes_central
+//
+// Streams over the unique edges of the mesh (see build_edge_structure in
+// swDE1_domain_ext.pyx) rather than over the 3 edges of each triangle,
+// so each flux is visited once and the cell ids, normal, length and
+// riverwall index of an edge are read from contiguous memory.
+//
+// An edge is computed from its first cell (the lower indexed triangle)
+// unless only the second cell is due for a flux update, which is the
+// side _compute_fluxes_central would compute it from, so the results
+// are identical. The maximum speed seen by each cell is stored per edge
+// in edge_max_speed and reduced over the cells afterwards.
+//
+// Edges are processed in blocks of FLUX_BATCH_SIZE. With simd_fluxes == 1
+// the fluxes of a block are computed by _flux_function_central_batch,
+// which agrees with the scalar flux function to rounding only. With
+// multiprocessor_mode == 1 the loop over blocks is threaded.
+double _compute_fluxes_central_edges(struct domain *D, double timestep){
+
+    long b, k, call, nblocks, substep_count;
+    double local_timestep_min;
+
+    // State between calls is kept in the domain, so kernels are reentrant
+    D->flux_call[0]++; // Flag 'id' of flux calculation for this timestep
+    call = D->flux_call[0];
+
+    if (D->timestep_fluxcalls != D->flux_last_timestep_fluxcalls[0]) {
+    	D->flux_last_timestep_fluxcalls[0] = D->timestep_fluxcalls;
+    	D->flux_base_call[0] = call;
+    }
+
+    // Which substep of the timestepping method are we on?
+    substep_count=(call-D->flux_base_call[0])%D->timestep_fluxcalls;
+
+    // Fluxes are not updated every timestep,
+    // but all fluxes ARE updated when the following condition holds
+    if(D->allow_timestep_increase[0]==1){
+        D->flux_local_timestep[0]=1.0e+100;
+    }
+    local_timestep_min = D->flux_local_timestep[0];
+
+    nblocks = (D->number_of_unique_edges + FLUX_BATCH_SIZE - 1)/FLUX_BATCH_SIZE;
+
+    // For all blocks of unique edges
+    #pragma omp parallel for schedule(static) reduction(min:local_timestep_min) if(D->multiprocessor_mode == 1)
+    for (b = 0; b < nblocks; b++) {
+
+        struct edge_state E[FLUX_BATCH_SIZE];
+        long active[FLUX_BATCH_SIZE];
+        double ql[3*FLUX_BATCH_SIZE], qr[3*FLUX_BATCH_SIZE];
+        double h_left[FLUX_BATCH_SIZE], h_right[FLUX_BATCH_SIZE];
+        double hle[FLUX_BATCH_SIZE], hre[FLUX_BATCH_SIZE];
+        double n1[FLUX_BATCH_SIZE], n2[FLUX_BATCH_SIZE], ze[FLUX_BATCH_SIZE];
+        double edgeflux_batch[3*FLUX_BATCH_SIZE], max_speed_batch[FLUX_BATCH_SIZE];
+        double pressure_flux_batch[FLUX_BATCH_SIZE];
+        double edgeflux[3], max_speed_local, pressure_flux;
+        // FIXME: limiting_threshold is not used for DE1
+        double limiting_threshold = 10*D->H0;
+        long j, c, e, e2, tmp, nlanes;
+
+        nlanes = D->number_of_unique_edges - b*FLUX_BATCH_SIZE;
+        if (nlanes > FLUX_BATCH_SIZE) nlanes = FLUX_BATCH_SIZE;
+
+        // Gather the edges of the block
+        for (j = 0; j < nlanes; j++) {
+            e = b*FLUX_BATCH_SIZE + j;
+            e2 = 2*e;
+            E[j].k = D->edge_cells[e2];
+            E[j].n = D->edge_cells[e2 + 1];
+            E[j].ki = D->edge_half_edges[e2];
+            E[j].nm = D->edge_half_edges[e2 + 1];
+            E[j].rw = D->edge_riverwall_index[e];
+            E[j].n1 = D->edge_normals[e2];
+            E[j].n2 = D->edge_normals[e2 + 1];
+            E[j].length = D->edge_lengths[e];
+
+            active[j] = 1;
+            if (D->update_next_flux[E[j].ki] != 1) {
+                if (E[j].n < 0 || D->update_next_flux[E[j].nm] != 1) {
+                    // Not due for update, so no speed from this edge
+                    if (substep_count == 0) {
+                        D->edge_max_speed[E[j].ki] = 0.0;
+                        if (E[j].n >= 0) D->edge_max_speed[E[j].nm] = 0.0;
+                    }
+                    active[j] = 0;
+                    continue;
+                }
+
+                // Compute from the second cell, with its own normal and length
+                tmp = E[j].k; E[j].k = E[j].n; E[j].n = tmp;
+                tmp = E[j].ki; E[j].ki = E[j].nm; E[j].nm = tmp;
+                E[j].n1 = D->normals[2*E[j].ki];
+                E[j].n2 = D->normals[2*E[j].ki + 1];
+                E[j].length = D->edgelengths[E[j].ki];
+            }
+
+            _get_edge_state(D, &E[j]);
+        }
+
+        if (D->simd_fluxes == 1) {
+            // Pack the block into lanes, inactive and unused lanes are dry
+            for (j = 0; j < FLUX_BATCH_SIZE; j++) {
+                if (j < nlanes && active[j]) {
+                    for (c = 0; c < 3; c++) {
+                        ql[c*FLUX_BATCH_SIZE + j] = E[j].ql[c];
+                        qr[c*FLUX_BATCH_SIZE + j] = E[j].qr[c];
+                    }
+                    h_left[j] = E[j].h_left;
+                    h_right[j] = E[j].h_right;
+                    hle[j] = E[j].hle;
+                    hre[j] = E[j].hre;
+                    n1[j] = E[j].n1;
+                    n2[j] = E[j].n2;
+                    ze[j] = E[j].z_half;
+                } else {
+                    for (c = 0; c < 3; c++) {
+                        ql[c*FLUX_BATCH_SIZE + j] = 0.0;
+                        qr[c*FLUX_BATCH_SIZE + j] = 0.0;
+                    }
+                    h_left[j] = 0.0;
+                    h_right[j] = 0.0;
+                    hle[j] = 0.0;
+                    hre[j] = 0.0;
+                    n1[j] = 1.0;
+                    n2[j] = 0.0;
+                    ze[j] = 0.0;
+                }
+            }
+
+            _flux_function_central_batch(FLUX_BATCH_SIZE, ql, qr,
+                h_left, h_right, hle, hre, n1, n2,
+                D->epsilon, ze, D->g,
+                edgeflux_batch, max_speed_batch, pressure_flux_batch,
+                D->low_froude);
+        }
+
+        for (j = 0; j < nlanes; j++) {
+            if (!active[j]) continue;
+
+            if (D->simd_fluxes == 1) {
+                edgeflux[0] = edgeflux_batch[j];
+                edgeflux[1] = edgeflux_batch[FLUX_BATCH_SIZE + j];
+                edgeflux[2] = edgeflux_batch[2*FLUX_BATCH_SIZE + j];
+                max_speed_local = max_speed_batch[j];
+                pressure_flux = pressure_flux_batch[j];
+            } else {
+                _flux_function_central(E[j].ql, E[j].qr,
+                    E[j].h_left, E[j].h_right,
+                    E[j].hle, E[j].hre,
+                    E[j].n1, E[j].n2,
+                    D->epsilon, E[j].z_half, limiting_threshold, D->g,
+                    edgeflux, &max_speed_local, &pressure_flux,
+                    E[j].hc, E[j].hc_n, D->low_froude);
+            }
+
+            _update_edge_flux(D, &E[j], edgeflux, pressure_flux,
+                substep_count, &max_speed_local);
+
+            // Update timestep based on the edge
+            // NOTE: We should only change the timestep on the 'first substep'
+            //  of the timestepping method [substep_count==0]
+            if(substep_count==0){
+
+                D->edge_max_speed[E[j].ki] = 0.0;
+                if (E[j].n >= 0) D->edge_max_speed[E[j].nm] = 0.0;
+
+                if ((D->tri_full_flag[E[j].k] == 1)) {
+
+                    // The speed only counts towards the computing cell
+                    D->edge_max_speed[E[j].ki] = max_speed_local;
+
+                    if (max_speed_local > D->epsilon) {
+                        // Apply CFL condition for both cells joining this edge
+                        local_timestep_min = fmin(local_timestep_min, D->edge_timestep[E[j].ki]);
+
+                        if (E[j].n >= 0) {
+                            local_timestep_min = fmin(local_timestep_min, D->edge_timestep[E[j].nm]);
+                        }
+                    }
+                }
+            }
+        } // End edge j of block
+
+    } // End block b
+
+    // Keep track of maximal speeds
+    if(substep_count==0){
+        #pragma omp parallel for schedule(static) if(D->multiprocessor_mode == 1)
+        for (k = 0; k < D->number_of_elements; k++) {
+            double speed_max_last = 0.0;
+            long i;
+            for (i = 0; i < 3; i++) {
+                speed_max_last = fmax(speed_max_last, D->edge_max_speed[3*k + i]);
+            }
+            D->max_speed[k] = speed_max_last;
+        }
+    }
+
+    _sum_explicit_updates(D, substep_count, D->number_of_elements, NULL);
+
+    D->flux_local_timestep[0] = local_timestep_min;
+
+    // Ensure we only update the timestep on the first call within each rk2/rk3 step
+    if(substep_count == 0) timestep=local_timestep_min;
+
+    return timestep;
+}
+
+// Set the number of threads used by the threaded (_openmp_) kernels
+int _set_omp_num_threads(int num_threads){
+#if defined(_OPENMP)
+    omp_set_num_threads(num_threads);
+#endif
+    return 0;
+}
+
+// Protect against the water elevation falling below the triangle bed
+double  _protect(int N,
+         double minimum_allowed_height,
+         double maximum_allowed_speed,
+         double epsilon,
+         double* wc,
+         double* wv,
+         double* zc,
+         double* zv,
+         double* xmomc,
+         double* ymomc,
+         double* areas,
+         double* xc,
+         double* yc) {
+
+  int k;
+  double hc, bmin;
+  double mass_error = 0.;
+  // This acts like minimum_allowed height, but scales with the vertical
+  // distance between the bed_centroid_value and the max bed_edge_value of
+  // every triangle.
+  //double minimum_relative_height=0.05;
+  //int mass_added = 0;
+
+  // Protect against inifintesimal and negative heights
+  //if (maximum_allowed_speed < epsilon) {
+    for (k=0; k<N; k++) {
+      hc = wc[k] - zc[k];
+      if (hc < minimum_allowed_height*1.0 ){
+            // Set momentum to zero and ensure h is non negative
+            xmomc[k] = 0.;
+            ymomc[k] = 0.;
+        if (hc <= 0.0){
+             bmin = zc[k];
+             // Minimum allowed stage = bmin
+
+             // WARNING: ADDING MASS if wc[k]<bmin
+             if(wc[k] < bmin){
+                 mass_error += (bmin-wc[k])*areas[k];
+                 //mass_added = 1; //Flag to warn of added mass
+
+                 wc[k] = bmin;
+
+                 // FIXME: Set vertex values as well. Seems that this shouldn't be
+                 // needed. However, from memory this is important at the first
+                 // time step, for 'dry' areas where the designated stage is
+                 // less than the bed centroid value
+                 wv[3*k] = bmin; //min(bmin, wc[k]); //zv[3*k]-minimum_allowed_height);
+                 wv[3*k+1] = bmin; //min(bmin, wc[k]); //zv[3*k+1]-minimum_allowed_height);
+                 wv[3*k+2] = bmin; //min(bmin, wc[k]); //zv[3*k+2]-minimum_allowed_height);
+            }
+        }
+      }
+    }
+
+  //if(mass_added == 1){
+  //  printf("Cumulative mass protection: %f m^3 \n", mass_error);
+  //}
+
+  return mass_error;
+}
+
+// Protect against the water elevation falling below the triangle bed,
+// in the given cells (all cells if cells is NULL)
+double  _protect_cells(struct domain *D, long number_of_cells, long* cells) {
+
+  long k, j;
+  double hc, bmin;
+  double mass_error = 0.;
+
+  double* wc;
+  double* zc;
+  double* wv;
+  float* wv_single;
+  double* xmomc;
+  double* ymomc;
+  double* areas;
+
+  double minimum_allowed_height;
+
+  minimum_allowed_height = D->minimum_allowed_height;
+
+  wc = D->stage_centroid_values;
+  zc = D->bed_centroid_values;
+  wv = D->stage_vertex_values;
+  wv_single = D->stage_vertex_values_single;
+  xmomc = D->xmom_centroid_values;
+  ymomc = D->ymom_centroid_values;
+  areas = D->areas;
+
+  // This acts like minimum_allowed height, but scales with the vertical
+  // distance between the bed_centroid_value and the max bed_edge_value of
+  // every triangle.
+  //double minimum_relative_height=0.05;
+  //int mass_added = 0;
+
+  // Protect against inifintesimal and negative heights
+  //if (maximum_allowed_speed < epsilon) {
+    for (j=0; j<number_of_cells; j++) {
+      k = cells ? cells[j] : j;
+      hc = wc[k] - zc[k];
+      if (hc < minimum_allowed_height*1.0 ){
+            // Set momentum to zero and ensure h is non negative
+            xmomc[k] = 0.;
+            ymomc[k] = 0.;
+        if (hc <= 0.0){
+             bmin = zc[k];
+             // Minimum allowed stage = bmin
+
+             // WARNING: ADDING MASS if wc[k]<bmin
+             if(wc[k] < bmin){
+                 mass_error += (bmin-wc[k])*areas[k];
+                 //mass_added = 1; //Flag to warn of added mass
+
+                 wc[k] = bmin;
+
+                 // FIXME: Set vertex values as well. Seems that this shouldn't be
+                 // needed. However, from memory this is important at the first
+                 // time step, for 'dry' areas where the designated stage is
+                 // less than the bed centroid value
+                 if (wv_single) {
+                   wv_single[3*k] = (float) bmin;
+                   wv_single[3*k+1] = (float) bmin;
+                   wv_single[3*k+2] = (float) bmin;
+                 } else {
+                   wv[3*k] = bmin; //min(bmin, wc[k]); //zv[3*k]-minimum_allowed_height);
+                   wv[3*k+1] = bmin; //min(bmin, wc[k]); //zv[3*k+1]-minimum_allowed_height);
+                   wv[3*k+2] = bmin; //min(bmin, wc[k]); //zv[3*k+2]-minimum_allowed_height);
+                 }
+            }
+        }
+      }
+    }
+
+  //if(mass_added == 1){
+  //  printf("Cumulative mass protection: %f m^3 \n", mass_error);
+  //}
+
+  return mass_error;
+}
+
+// Protect against the water elevation falling below the triangle bed
+double  _protect_new(struct domain *D) {
+
+  long number_of_cells;
+  long* cells = NULL;
+
+  // Protection is the first step of each timestep, so find the cells
+  // for this timestep here. Cells left out are already protected.
+  number_of_cells = D->number_of_elements;
+  if (_use_active_cells(D)) {
+    _update_active_cells(D);
+    cells = _get_extrapolation_cells(D, &number_of_cells);
+  }
+
+  return _protect_cells(D, number_of_cells, cells);
+}
+
+
+
+
+int find_qmin_and_qmax(double dq0, double dq1, double dq2,
+               double *qmin, double *qmax){
+  // Considering the centroid of an FV triangle and the vertices of its
+  // auxiliary triangle, find
+  // qmin=min(q)-qc and qmax=max(q)-qc,
+  // where min(q) and max(q) are respectively min and max over the
+  // four values (at the centroid of the FV triangle and the auxiliary
+  // triangle vertices),
+  // and qc is the centroid
+  // dq0=q(vertex0)-q(centroid of FV triangle)
+  // dq1=q(vertex1)-q(vertex0)
+  // dq2=q(vertex2)-q(vertex0)
+
+  // This is a simple implementation
+  *qmax = fmax(fmax(dq0, fmax(dq0+dq1, dq0+dq2)), 0.0) ;
+  *qmin = fmin(fmin(dq0, fmin(dq0+dq1, dq0+dq2)), 0.0) ;
+
+  return 0;
+}
+
+int limit_gradient(double *dqv, double qmin, double qmax, double beta_w){
+  // Given provisional jumps dqv from the FV triangle centroid to its
+  // vertices/edges, and jumps qmin (qmax) between the centroid of the FV
+  // triangle and the minimum (maximum) of the values at the auxiliary triangle
+  // vertices (which are centroids of neighbour mesh triangles), calculate a
+  // multiplicative factor phi by which the provisional vertex jumps are to be
+  // limited
+
+  int i;
+  double r=1000.0, r0=1.0, phi=1.0;
+  static double TINY = 1.0e-100; // to avoid machine accuracy problems.
+  // FIXME: Perhaps use the epsilon used elsewhere.
+
+  // Any provisional jump with magnitude < TINY does not contribute to
+  // the limiting process.
+  //return 0;
+
+  for (i=0;i<3;i++){
     if (dqv[i] < -TINY)
       r0=qmin/dqv[i];
 
@@ -1349,7 +2333,18 @@ int _extrapolate_second_order_edge_sw(struct domain *D){
   double dqv[3], qmin, qmax, hmin, hmax;
   double hc, h0, h1, h2, beta_tmp, hfactor;
   double dk, dk_inv, a_tmp, b_tmp, c_tmp,d_tmp;
-
+  long j, number_of_cells, number_of_update_cells;
+  long* cells;
+  long* update_cells;
+
+  // Cells to loop over (all of them unless active cell compaction is
+  // on), and for the extrapolation only those with a flux due
+  cells = _get_extrapolation_cells(D, &number_of_cells);
+  update_cells = _get_flux_update_cells(D, &number_of_update_cells);
+  if (cells) {
+    update_cells = cells;
+    number_of_update_cells = number_of_cells;
+  }
 
   memset((char*) D->x_centroid_work, 0, D->number_of_elements * sizeof (double));
   memset((char*) D->y_centroid_work, 0, D->number_of_elements * sizeof (double));
@@ -1365,7 +2360,8 @@ int _extrapolate_second_order_edge_sw(struct domain *D){
 
       // Replace momentum centroid with velocity centroid to allow velocity
       // extrapolation This will be changed back at the end of the routine
-      for (k=0; k< D->number_of_elements; k++){
+      for (j=0; j< number_of_cells; j++){
+          k = cells ? cells[j] : j;
 
           D->height_centroid_values[k] = fmax(D->stage_centroid_values[k] - D->bed_centroid_values[k], 0.);
 
@@ -1391,7 +2387,8 @@ int _extrapolate_second_order_edge_sw(struct domain *D){
   // condition) set its momentum to zero too. This prevents 'pits' of
   // of water being trapped and unable to lose momentum, which can occur in
   // some situations
-  for (k=0; k< D->number_of_elements;k++){
+  for (j=0; j< number_of_cells;j++){
+      k = cells ? cells[j] : j;
 
       k3=k*3;
       k0 = D->surrogate_neighbours[k3];
@@ -1412,8 +2409,9 @@ int _extrapolate_second_order_edge_sw(struct domain *D){
   }
 
   // Begin extrapolation routine
-  for (k = 0; k < D->number_of_elements; k++)
+  for (j = 0; j < number_of_update_cells; j++)
   {
+    k = update_cells ? update_cells[j] : j;
 
     // Don't update the extrapolation if the flux will not be computed on the
     // next timestep
@@ -1970,13 +2968,18 @@ int _extrapolate_second_order_edge_sw(struct domain *D){
   } // for k=0 to number_of_elements-1
 
 
-  // Compute vertex values of quantities
-  for (k=0; k< D->number_of_elements; k++){
-      if(D->extrapolate_velocity_second_order==1){
-          //Convert velocity back to momenta at centroids
+  if(D->extrapolate_velocity_second_order==1){
+      //Convert velocity back to momenta at centroids
+      for (j=0; j< number_of_cells; j++){
+          k = cells ? cells[j] : j;
           D->xmom_centroid_values[k] = D->x_centroid_work[k];
           D->ymom_centroid_values[k] = D->y_centroid_work[k];
       }
+  }
+
+  // Compute vertex values of quantities
+  for (j=0; j< number_of_update_cells; j++){
+      k = update_cells ? update_cells[j] : j;
 
       // Don't proceed if we didn't update the edge/vertex values
       if(D->update_extrapolation[k]==0){
@@ -1985,15 +2988,14 @@ int _extrapolate_second_order_edge_sw(struct domain *D){
 
       k3=3*k;
 
-      // Compute stage vertex values
-      D->stage_vertex_values[k3] = D->stage_edge_values[k3+1] + D->stage_edge_values[k3+2] - D->stage_edge_values[k3] ;
-      D->stage_vertex_values[k3+1] =  D->stage_edge_values[k3] + D->stage_edge_values[k3+2]- D->stage_edge_values[k3+1];
-      D->stage_vertex_values[k3+2] =  D->stage_edge_values[k3] + D->stage_edge_values[k3+1]- D->stage_edge_values[k3+2];
-
-      // Compute height vertex values
-      D->height_vertex_values[k3] = D->height_edge_values[k3+1] + D->height_edge_values[k3+2] - D->height_edge_values[k3] ;
-      D->height_vertex_values[k3+1] =  D->height_edge_values[k3] + D->height_edge_values[k3+2]- D->height_edge_values[k3+1];
-      D->height_vertex_values[k3+2] =  D->height_edge_values[k3] + D->height_edge_values[k3+1]- D->height_edge_values[k3+2];
+      // Compute stage and height vertex values, unless left to
+      // _compute_vertex_values
+      if (!D->lazy_vertex_values) {
+        _store_vertex_values(D->stage_vertex_values, D->stage_vertex_values_single, k3,
+                             D->stage_edge_values[k3], D->stage_edge_values[k3+1], D->stage_edge_values[k3+2]);
+        _store_vertex_values(D->height_vertex_values, D->height_vertex_values_single, k3,
+                             D->height_edge_values[k3], D->height_edge_values[k3+1], D->height_edge_values[k3+2]);
+      }
 
       // If needed, convert from velocity to momenta
       if(D->extrapolate_velocity_second_order==1){
@@ -2005,12 +3007,12 @@ int _extrapolate_second_order_edge_sw(struct domain *D){
           }
       }
       // Compute momenta at vertices
-      D->xmom_vertex_values[k3]   =  D->xmom_edge_values[k3+1] + D->xmom_edge_values[k3+2] - D->xmom_edge_values[k3] ;
-      D->xmom_vertex_values[k3+1] =  D->xmom_edge_values[k3] + D->xmom_edge_values[k3+2]- D->xmom_edge_values[k3+1];
-      D->xmom_vertex_values[k3+2] =  D->xmom_edge_values[k3] + D->xmom_edge_values[k3+1]- D->xmom_edge_values[k3+2];
-      D->ymom_vertex_values[k3]   =  D->ymom_edge_values[k3+1] + D->ymom_edge_values[k3+2] - D->ymom_edge_values[k3] ;
-      D->ymom_vertex_values[k3+1] =  D->ymom_edge_values[k3] + D->ymom_edge_values[k3+2]- D->ymom_edge_values[k3+1];
-      D->ymom_vertex_values[k3+2] =  D->ymom_edge_values[k3] + D->ymom_edge_values[k3+1]- D->ymom_edge_values[k3+2];
+      if (!D->lazy_vertex_values) {
+        _store_vertex_values(D->xmom_vertex_values, D->xmom_vertex_values_single, k3,
+                             D->xmom_edge_values[k3], D->xmom_edge_values[k3+1], D->xmom_edge_values[k3+2]);
+        _store_vertex_values(D->ymom_vertex_values, D->ymom_vertex_values_single, k3,
+                             D->ymom_edge_values[k3], D->ymom_edge_values[k3+1], D->ymom_edge_values[k3+2]);
+      }
 
       // Compute new bed elevation
       D->bed_edge_values[k3]= D->stage_edge_values[k3]- D->height_edge_values[k3];
@@ -2023,3 +3025,698 @@ int _extrapolate_second_order_edge_sw(struct domain *D){
 
   return 0;
 }
+
+
+// Limited edge values of one quantity on triangle k, with centroid values
+// qc, from the gradient over the auxiliary triangle formed by the centroids
+// of k0, k1 and k2 (number_of_boundaries <= 1 in
+// _extrapolate_second_order_edge_sw, same operations in the same order)
+static inline void _limited_edge_values_auxiliary(double* qc, long k,
+        long k0, long k1, long k2, double dx1, double dx2, double dy1,
+        double dy2, double inv_area2, double* dxv, double* dyv,
+        double beta, double* qe){
+
+  double a, b, dq0, dq1, dq2, qmin, qmax, dqv[3];
+
+  if (beta > 0.) {
+    dq0 = qc[k0] - qc[k];
+    dq1 = qc[k1] - qc[k0];
+    dq2 = qc[k2] - qc[k0];
+
+    a = dy2*dq1 - dy1*dq2;
+    a *= inv_area2;
+    b = dx1*dq2 - dx2*dq1;
+    b *= inv_area2;
+
+    dqv[0] = a*dxv[0] + b*dyv[0];
+    dqv[1] = a*dxv[1] + b*dyv[1];
+    dqv[2] = a*dxv[2] + b*dyv[2];
+
+    find_qmin_and_qmax(dq0, dq1, dq2, &qmin, &qmax);
+    limit_gradient(dqv, qmin, qmax, beta);
+
+    qe[0] = qc[k] + dqv[0];
+    qe[1] = qc[k] + dqv[1];
+    qe[2] = qc[k] + dqv[2];
+  } else {
+    qe[0] = qc[k];
+    qe[1] = qc[k];
+    qe[2] = qc[k];
+  }
+}
+
+// Limited edge values of one quantity on triangle k from the gradient
+// towards its only internal neighbour k1 (number_of_boundaries == 2),
+// where (dx2, dy2) is the offset to k1 divided by its squared length
+static inline void _limited_edge_values_neighbour(double* qc, long k, long k1,
+        double dx2, double dy2, double* dxv, double* dyv, double beta,
+        double* qe){
+
+  double a, b, dq1, qmin, qmax, dqv[3];
+
+  dq1 = qc[k1] - qc[k];
+
+  a = dq1*dx2;
+  b = dq1*dy2;
+
+  dqv[0] = a*dxv[0] + b*dyv[0];
+  dqv[1] = a*dxv[1] + b*dyv[1];
+  dqv[2] = a*dxv[2] + b*dyv[2];
+
+  if (dq1 >= 0.0) {
+    qmin = 0.0;
+    qmax = dq1;
+  } else {
+    qmin = dq1;
+    qmax = 0.0;
+  }
+
+  limit_gradient(dqv, qmin, qmax, beta);
+
+  qe[0] = qc[k] + dqv[0];
+  qe[1] = qc[k] + dqv[1];
+  qe[2] = qc[k] + dqv[2];
+}
+
+// Fused, threaded version of _extrapolate_second_order_edge_sw
+//
+// The serial kernel makes five passes: centroid momenta to velocities,
+// zeroing cells surrounded by dry cells, the limited extrapolation,
+// velocities back to momenta and the vertex values. Here the first two
+// are one pass, and the last three are another in which the edge values
+// of each triangle are kept in local variables until its vertex, momentum
+// and bed values are written. The centroid velocities go to
+// x_centroid_work and y_centroid_work and the centroid momenta are zeroed
+// in place where the serial kernel would restore zero, so there is no
+// restore pass. The passes are separated by the barriers needed for the
+// neighbour values, and give results identical to the serial kernel for
+// any number of threads.
+//
+// The three passes are made over the given lists of cells (all cells if
+// a list is NULL), so that the extrapolation can be split between cells
+// whose neighbours' values are available and the others (see
+// ghost_exchange_overlap in shallow_water_domain.py). The velocity pass
+// of a cell needs the height pass of its neighbours, and the extrapolation
+// pass needs the velocity pass of its neighbours.
+int _openmp_extrapolate_second_order_edge_sw_cells(struct domain *D,
+        long number_of_height_cells, long* height_cells,
+        long number_of_velocity_cells, long* velocity_cells,
+        long number_of_update_cells, long* update_cells){
+
+  long j;
+  double* uc;
+  double* vc;
+  double a_tmp, b_tmp, c_tmp, d_tmp, minimum_allowed_height;
+  long velocity_extrapolation, error = 0;
+
+  // Parameters used to control how the limiter is forced to first-order near
+  // wet-dry regions (see _extrapolate_second_order_edge_sw)
+  a_tmp = 0.3;
+  b_tmp = 0.1;
+  c_tmp = 1.0/(a_tmp-b_tmp);
+  d_tmp = 1.0-(c_tmp*a_tmp);
+
+  minimum_allowed_height = D->minimum_allowed_height;
+  velocity_extrapolation = (D->extrapolate_velocity_second_order == 1);
+
+  // Centroid values the momentum edge values are extrapolated from
+  if (velocity_extrapolation) {
+    uc = D->x_centroid_work;
+    vc = D->y_centroid_work;
+  } else {
+    uc = D->xmom_centroid_values;
+    vc = D->ymom_centroid_values;
+  }
+
+  #pragma omp parallel private(j) if(D->multiprocessor_mode == 1)
+  {
+    if (velocity_extrapolation) {
+      #pragma omp for schedule(static)
+      for (j = 0; j < number_of_height_cells; j++) {
+        long k = height_cells ? height_cells[j] : j;
+        D->height_centroid_values[k] = fmax(D->stage_centroid_values[k] - D->bed_centroid_values[k], 0.);
+      }
+    }
+
+    // Centroid velocities, zero in dry cells and in cells surrounded by
+    // dry cells (or dry cells + boundary condition), whose momentum is
+    // zeroed too
+    #pragma omp for schedule(static)
+    for (j = 0; j < number_of_velocity_cells; j++) {
+      long k, k0, k1, k2;
+      double dk, dk_inv;
+      int surrounded_by_dry_cells;
+
+      k = velocity_cells ? velocity_cells[j] : j;
+
+      k0 = D->surrogate_neighbours[3*k];
+      k1 = D->surrogate_neighbours[3*k + 1];
+      k2 = D->surrogate_neighbours[3*k + 2];
+
+      surrounded_by_dry_cells =
+         ( (D->height_centroid_values[k0] < minimum_allowed_height) | (k0==k) ) &
+         ( (D->height_centroid_values[k1] < minimum_allowed_height) | (k1==k) ) &
+         ( (D->height_centroid_values[k2] < minimum_allowed_height) | (k2==k) );
+
+      if (velocity_extrapolation) {
+        dk = D->height_centroid_values[k];
+        if (dk > minimum_allowed_height && !surrounded_by_dry_cells) {
+          dk_inv = 1.0/dk;
+          uc[k] = D->xmom_centroid_values[k]*dk_inv;
+          vc[k] = D->ymom_centroid_values[k]*dk_inv;
+        } else {
+          uc[k] = 0.;
+          vc[k] = 0.;
+          D->xmom_centroid_values[k] = 0.;
+          D->ymom_centroid_values[k] = 0.;
+        }
+      } else if (surrounded_by_dry_cells) {
+        D->xmom_centroid_values[k] = 0.;
+        D->ymom_centroid_values[k] = 0.;
+      }
+    }
+
+    // Extrapolation and vertex values
+    #pragma omp for schedule(static) reduction(max:error)
+    for (j = 0; j < number_of_update_cells; j++) {
+      long k, k0, k1, k2, k3, k6, i;
+      double x, y, x0, y0, x1, y1, x2, y2;
+      double dx1, dx2, dy1, dy2, area2, inv_area2, dxv[3], dyv[3];
+      double hc, h0, h1, h2, hmin, hmax, hfactor, beta;
+      double we[3], he[3], ue[3], ve[3], ze[3];
+
+      k = update_cells ? update_cells[j] : j;
+
+      // Don't update the extrapolation if the flux will not be computed
+      // on the next timestep
+      if (D->update_extrapolation[k] == 0) {
+        continue;
+      }
+
+      k3 = 3*k;
+      k6 = 6*k;
+
+      if (D->number_of_boundaries[k] == 3) {
+        // No neighbours, set gradient on the triangle to zero
+        for (i = 0; i < 3; i++) {
+          we[i] = D->stage_centroid_values[k];
+          ue[i] = uc[k];
+          ve[i] = vc[k];
+          he[i] = D->height_centroid_values[k];
+        }
+      } else {
+        // Edge coordinates relative to the centroid
+        x = D->centroid_coordinates[2*k];
+        y = D->centroid_coordinates[2*k + 1];
+        for (i = 0; i < 3; i++) {
+          dxv[i] = D->edge_coordinates[k6 + 2*i] - x;
+          dyv[i] = D->edge_coordinates[k6 + 2*i + 1] - y;
+        }
+
+        if (D->number_of_boundaries[k] <= 1) {
+          // Auxiliary triangle formed by the centroids of the neighbours
+          k0 = D->surrogate_neighbours[k3];
+          k1 = D->surrogate_neighbours[k3 + 1];
+          k2 = D->surrogate_neighbours[k3 + 2];
+
+          x0 = D->centroid_coordinates[2*k0];
+          y0 = D->centroid_coordinates[2*k0 + 1];
+          x1 = D->centroid_coordinates[2*k1];
+          y1 = D->centroid_coordinates[2*k1 + 1];
+          x2 = D->centroid_coordinates[2*k2];
+          y2 = D->centroid_coordinates[2*k2 + 1];
+
+          dx1 = x1 - x0;
+          dx2 = x2 - x0;
+          dy1 = y1 - y0;
+          dy2 = y2 - y0;
+
+          area2 = dy2*dx1 - dy1*dx2;
+
+          if (area2 <= 0.) {
+            // Isolated wet cell -- constant extrapolation
+            for (i = 0; i < 3; i++) {
+              we[i] = D->stage_centroid_values[k];
+              he[i] = D->height_centroid_values[k];
+              ue[i] = uc[k];
+              ve[i] = vc[k];
+            }
+          } else {
+            hc = D->height_centroid_values[k];
+            h0 = D->height_centroid_values[k0];
+            h1 = D->height_centroid_values[k1];
+            h2 = D->height_centroid_values[k2];
+
+            hmin = fmin(fmin(h0, fmin(h1, h2)), hc);
+            hmax = fmax(fmax(h0, fmax(h1, h2)), hc);
+
+            hfactor= fmax(0., fmin(c_tmp*fmax(hmin,0.0)/fmax(hc,1.0e-06)+d_tmp,
+                                 fmin(c_tmp*fmax(hc,0.)/fmax(hmax,1.0e-06)+d_tmp, 1.0))
+                        );
+            hfactor=fmin( 1.2*fmax(hmin- minimum_allowed_height,0.)/(fmax(hmin,0.)+1.* minimum_allowed_height), hfactor);
+
+            inv_area2 = 1.0/area2;
+
+            // Stage and height share the limiter coefficient
+            beta = D->beta_w_dry + (D->beta_w - D->beta_w_dry) * hfactor;
+            _limited_edge_values_auxiliary(D->stage_centroid_values, k, k0, k1, k2,
+                    dx1, dx2, dy1, dy2, inv_area2, dxv, dyv, beta, we);
+            _limited_edge_values_auxiliary(D->height_centroid_values, k, k0, k1, k2,
+                    dx1, dx2, dy1, dy2, inv_area2, dxv, dyv, beta, he);
+
+            beta = D->beta_uh_dry + (D->beta_uh - D->beta_uh_dry) * hfactor;
+            _limited_edge_values_auxiliary(uc, k, k0, k1, k2,
+                    dx1, dx2, dy1, dy2, inv_area2, dxv, dyv, beta, ue);
+
+            beta = D->beta_vh_dry + (D->beta_vh - D->beta_vh_dry) * hfactor;
+            _limited_edge_values_auxiliary(vc, k, k0, k1, k2,
+                    dx1, dx2, dy1, dy2, inv_area2, dxv, dyv, beta, ve);
+          }
+        } else {
+          // One internal neighbour, gradient in the direction of its centroid
+          for (k2 = k3; k2 < k3 + 3; k2++) {
+            if (D->surrogate_neighbours[k2] != k) {
+              break;
+            }
+          }
+
+          if (k2 == k3 + 3) {
+            // Internal neighbour not found, leave the triangle as it is
+            error = 1;
+            continue;
+          }
+
+          k1 = D->surrogate_neighbours[k2];
+
+          dx1 = D->centroid_coordinates[2*k1] - x;
+          dy1 = D->centroid_coordinates[2*k1 + 1] - y;
+
+          area2 = dx1*dx1 + dy1*dy1;
+
+          dx2 = 1.0/area2;
+          dy2 = dx2*dy1;
+          dx2 *= dx1;
+
+          _limited_edge_values_neighbour(D->stage_centroid_values, k, k1,
+                  dx2, dy2, dxv, dyv, D->beta_w, we);
+          _limited_edge_values_neighbour(D->height_centroid_values, k, k1,
+                  dx2, dy2, dxv, dyv, D->beta_w, he);
+          _limited_edge_values_neighbour(uc, k, k1,
+                  dx2, dy2, dxv, dyv, D->beta_w, ue);
+          _limited_edge_values_neighbour(vc, k, k1,
+                  dx2, dy2, dxv, dyv, D->beta_w, ve);
+        }
+      }
+
+      // Velocities back to momenta at the edges
+      if (velocity_extrapolation) {
+        for (i = 0; i < 3; i++) {
+          ue[i] = ue[i]*he[i];
+          ve[i] = ve[i]*he[i];
+        }
+      }
+
+      for (i = 0; i < 3; i++) {
+        ze[i] = we[i] - he[i];
+      }
+
+      for (i = 0; i < 3; i++) {
+        D->stage_edge_values[k3 + i] = we[i];
+        D->height_edge_values[k3 + i] = he[i];
+        D->xmom_edge_values[k3 + i] = ue[i];
+        D->ymom_edge_values[k3 + i] = ve[i];
+        D->bed_edge_values[k3 + i] = ze[i];
+      }
+
+      // Vertex values from the edge values
+      if (!D->lazy_vertex_values) {
+        _store_vertex_values(D->stage_vertex_values, D->stage_vertex_values_single, k3, we[0], we[1], we[2]);
+        _store_vertex_values(D->height_vertex_values, D->height_vertex_values_single, k3, he[0], he[1], he[2]);
+        _store_vertex_values(D->xmom_vertex_values, D->xmom_vertex_values_single, k3, ue[0], ue[1], ue[2]);
+        _store_vertex_values(D->ymom_vertex_values, D->ymom_vertex_values_single, k3, ve[0], ve[1], ve[2]);
+      }
+
+      D->bed_vertex_values[k3]   = ze[1] + ze[2] - ze[0];
+      D->bed_vertex_values[k3+1] = ze[0] + ze[2] - ze[1];
+      D->bed_vertex_values[k3+2] = ze[0] + ze[1] - ze[2];
+    }
+  }
+
+  return error ? -1 : 0;
+}
+
+int _openmp_extrapolate_second_order_edge_sw(struct domain *D){
+
+  long number_of_cells, number_of_update_cells;
+  long* cells;
+  long* update_cells;
+
+  // Cells to loop over (all of them unless active cell compaction is
+  // on), and for the extrapolation only those with a flux due
+  cells = _get_extrapolation_cells(D, &number_of_cells);
+  update_cells = _get_flux_update_cells(D, &number_of_update_cells);
+  if (cells) {
+    update_cells = cells;
+    number_of_update_cells = number_of_cells;
+  }
+
+  // Cells left out by active cell compaction are seen with their
+  // momenta by their neighbours, as in the serial kernel
+  if (cells && D->extrapolate_velocity_second_order == 1) {
+    memcpy(D->x_centroid_work, D->xmom_centroid_values, D->number_of_elements * sizeof (double));
+    memcpy(D->y_centroid_work, D->ymom_centroid_values, D->number_of_elements * sizeof (double));
+  }
+
+  return _openmp_extrapolate_second_order_edge_sw_cells(D,
+          number_of_cells, cells, number_of_cells, cells,
+          number_of_update_cells, update_cells);
+}
+
+
+// Compute the vertex values of stage, height and the momenta from their
+// edge values, as the extrapolation does unless D->lazy_vertex_values.
+// The bed vertex values are always computed by the extrapolation.
+int _compute_vertex_values(struct domain *D){
+
+  long k, k3;
+
+  #pragma omp parallel for private(k3) schedule(static) if(D->multiprocessor_mode == 1)
+  for (k = 0; k < D->number_of_elements; k++){
+    k3 = 3*k;
+    _store_vertex_values(D->stage_vertex_values, D->stage_vertex_values_single, k3,
+                         D->stage_edge_values[k3], D->stage_edge_values[k3+1], D->stage_edge_values[k3+2]);
+    _store_vertex_values(D->height_vertex_values, D->height_vertex_values_single, k3,
+                         D->height_edge_values[k3], D->height_edge_values[k3+1], D->height_edge_values[k3+2]);
+    _store_vertex_values(D->xmom_vertex_values, D->xmom_vertex_values_single, k3,
+                         D->xmom_edge_values[k3], D->xmom_edge_values[k3+1], D->xmom_edge_values[k3+2]);
+    _store_vertex_values(D->ymom_vertex_values, D->ymom_vertex_values_single, k3,
+                         D->ymom_edge_values[k3], D->ymom_edge_values[k3+1], D->ymom_edge_values[k3+2]);
+  }
+
+  return 0;
+}
+
+
+// Operations of the DE timestepping loop other than the flux computation
+// and extrapolation, so that evolve_to_yieldstep in swDE1_domain_ext.pyx
+// can run whole timesteps without returning to python. Each reproduces
+// the quantity_ext.c or shallow_water.c kernel used by the python loop.
+
+int _backup_conserved_quantities(struct domain *D){
+
+  long k;
+  long N = D->number_of_elements;
+
+  for (k = 0; k < N; k++){
+    D->stage_centroid_backup_values[k] = D->stage_centroid_values[k];
+    D->xmom_centroid_backup_values[k] = D->xmom_centroid_values[k];
+    D->ymom_centroid_backup_values[k] = D->ymom_centroid_values[k];
+  }
+
+  return 0;
+}
+
+int _saxpy_conserved_quantities(struct domain *D, double a, double b, double c){
+  // centroid_values = (a*centroid_values + b*centroid_backup_values)/c
+
+  long k;
+  long N = D->number_of_elements;
+
+  for (k = 0; k < N; k++){
+    D->stage_centroid_values[k] = (a*D->stage_centroid_values[k] + b*D->stage_centroid_backup_values[k])/c;
+    D->xmom_centroid_values[k] = (a*D->xmom_centroid_values[k] + b*D->xmom_centroid_backup_values[k])/c;
+    D->ymom_centroid_values[k] = (a*D->ymom_centroid_values[k] + b*D->ymom_centroid_backup_values[k])/c;
+  }
+
+  return 0;
+}
+
+static inline int _update_quantity(long N, double timestep,
+                                   double* centroid_values,
+                                   double* explicit_update,
+                                   double* semi_implicit_update){
+  // As _update in quantity.c
+
+  long k;
+  double denominator, x;
+
+  for (k = 0; k < N; k++){
+    x = centroid_values[k];
+    if (x == 0.0){
+      semi_implicit_update[k] = 0.0;
+    } else {
+      semi_implicit_update[k] /= x;
+    }
+  }
+
+  for (k = 0; k < N; k++){
+    centroid_values[k] += timestep*explicit_update[k];
+  }
+
+  for (k = 0; k < N; k++){
+    denominator = 1.0 - timestep*semi_implicit_update[k];
+    if (denominator <= 0.0){
+      return -1;
+    } else {
+      centroid_values[k] /= denominator;
+    }
+  }
+
+  memset(semi_implicit_update, 0, N*sizeof(double));
+
+  return 0;
+}
+
+long _update_conserved_quantities(struct domain *D, double timestep){
+  // Returns the number of full cells which were set to zero depth
+  // because they became negative, or -1 if the semi implicit update
+  // failed
+
+  long k;
+  long N = D->number_of_elements;
+  long number_of_negative_cells = 0;
+
+  if (_update_quantity(N, timestep, D->stage_centroid_values,
+                       D->stage_explicit_update, D->stage_semi_implicit_update) < 0) return -1;
+  if (_update_quantity(N, timestep, D->xmom_centroid_values,
+                       D->xmom_explicit_update, D->xmom_semi_implicit_update) < 0) return -1;
+  if (_update_quantity(N, timestep, D->ymom_centroid_values,
+                       D->ymom_explicit_update, D->ymom_semi_implicit_update) < 0) return -1;
+
+  for (k = 0; k < N; k++){
+    if ((D->stage_centroid_values[k] - D->bed_centroid_values[k]) < 0.0 && D->tri_full_flag[k] > 0){
+      D->stage_centroid_values[k] = D->bed_centroid_values[k];
+      D->xmom_centroid_values[k] = 0.0;
+      D->ymom_centroid_values[k] = 0.0;
+      number_of_negative_cells++;
+    }
+  }
+
+  return number_of_negative_cells;
+}
+
+int _manning_friction(struct domain *D){
+  // Semi implicit (Manning) friction, as manning_friction_implicit with
+  // _manning_friction_flat or _manning_friction_sloped
+
+  long k, k3, k6;
+  double S, h, z, z0, z1, z2, zs, zx, zy, det;
+  double x0, y0, x1, y1, x2, y2;
+  const double one_third = 1.0/3.0;
+  const double seven_thirds = 7.0/3.0;
+
+  double g = D->g;
+  double eps = D->minimum_allowed_height;
+  double *w = D->stage_centroid_values;
+  double *uh = D->xmom_centroid_values;
+  double *vh = D->ymom_centroid_values;
+  double *zv = D->bed_vertex_values;
+  double *eta = D->friction_centroid_values;
+  double *x = D->vertex_coordinates;
+
+  for (k = 0; k < D->number_of_elements; k++){
+    if (eta[k] > eps){
+      k3 = 3*k;
+      // Get bathymetry
+      z0 = zv[k3 + 0];
+      z1 = zv[k3 + 1];
+      z2 = zv[k3 + 2];
+
+      if (D->use_sloped_mannings){
+        // Compute bed slope, as _gradient in util_ext.h
+        k6 = 6*k;
+
+        x0 = x[k6 + 0];
+        y0 = x[k6 + 1];
+        x1 = x[k6 + 2];
+        y1 = x[k6 + 3];
+        x2 = x[k6 + 4];
+        y2 = x[k6 + 5];
+
+        det = (y2-y0)*(x1-x0) - (y1-y0)*(x2-x0);
+
+        zx = (y2-y0)*(z1-z0) - (y1-y0)*(z2-z0);
+        zx /= det;
+
+        zy = (x1-x0)*(z2-z0) - (x2-x0)*(z1-z0);
+        zy /= det;
+
+        zs = sqrt(1.0 + zx*zx + zy*zy);
+      }
+
+      z = (z0 + z1 + z2)*one_third;
+      h = w[k] - z;
+      if (h >= eps){
+        if (D->use_sloped_mannings){
+          S = -g*eta[k]*eta[k]*zs*sqrt((uh[k]*uh[k] + vh[k]*vh[k]));
+        } else {
+          S = -g*eta[k]*eta[k]*sqrt((uh[k]*uh[k] + vh[k]*vh[k]));
+        }
+        S /= pow(h, seven_thirds);
+
+        //Update momentum
+        D->xmom_semi_implicit_update[k] += S*uh[k];
+        D->ymom_semi_implicit_update[k] += S*vh[k];
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+// Boundary conditions evaluated from precomputed index arrays, see
+// Domain.update_boundary. Entry j of the arrays describes boundary edge
+// ids[j] (an index into the boundary_values arrays), which is edge
+// edges[j] = 3*vol_id + edge_id of the mesh. values holds three numbers
+// per slot, refreshed once per call by the python side. Each type
+// reproduces the evaluate_segment method of the python boundary class.
+#define BOUNDARY_REFLECTIVE 0
+#define BOUNDARY_DIRICHLET 1
+#define BOUNDARY_TRANSMISSIVE 2
+#define BOUNDARY_FLATHER 3
+
+int _evaluate_boundaries(struct domain *D, long number_of_edges,
+                         long *ids, long *edges, long *types, long *slots,
+                         double *values, double g, long centroid_transmissive_bc){
+
+  long j, i, ki, k;
+  double n1, n2, q1, q2, r1, r2;
+  double stage_outside, bed, depth_inside, sqrt_g_on_depth_inside;
+  double ndotq_inside, w1, w2, w3, qperp, qpar;
+  double q0_dry, q1_dry, q2_dry, q0_wet, q1_wet, q2_wet;
+  double *v;
+
+  for (j = 0; j < number_of_edges; j++){
+    i = ids[j];
+    ki = edges[j];
+    k = ki/3;
+
+    switch (types[j]){
+
+    case BOUNDARY_REFLECTIVE:
+      n1 = D->normals[2*ki];
+      n2 = D->normals[2*ki + 1];
+
+      D->stage_boundary_values[i] = D->stage_edge_values[ki];
+      D->bed_boundary_values[i] = D->bed_edge_values[ki];
+      D->height_boundary_values[i] = D->height_edge_values[ki];
+
+      // Rotate and negate momentum
+      q1 = D->xmom_edge_values[ki];
+      q2 = D->ymom_edge_values[ki];
+
+      r1 = -q1*n1 - q2*n2;
+      r2 = -q1*n2 + q2*n1;
+
+      D->xmom_boundary_values[i] = n1*r1 - n2*r2;
+      D->ymom_boundary_values[i] = n2*r1 + n1*r2;
+
+      // Rotate and negate velocity
+      if (D->xvel_edge_values != NULL && D->yvel_edge_values != NULL){
+        q1 = D->xvel_edge_values[ki];
+        q2 = D->yvel_edge_values[ki];
+
+        r1 = q1*n1 + q2*n2;
+        r2 = q1*n2 - q2*n1;
+
+        D->xvel_boundary_values[i] = n1*r1 - n2*r2;
+        D->yvel_boundary_values[i] = n2*r1 + n1*r2;
+      }
+      break;
+
+    case BOUNDARY_DIRICHLET:
+      v = values + 3*slots[j];
+
+      D->stage_boundary_values[i] = v[0];
+      D->xmom_boundary_values[i] = v[1];
+      D->ymom_boundary_values[i] = v[2];
+      break;
+
+    case BOUNDARY_TRANSMISSIVE:
+      if (centroid_transmissive_bc){
+        D->stage_boundary_values[i] = D->stage_centroid_values[k];
+        D->xmom_boundary_values[i] = D->xmom_centroid_values[k];
+        D->ymom_boundary_values[i] = D->ymom_centroid_values[k];
+      } else {
+        D->stage_boundary_values[i] = D->stage_edge_values[ki];
+        D->xmom_boundary_values[i] = D->xmom_edge_values[ki];
+        D->ymom_boundary_values[i] = D->ymom_edge_values[ki];
+      }
+      break;
+
+    case BOUNDARY_FLATHER:
+      // Flather type boundary with external stage and zero external
+      // velocity, assuming subcritical flow
+      stage_outside = values[3*slots[j]];
+
+      n1 = D->normals[2*ki];
+      n2 = D->normals[2*ki + 1];
+
+      D->stage_boundary_values[i] = D->stage_edge_values[ki];
+      D->xmom_boundary_values[i] = D->xmom_edge_values[ki];
+      D->ymom_boundary_values[i] = D->ymom_edge_values[ki];
+      D->bed_boundary_values[i] = D->bed_edge_values[ki];
+
+      bed = D->bed_centroid_values[k];
+      depth_inside = fmax(D->stage_boundary_values[i] - bed, 0.0);
+
+      q0_dry = (bed <= stage_outside) ? stage_outside : D->bed_boundary_values[i];
+      q1_dry = 0.0*D->xmom_boundary_values[i];
+      q2_dry = 0.0*D->ymom_boundary_values[i];
+
+      // Not finite in dry cells, but then not used
+      sqrt_g_on_depth_inside = sqrt(g/depth_inside);
+      ndotq_inside = n1*D->xmom_boundary_values[i] + n2*D->ymom_boundary_values[i];
+
+      w1 = 0.0 - sqrt_g_on_depth_inside*stage_outside;
+      if (ndotq_inside > 0.0){
+        w2 = (n2*D->xmom_boundary_values[i] - n1*D->ymom_boundary_values[i])/depth_inside;
+      } else {
+        w2 = 0.0*ndotq_inside;
+      }
+      w3 = ndotq_inside/depth_inside + sqrt_g_on_depth_inside*D->stage_boundary_values[i];
+
+      q0_wet = (w3 - w1)/(2.0*sqrt_g_on_depth_inside);
+
+      qperp = (w3 + w1)/2.0*depth_inside;
+      qpar = w2*depth_inside;
+
+      q1_wet = qperp*n1 + qpar*n2;
+      q2_wet = qperp*n2 - qpar*n1;
+
+      if (depth_inside == 0.0 || stage_outside > bed){
+        D->stage_boundary_values[i] = q0_dry;
+        D->xmom_boundary_values[i] = q1_dry;
+        D->ymom_boundary_values[i] = q2_dry;
+      } else {
+        D->stage_boundary_values[i] = q0_wet;
+        D->xmom_boundary_values[i] = q1_wet;
+        D->ymom_boundary_values[i] = q2_wet;
+      }
+      break;
+    }
+  }
+
+  return 0;
+}
@@ -26,6 +26,13 @@ cdef extern from "swDE1_domain.c" nogil:
 		double beta_vh_dry
 		long max_flux_update_frequency
 		long ncol_riverwall_hydraulic_properties
+		long number_of_boundary_flux_edges
+		long number_of_unique_edges
+		long multiprocessor_mode
+		long simd_fluxes
+		long use_sloped_mannings
+		long active_cell_compaction
+		long lazy_vertex_values
 		long* neighbours
 		long* neighbour_edges
 		long* surrogate_neighbours
@@ -56,34 +63,88 @@ cdef extern from "swDE1_domain.c" nogil:
 		double* ymom_vertex_values
 		double* bed_vertex_values
 		double* height_vertex_values
+		float* stage_vertex_values_single
+		float* xmom_vertex_values_single
+		float* ymom_vertex_values_single
+		float* height_vertex_values_single
 		double* stage_boundary_values
 		double* xmom_boundary_values
 		double* ymom_boundary_values
 		double* bed_boundary_values
+		double* height_boundary_values
 		double* stage_explicit_update
 		double* xmom_explicit_update
 		double* ymom_explicit_update
+		double* stage_semi_implicit_update
+		double* xmom_semi_implicit_update
+		double* ymom_semi_implicit_update
+		double* stage_centroid_backup_values
+		double* xmom_centroid_backup_values
+		double* ymom_centroid_backup_values
+		double* friction_centroid_values
+		double* xvel_edge_values
+		double* yvel_edge_values
+		double* xvel_boundary_values
+		double* yvel_boundary_values
 		long* flux_update_frequency
 		long* update_next_flux
 		long* update_extrapolation
+		long* triangle_flux_update_frequency
+		long* flux_update_statistics
+		long* flux_update_cells
+		long* number_of_flux_update_cells
 		double* edge_timestep
 		double* edge_flux_work
 		double* pressuregrad_work
 		double* x_centroid_work
 		double* y_centroid_work
 		double* boundary_flux_sum
+		long* boundary_flux_edges
 		long* allow_timestep_increase
+		long* flux_call
+		long* flux_base_call
+		long* flux_last_timestep_fluxcalls
+		long* flux_cyclic_number_of_steps
+		double* flux_local_timestep
+		long* active_cells
+		long* extrapolation_cells
+		long* active_cell_distance
+		long* active_cell_changed
+		long* number_of_active_cells
+		double* active_cell_state
 		double* riverwall_elevation
 		long* riverwall_rowIndex
+		long* riverwall_index
 		double* riverwall_hydraulic_properties
+		long* edge_cells
+		long* edge_half_edges
+		double* edge_normals
+		double* edge_lengths
+		long* edge_riverwall_index
+		double* edge_max_speed
 
 	struct edge:
 		pass
 
+	int _flux_function_central(double* q_left, double* q_right, double h_left, double h_right, double hle, double hre, double n1, double n2, double epsilon, double ze, double limiting_threshold, double g, double* edgeflux, double* max_speed, double* pressure_flux, double hc, double hc_n, long low_froude)
+	int _flux_function_central_batch(long nb, double* q_left, double* q_right, double* h_left, double* h_right, double* hle, double* hre, double* n1, double* n2, double epsilon, double* ze, double g, double* edgeflux, double* max_speed, double* pressure_flux, long low_froude)
 	int _compute_flux_update_frequency(domain* D, double timestep)
 	double _compute_fluxes_central(domain* D, double timestep)
+	double _openmp_compute_fluxes_central(domain* D, double timestep)
+	double _openmp_compute_fluxes_central_part(domain* D, double timestep, long number_of_flux_cells, long* flux_cells, int first, int last)
+	double _compute_fluxes_central_edges(domain* D, double timestep)
 	double _protect_new(domain* D)
+	double _protect_cells(domain* D, long number_of_cells, long* cells)
 	int _extrapolate_second_order_edge_sw(domain* D)
+	int _openmp_extrapolate_second_order_edge_sw(domain* D)
+	int _openmp_extrapolate_second_order_edge_sw_cells(domain* D, long number_of_height_cells, long* height_cells, long number_of_velocity_cells, long* velocity_cells, long number_of_update_cells, long* update_cells)
+	int _compute_vertex_values(domain* D)
+	int _set_omp_num_threads(int num_threads)
+	int _backup_conserved_quantities(domain* D)
+	int _saxpy_conserved_quantities(domain* D, double a, double b, double c)
+	long _update_conserved_quantities(domain* D, double timestep)
+	int _manning_friction(domain* D)
+	int _evaluate_boundaries(domain* D, long number_of_edges, long* ids, long* edges, long* types, long* slots, double* values, double g, long centroid_transmissive_bc)
 
 
 cdef int pointer_flag = 0
@@ -109,8 +170,29 @@ cdef inline get_python_domain_parameters(domain *D, object domain_object):
 	D.beta_vh = domain_object.beta_vh
 	D.beta_vh_dry = domain_object.beta_vh_dry
 	D.max_flux_update_frequency = domain_object.max_flux_update_frequency
+	D.multiprocessor_mode = domain_object.multiprocessor_mode
+	D.simd_fluxes = domain_object.simd_fluxes
+	D.use_sloped_mannings = domain_object.use_sloped_mannings
+	D.active_cell_compaction = domain_object.active_cell_compaction
+	D.lazy_vertex_values = domain_object.lazy_vertex_values
 		
 
+cdef inline get_vertex_values_pointers(object quantity, double** vertex_values, float** vertex_values_single):
+	# Vertex values are stored in single precision under
+	# Domain.set_vertex_output_precision('single'), the unused pointer is NULL
+
+	cdef double[:,::1] values
+	cdef float[:,::1] values_single
+
+	if quantity.vertex_values.dtype == np.float32:
+		values_single = quantity.vertex_values
+		vertex_values[0] = NULL
+		vertex_values_single[0] = &values_single[0,0]
+	else:
+		values = quantity.vertex_values
+		vertex_values[0] = &values[0,0]
+		vertex_values_single[0] = NULL
+
 cdef inline get_python_domain_pointers(domain *D, object domain_object):
 
 	cdef long[:,::1]   neighbours
@@ -131,21 +213,40 @@ cdef inline get_python_domain_pointers(domain *D, object domain_object):
 	cdef long[::1]     flux_update_frequency
 	cdef long[::1]     update_next_flux
 	cdef long[::1]     update_extrapolation
+	cdef long[::1]     triangle_flux_update_frequency
+	cdef long[::1]     flux_update_statistics
+	cdef long[::1]     flux_update_cells
+	cdef long[::1]     number_of_flux_update_cells
 	cdef long[::1]     allow_timestep_increase
+	cdef long[::1]     flux_call
+	cdef long[::1]     flux_base_call
+	cdef long[::1]     flux_last_timestep_fluxcalls
+	cdef long[::1]     flux_cyclic_number_of_steps
+	cdef double[::1]   flux_local_timestep
+	cdef long[::1]     active_cells
+	cdef long[::1]     extrapolation_cells
+	cdef long[::1]     active_cell_distance
+	cdef long[::1]     active_cell_changed
+	cdef long[::1]     number_of_active_cells
+	cdef double[:,::1] active_cell_state
 	cdef double[::1]   edge_timestep
 	cdef double[::1]   edge_flux_work
 	cdef double[::1]   pressuregrad_work
 	cdef double[::1]   x_centroid_work
 	cdef double[::1]   y_centroid_work
 	cdef double[::1]   boundary_flux_sum
+	cdef long[::1]     boundary_flux_edges
 	cdef double[::1]   riverwall_elevation
 	cdef long[::1]     riverwall_rowIndex
+	cdef long[::1]     riverwall_index
 	cdef double[:,::1] riverwall_hydraulic_properties
 	cdef double[:,::1] edge_values
 	cdef double[::1]   centroid_values
 	cdef double[:,::1] vertex_values
 	cdef double[::1]   boundary_values
 	cdef double[::1]   explicit_update
+	cdef double[::1]   semi_implicit_update
+	cdef double[::1]   centroid_backup_values
 	
 	cdef object quantities
 	cdef object riverwallData
@@ -207,9 +308,54 @@ cdef inline get_python_domain_pointers(domain *D, object domain_object):
 	update_extrapolation = domain_object.update_extrapolation
 	D.update_extrapolation = &update_extrapolation[0]
 
+	triangle_flux_update_frequency = domain_object.triangle_flux_update_frequency
+	D.triangle_flux_update_frequency = &triangle_flux_update_frequency[0]
+
+	flux_update_statistics = domain_object.flux_update_statistics
+	D.flux_update_statistics = &flux_update_statistics[0]
+
+	flux_update_cells = domain_object.flux_update_cells
+	D.flux_update_cells = &flux_update_cells[0]
+
+	number_of_flux_update_cells = domain_object.number_of_flux_update_cells
+	D.number_of_flux_update_cells = &number_of_flux_update_cells[0]
+
 	allow_timestep_increase = domain_object.allow_timestep_increase
 	D.allow_timestep_increase = &allow_timestep_increase[0]
 
+	flux_call = domain_object.flux_call
+	D.flux_call = &flux_call[0]
+
+	flux_base_call = domain_object.flux_base_call
+	D.flux_base_call = &flux_base_call[0]
+
+	flux_last_timestep_fluxcalls = domain_object.flux_last_timestep_fluxcalls
+	D.flux_last_timestep_fluxcalls = &flux_last_timestep_fluxcalls[0]
+
+	flux_cyclic_number_of_steps = domain_object.flux_cyclic_number_of_steps
+	D.flux_cyclic_number_of_steps = &flux_cyclic_number_of_steps[0]
+
+	flux_local_timestep = domain_object.flux_local_timestep
+	D.flux_local_timestep = &flux_local_timestep[0]
+
+	active_cells = domain_object.active_cells
+	D.active_cells = &active_cells[0]
+
+	extrapolation_cells = domain_object.extrapolation_cells
+	D.extrapolation_cells = &extrapolation_cells[0]
+
+	active_cell_distance = domain_object.active_cell_distance
+	D.active_cell_distance = &active_cell_distance[0]
+
+	active_cell_changed = domain_object.active_cell_changed
+	D.active_cell_changed = &active_cell_changed[0]
+
+	number_of_active_cells = domain_object.number_of_active_cells
+	D.number_of_active_cells = &number_of_active_cells[0]
+
+	active_cell_state = domain_object.active_cell_state
+	D.active_cell_state = &active_cell_state[0,0]
+
 	edge_timestep = domain_object.edge_timestep
 	D.edge_timestep = &edge_timestep[0]
 
@@ -228,6 +374,10 @@ cdef inline get_python_domain_pointers(domain *D, object domain_object):
 	boundary_flux_sum = domain_object.boundary_flux_sum
 	D.boundary_flux_sum = &boundary_flux_sum[0]
 
+	boundary_flux_edges = domain_object.boundary_flux_edges
+	D.boundary_flux_edges = &boundary_flux_edges[0]
+	D.number_of_boundary_flux_edges = boundary_flux_edges.shape[0]
+
 	#------------------------------------------------------
 	# Quantity structures
 	#------------------------------------------------------
@@ -268,21 +418,14 @@ cdef inline get_python_domain_pointers(domain *D, object domain_object):
 	centroid_values = height.centroid_values
 	D.height_centroid_values = &centroid_values[0]
 
-	vertex_values = stage.vertex_values
-	D.stage_vertex_values = &vertex_values[0,0]
-
-	vertex_values = xmomentum.vertex_values
-	D.xmom_vertex_values = &vertex_values[0,0]
-
-	vertex_values = ymomentum.vertex_values
-	D.ymom_vertex_values = &vertex_values[0,0]
+	get_vertex_values_pointers(stage, &D.stage_vertex_values, &D.stage_vertex_values_single)
+	get_vertex_values_pointers(xmomentum, &D.xmom_vertex_values, &D.xmom_vertex_values_single)
+	get_vertex_values_pointers(ymomentum, &D.ymom_vertex_values, &D.ymom_vertex_values_single)
+	get_vertex_values_pointers(height, &D.height_vertex_values, &D.height_vertex_values_single)
 
 	vertex_values = elevation.vertex_values
 	D.bed_vertex_values = &vertex_values[0,0]
 
-	vertex_values = height.vertex_values
-	D.height_vertex_values = &vertex_values[0,0]
-
 	boundary_values = stage.boundary_values
 	D.stage_boundary_values = &boundary_values[0]
 
@@ -295,6 +438,9 @@ cdef inline get_python_domain_pointers(domain *D, object domain_object):
 	boundary_values = elevation.boundary_values
 	D.bed_boundary_values = &boundary_values[0]
 
+	boundary_values = height.boundary_values
+	D.height_boundary_values = &boundary_values[0]
+
 	explicit_update = stage.explicit_update
 	D.stage_explicit_update = &explicit_update[0]
 
@@ -304,6 +450,48 @@ cdef inline get_python_domain_pointers(domain *D, object domain_object):
 	explicit_update = ymomentum.explicit_update
 	D.ymom_explicit_update = &explicit_update[0]
 
+	semi_implicit_update = stage.semi_implicit_update
+	D.stage_semi_implicit_update = &semi_implicit_update[0]
+
+	semi_implicit_update = xmomentum.semi_implicit_update
+	D.xmom_semi_implicit_update = &semi_implicit_update[0]
+
+	semi_implicit_update = ymomentum.semi_implicit_update
+	D.ymom_semi_implicit_update = &semi_implicit_update[0]
+
+	centroid_backup_values = stage.centroid_backup_values
+	D.stage_centroid_backup_values = &centroid_backup_values[0]
+
+	centroid_backup_values = xmomentum.centroid_backup_values
+	D.xmom_centroid_backup_values = &centroid_backup_values[0]
+
+	centroid_backup_values = ymomentum.centroid_backup_values
+	D.ymom_centroid_backup_values = &centroid_backup_values[0]
+
+	if "friction" in quantities:
+		centroid_values = quantities["friction"].centroid_values
+		D.friction_centroid_values = &centroid_values[0]
+	else:
+		D.friction_centroid_values = NULL
+
+	if "xvelocity" in quantities and "yvelocity" in quantities:
+		edge_values = quantities["xvelocity"].edge_values
+		D.xvel_edge_values = &edge_values[0,0]
+
+		edge_values = quantities["yvelocity"].edge_values
+		D.yvel_edge_values = &edge_values[0,0]
+
+		boundary_values = quantities["xvelocity"].boundary_values
+		D.xvel_boundary_values = &boundary_values[0]
+
+		boundary_values = quantities["yvelocity"].boundary_values
+		D.yvel_boundary_values = &boundary_values[0]
+	else:
+		D.xvel_edge_values = NULL
+		D.yvel_edge_values = NULL
+		D.xvel_boundary_values = NULL
+		D.yvel_boundary_values = NULL
+
 	#------------------------------------------------------
 	# Riverwall structures
 	#------------------------------------------------------
@@ -315,62 +503,675 @@ cdef inline get_python_domain_pointers(domain *D, object domain_object):
 	riverwall_rowIndex = riverwallData.hydraulic_properties_rowIndex
 	D.riverwall_rowIndex = &riverwall_rowIndex[0]
 
+	riverwall_index = riverwallData.riverwall_index
+	D.riverwall_index = &riverwall_index[0]
+
 	D.ncol_riverwall_hydraulic_properties = riverwallData.ncol_hydraulic_properties
 
 	riverwall_hydraulic_properties = riverwallData.hydraulic_properties
 	D.riverwall_hydraulic_properties = &riverwall_hydraulic_properties[0,0]
 
+cdef inline get_python_edge_pointers(domain *D, object domain_object):
+
+	cdef long[:,::1]   edge_cells
+	cdef long[:,::1]   edge_half_edges
+	cdef double[:,::1] edge_normals
+	cdef double[::1]   edge_lengths
+	cdef long[::1]     edge_riverwall_index
+	cdef double[::1]   edge_max_speed
+
+	if domain_object.edge_structure is None:
+		domain_object.edge_structure = build_edge_structure(domain_object)
+
+	edge_structure = domain_object.edge_structure
+
+	edge_cells = edge_structure['cells']
+	D.edge_cells = &edge_cells[0,0]
+	D.number_of_unique_edges = edge_cells.shape[0]
+
+	edge_half_edges = edge_structure['half_edges']
+	D.edge_half_edges = &edge_half_edges[0,0]
+
+	edge_normals = edge_structure['normals']
+	D.edge_normals = &edge_normals[0,0]
+
+	edge_lengths = edge_structure['lengths']
+	D.edge_lengths = &edge_lengths[0]
+
+	edge_riverwall_index = edge_structure['riverwall_index']
+	D.edge_riverwall_index = &edge_riverwall_index[0]
+
+	edge_max_speed = edge_structure['max_speed']
+	D.edge_max_speed = &edge_max_speed[0]
+
+
+def _unpickle_domain_struct():
+
+	return None
+
+cdef class Domain_struct:
+	"""C domain structure cached on the python domain between kernel calls.
+
+	The pointers are bound once; only the scalar parameters are refreshed
+	on each call. References to every array reachable from the bound
+	objects are held so a pointer can never outlive its array. Anything
+	that rebinds (rather than updates in place) one of these arrays must
+	call domain.invalidate_domain_struct().
+	"""
+
+	cdef domain D
+	cdef object keep_alive
+	cdef bint edge_pointers_bound
+
+	def __cinit__(self, object domain_object):
+
+		get_python_domain_parameters(&self.D, domain_object)
+		get_python_domain_pointers(&self.D, domain_object)
+
+		quantities = domain_object.quantities
+		self.keep_alive = [dict(domain_object.__dict__),
+				dict(domain_object.riverwallData.__dict__)] + \
+				[dict(quantities[name].__dict__) for name in
+				('stage', 'xmomentum', 'ymomentum', 'elevation', 'height', 'friction',
+				'xvelocity', 'yvelocity')
+				if name in quantities]
+		self.edge_pointers_bound = False
+
+	def __reduce__(self):
+
+		# Pointers are meaningless in another process, rebuild on first use
+		return (_unpickle_domain_struct, ())
+
+cdef Domain_struct get_domain_struct(object domain_object):
+
+	cdef Domain_struct ds = domain_object.c_domain_struct
+
+	if ds is None:
+		ds = Domain_struct(domain_object)
+		domain_object.c_domain_struct = ds
+	else:
+		get_python_domain_parameters(&ds.D, domain_object)
+
+	return ds
+
+cdef Domain_struct get_domain_struct_with_edges(object domain_object):
+
+	cdef Domain_struct ds = get_domain_struct(domain_object)
+
+	if not ds.edge_pointers_bound:
+		get_python_edge_pointers(&ds.D, domain_object)
+		ds.keep_alive.append(domain_object.edge_structure)
+		ds.edge_pointers_bound = True
+
+	return ds
+
 
 #===============================================================================
 
+def flux_function_central(np.ndarray[double, ndim=1, mode="c"] normal not None,\
+						np.ndarray[double, ndim=1, mode="c"] ql not None,\
+						np.ndarray[double, ndim=1, mode="c"] qr not None,\
+						double h_left,\
+						double h_right,\
+						double hle,\
+						double hre,\
+						np.ndarray[double, ndim=1, mode="c"] edgeflux not None,\
+						double epsilon,\
+						double ze,\
+						double g,\
+						long low_froude):
+
+	cdef double max_speed, pressure_flux
+
+	_flux_function_central(&ql[0], &qr[0], h_left, h_right, hle, hre, normal[0], normal[1],\
+				epsilon, ze, 0.0, g, &edgeflux[0], &max_speed, &pressure_flux, 0.0, 0.0, low_froude)
+
+	return max_speed, pressure_flux
+
+def flux_function_central_batch(np.ndarray[double, ndim=2, mode="c"] normals not None,\
+						np.ndarray[double, ndim=2, mode="c"] ql not None,\
+						np.ndarray[double, ndim=2, mode="c"] qr not None,\
+						np.ndarray[double, ndim=1, mode="c"] h_left not None,\
+						np.ndarray[double, ndim=1, mode="c"] h_right not None,\
+						np.ndarray[double, ndim=1, mode="c"] hle not None,\
+						np.ndarray[double, ndim=1, mode="c"] hre not None,\
+						np.ndarray[double, ndim=2, mode="c"] edgeflux not None,\
+						double epsilon,\
+						np.ndarray[double, ndim=1, mode="c"] ze not None,\
+						double g,\
+						long low_froude):
+	"""Fluxes through nb edges at once. normals has shape (2, nb), ql, qr
+	and edgeflux have shape (3, nb), with one column per edge.
+	Returns arrays of max_speed and pressure_flux.
+	"""
+
+	cdef long nb = h_left.shape[0]
+	cdef np.ndarray[double, ndim=1, mode="c"] max_speed = np.zeros(nb, dtype=float)
+	cdef np.ndarray[double, ndim=1, mode="c"] pressure_flux = np.zeros(nb, dtype=float)
+
+	_flux_function_central_batch(nb, &ql[0,0], &qr[0,0], &h_left[0], &h_right[0], &hle[0], &hre[0],\
+				&normals[0,0], &normals[1,0], epsilon, &ze[0], g,\
+				&edgeflux[0,0], &max_speed[0], &pressure_flux[0], low_froude)
+
+	return max_speed, pressure_flux
+
+def build_edge_structure(object domain_object):
+	"""Build the edge based layout used by compute_fluxes_ext_central_edges
+
+	Each unique edge of the mesh is stored once, with its two cells (the
+	lower indexed triangle first, the second cell is the negative
+	boundary flag for boundary edges), the linear indices 3*k+i of its
+	two half edges (-1 for the boundary side), and the normal, length
+	and riverwall index seen from the first cell.
+
+	Needs to be rebuilt if the mesh or the riverwalls change.
+	"""
+
+	cdef long[:,::1]   neighbours = domain_object.neighbours
+	cdef long[:,::1]   neighbour_edges = domain_object.neighbour_edges
+	cdef double[:,::1] normals = domain_object.normals
+	cdef double[:,::1] edgelengths = domain_object.edgelengths
+	cdef long[::1]     edge_flux_type = domain_object.edge_flux_type
+	cdef long[::1]     riverwall_index = domain_object.riverwallData.riverwall_index
+	cdef long number_of_elements = domain_object.number_of_elements
+	cdef long k, i, n, e, ki, number_of_unique_edges
+
+	cdef long[:,::1]   edge_cells
+	cdef long[:,::1]   edge_half_edges
+	cdef double[:,::1] edge_normals
+	cdef double[::1]   edge_lengths
+	cdef long[::1]     edge_riverwall_index
+
+	number_of_unique_edges = 0
+	for k in range(number_of_elements):
+		for i in range(3):
+			n = neighbours[k,i]
+			if n < 0 or n > k:
+				number_of_unique_edges += 1
+
+	edge_cells = np.zeros((number_of_unique_edges, 2), dtype=int)
+	edge_half_edges = np.zeros((number_of_unique_edges, 2), dtype=int)
+	edge_normals = np.zeros((number_of_unique_edges, 2), dtype=float)
+	edge_lengths = np.zeros(number_of_unique_edges, dtype=float)
+	edge_riverwall_index = np.zeros(number_of_unique_edges, dtype=int)
+
+	e = 0
+	for k in range(number_of_elements):
+		for i in range(3):
+			n = neighbours[k,i]
+			if n >= 0 and n < k:
+				continue
+
+			ki = 3*k + i
+			edge_cells[e,0] = k
+			edge_cells[e,1] = n
+			edge_half_edges[e,0] = ki
+			if n >= 0:
+				edge_half_edges[e,1] = 3*n + neighbour_edges[k,i]
+			else:
+				edge_half_edges[e,1] = -1
+			edge_normals[e,0] = normals[k,2*i]
+			edge_normals[e,1] = normals[k,2*i+1]
+			edge_lengths[e] = edgelengths[k,i]
+			if edge_flux_type[ki] == 1:
+				edge_riverwall_index[e] = riverwall_index[ki]
+			else:
+				edge_riverwall_index[e] = -1
+			e += 1
+
+	return {'cells' : edge_cells.base,
+		'half_edges' : edge_half_edges.base,
+		'normals' : edge_normals.base,
+		'lengths' : edge_lengths.base,
+		'riverwall_index' : edge_riverwall_index.base,
+		'max_speed' : np.zeros(3*number_of_elements, dtype=float)}
+
 def compute_fluxes_ext_central(object domain_object, double timestep):
 
-	cdef domain D
+	cdef Domain_struct ds = get_domain_struct(domain_object)
+
+	with nogil:
+		timestep = _compute_fluxes_central(&ds.D, timestep)
+
+	return timestep
 
-	get_python_domain_parameters(&D, domain_object)
-	get_python_domain_pointers(&D, domain_object)
+def compute_fluxes_ext_central_openmp(object domain_object, double timestep):
+
+	cdef Domain_struct ds = get_domain_struct(domain_object)
 
 	with nogil:
-		timestep = _compute_fluxes_central(&D, timestep)
+		timestep = _openmp_compute_fluxes_central(&ds.D, timestep)
 
 	return timestep
 
+def compute_fluxes_ext_central_edges(object domain_object, double timestep):
+
+	cdef Domain_struct ds = get_domain_struct_with_edges(domain_object)
+
+	with nogil:
+		timestep = _compute_fluxes_central_edges(&ds.D, timestep)
+
+	return timestep
+
+def set_omp_num_threads(int num_threads):
+
+	_set_omp_num_threads(num_threads)
+
+cdef inline _mark_vertex_values_stale(Domain_struct ds, object domain_object):
+	# The extrapolation left out the vertex values, which are computed
+	# when next accessed (see Domain.set_lazy_vertex_values)
+
+	if ds.D.lazy_vertex_values:
+		for name in ['stage', 'xmomentum', 'ymomentum', 'height']:
+			domain_object.quantities[name].vertex_values_stale = True
+
 def extrapolate_second_order_edge_sw(object domain_object):
 
-	cdef domain D
+	cdef Domain_struct ds = get_domain_struct(domain_object)
 	cdef int e
 
-	get_python_domain_parameters(&D, domain_object)
-	get_python_domain_pointers(&D, domain_object)
+	with nogil:
+		e = _extrapolate_second_order_edge_sw(&ds.D)
+
+	_mark_vertex_values_stale(ds, domain_object)
+
+	if e == -1:
+		return None
+
+def extrapolate_second_order_edge_sw_openmp(object domain_object):
+
+	cdef Domain_struct ds = get_domain_struct(domain_object)
+	cdef int e
 
 	with nogil:
-		e = _extrapolate_second_order_edge_sw(&D)
+		e = _openmp_extrapolate_second_order_edge_sw(&ds.D)
+
+	_mark_vertex_values_stale(ds, domain_object)
 
 	if e == -1:
 		return None
 
+def compute_vertex_values(object domain_object):
+
+	cdef Domain_struct ds = get_domain_struct(domain_object)
+
+	with nogil:
+		_compute_vertex_values(&ds.D)
+
 def protect_new(object domain_object):
 
-	cdef domain D
+	cdef Domain_struct ds = get_domain_struct(domain_object)
 
 	cdef double mass_error
 
-	get_python_domain_parameters(&D, domain_object)
-	get_python_domain_pointers(&D, domain_object)
-
 	with nogil:
-		mass_error = _protect_new(&D)
+		mass_error = _protect_new(&ds.D)
 
 	return mass_error
 
+def evaluate_boundaries(object domain_object,\
+			np.ndarray[long, ndim=1, mode="c"] ids not None,\
+			np.ndarray[long, ndim=1, mode="c"] edges not None,\
+			np.ndarray[long, ndim=1, mode="c"] types not None,\
+			np.ndarray[long, ndim=1, mode="c"] slots not None,\
+			np.ndarray[double, ndim=1, mode="c"] values not None,\
+			double g):
+
+	cdef Domain_struct ds = get_domain_struct(domain_object)
+	cdef long number_of_edges = ids.shape[0]
+	cdef long centroid_transmissive_bc = domain_object.centroid_transmissive_bc
+
+	if number_of_edges == 0:
+		return
+
+	with nogil:
+		_evaluate_boundaries(&ds.D, number_of_edges, &ids[0], &edges[0], &types[0],
+				&slots[0], &values[0], g, centroid_transmissive_bc)
+
 def compute_flux_update_frequency(object domain_object, double timestep):
 
-	cdef domain D
+	cdef Domain_struct ds = get_domain_struct(domain_object)
+
+	with nogil:
+		_compute_flux_update_frequency(&ds.D, timestep)
+
+#===============================================================================
+# Native DE timestepping
+#===============================================================================
+
+cdef inline _native_distribute(Domain_struct ds, object domain_object, object profiler):
+
+	cdef double mass_error
 
-	get_python_domain_parameters(&D, domain_object)
-	get_python_domain_pointers(&D, domain_object)
+	t0 = profiler.start()
+	with nogil:
+		mass_error = _protect_new(&ds.D)
+	profiler.stop('protect', t0)
+
+	t0 = profiler.start()
+	with nogil:
+		if ds.D.multiprocessor_mode == 1:
+			_openmp_extrapolate_second_order_edge_sw(&ds.D)
+		else:
+			_extrapolate_second_order_edge_sw(&ds.D)
+	profiler.stop('extrapolation', t0)
+
+	_mark_vertex_values_stale(ds, domain_object)
+
+	if mass_error > 0.0 and domain_object.verbose:
+		print('Cumulative mass protection: {0} m^3'.format(mass_error))
 
+cdef inline _native_compute_fluxes(Domain_struct ds, object domain_object, int flux_kernel,
+				object profiler):
+
+	cdef double timestep = ds.D.evolve_max_timestep
+
+	t0 = profiler.start()
 	with nogil:
-		_compute_flux_update_frequency(&D, timestep)
+		if flux_kernel == 2:
+			timestep = _compute_fluxes_central_edges(&ds.D, timestep)
+		elif flux_kernel == 1:
+			timestep = _openmp_compute_fluxes_central(&ds.D, timestep)
+		else:
+			timestep = _compute_fluxes_central(&ds.D, timestep)
+	profiler.stop('flux', t0)
+
+	domain_object.flux_timestep = timestep
+
+cdef inline _native_forcing(Domain_struct ds, object domain_object, list forcing_terms, object manning,
+				object profiler):
+
+	t0 = profiler.start()
+	for f in forcing_terms:
+		if f is manning and ds.D.friction_centroid_values != NULL:
+			with nogil:
+				_manning_friction(&ds.D)
+		else:
+			f(domain_object)
+	profiler.stop('forcing', t0)
+
+cdef inline _native_update(Domain_struct ds, double timestep, object profiler):
+
+	cdef long number_of_negative_cells
+
+	t0 = profiler.start()
+	with nogil:
+		number_of_negative_cells = _update_conserved_quantities(&ds.D, timestep)
+	profiler.stop('update', t0)
+
+	assert number_of_negative_cells >= 0, "quantity_ext.c: update, division by zero in semi implicit update - call Stephen :)"
+
+	if number_of_negative_cells > 0:
+		import warnings
+		msg = 'Negative cells being set to zero depth, possible loss of conservation. \n' +\
+		      'Consider using domain.report_water_volume_statistics() to check the extent of the problem'
+		warnings.warn(msg)
+
+cdef inline _native_euler_substep(Domain_struct ds, object domain_object, int flux_kernel,
+				list forcing_terms, object manning, object profiler, bint post_reduction):
+	# If post_reduction, the reduction of the flux timestep is started
+	# before the forcing terms (post_timestep_reduction)
+
+	_native_distribute(ds, domain_object, profiler)
+	profiler.time('boundary', domain_object.update_boundary)
+	_native_compute_fluxes(ds, domain_object, flux_kernel, profiler)
+	if post_reduction:
+		domain_object.post_timestep_reduction()
+	_native_forcing(ds, domain_object, forcing_terms, manning, profiler)
+
+cdef inline long* _cells_pointer(np.ndarray[long, ndim=1, mode="c"] cells):
 
+	if cells.shape[0] == 0:
+		return NULL
+	return &cells[0]
+
+cdef inline double _native_overlap_distribute(Domain_struct ds, tuple cells, object profiler):
+	# Protection and extrapolation of the cells of one part of
+	# build_local_overlap_cells, returns the mass error of the protection
+
+	cdef double mass_error
+	cdef long n0 = len(cells[0]), n1 = len(cells[1]), n2 = len(cells[2]), n3 = len(cells[3])
+	cdef long* c0 = _cells_pointer(cells[0])
+	cdef long* c1 = _cells_pointer(cells[1])
+	cdef long* c2 = _cells_pointer(cells[2])
+	cdef long* c3 = _cells_pointer(cells[3])
+
+	t0 = profiler.start()
+	with nogil:
+		mass_error = _protect_cells(&ds.D, n0, c0)
+	profiler.stop('protect', t0)
+
+	t0 = profiler.start()
+	with nogil:
+		_openmp_extrapolate_second_order_edge_sw_cells(&ds.D, n1, c1, n2, c2, n3, c3)
+	profiler.stop('extrapolation', t0)
+
+	return mass_error
+
+cdef inline double _native_overlap_fluxes(Domain_struct ds, tuple cells, int first, int last,
+				object profiler):
+	# Fluxes of the cells of one part of build_local_overlap_cells
+
+	cdef double timestep = ds.D.evolve_max_timestep
+	cdef long n4 = len(cells[4])
+	cdef long* c4 = _cells_pointer(cells[4])
+
+	t0 = profiler.start()
+	with nogil:
+		timestep = _openmp_compute_fluxes_central_part(&ds.D, timestep, n4, c4, first, last)
+	profiler.stop('flux', t0)
+
+	return timestep
+
+cdef inline _native_overlap_euler_substep(Domain_struct ds, object domain_object,
+				list forcing_terms, object manning, object profiler, bint backup,
+				bint post_reduction):
+	# _native_euler_substep with the ghost exchange posted before it
+	# (post_ghost_exchange): the interior cells, which do not depend on
+	# the ghost cells, are computed while the exchange is in flight. If
+	# backup, the conserved quantities were backed up before the exchange
+	# was completed, and the ghost cells are backed up again after.
+
+	cdef double mass_error
 
+	interior_cells, boundary_cells = domain_object.overlap_cells
+
+	mass_error = _native_overlap_distribute(ds, interior_cells, profiler)
+	_native_overlap_fluxes(ds, interior_cells, 1, 0, profiler)
+
+	profiler.time('ghost_exchange', domain_object.complete_ghost_exchange)
+
+	if backup:
+		ghost_cells = boundary_cells[0]
+		for name in domain_object.conserved_quantities:
+			Q = domain_object.quantities[name]
+			Q.centroid_backup_values[ghost_cells] = Q.centroid_values[ghost_cells]
+
+	mass_error += _native_overlap_distribute(ds, boundary_cells, profiler)
+
+	_mark_vertex_values_stale(ds, domain_object)
+
+	if mass_error > 0.0 and domain_object.verbose:
+		print('Cumulative mass protection: {0} m^3'.format(mass_error))
+
+	profiler.time('boundary', domain_object.update_boundary)
+	domain_object.flux_timestep = _native_overlap_fluxes(ds, boundary_cells, 0, 1, profiler)
+	if post_reduction:
+		domain_object.post_timestep_reduction()
+	_native_forcing(ds, domain_object, forcing_terms, manning, profiler)
+
+def evolve_to_yieldstep(object domain_object, double yieldstep, object finaltime):
+	"""Take DE timesteps until the next yield time or finaltime is reached.
+
+	Does what the body of the evolve loop in Generic_Domain._evolve_base
+	does for each timestep, for the euler, rk2 and rk3 timestepping
+	methods, in a single call. Extrapolation, fluxes, Manning friction,
+	the conserved quantity updates and the Runge-Kutta combinations run in
+	C. Python is only called for boundaries, other forcing terms,
+	update_timestep, fractional step operators, ghost updates and
+	monitored extrema.
+
+	With ghost_exchange_overlap, each ghost exchange followed by an euler
+	substep is posted rather than done, and completed within the substep
+	(see _native_overlap_euler_substep). Ghost exchanges are skipped
+	while the ghost layer is deep enough (see set_ghost_exchange_period).
+	"""
+
+	from anuga.config import epsilon
+	from anuga.shallow_water.shallow_water_domain import manning_friction_implicit
+
+	cdef Domain_struct ds
+	cdef int flux_kernel, substeps
+	cdef double relative_time, initial_time, timestep
+	cdef bint update_ghosts, update_extrema
+	cdef bint overlap, pending = False
+
+	substeps = {'euler' : 1, 'rk2' : 2, 'rk3' : 3}[domain_object.timestepping_method]
+
+	if domain_object.edge_based_fluxes or domain_object.simd_fluxes:
+		flux_kernel = 2
+	elif domain_object.multiprocessor_mode == 1:
+		flux_kernel = 1
+	else:
+		flux_kernel = 0
+
+	forcing_terms = list(domain_object.forcing_terms)
+	operators = domain_object.fractional_step_operators
+	update_ghosts = domain_object.numproc > 1 or \
+			domain_object.processor in domain_object.full_send_dict
+	update_extrema = domain_object.quantities_to_be_monitored is not None
+	profiler = domain_object.kernel_profiler
+
+	# The split kernels need every flux computed every timestep
+	overlap = update_ghosts and domain_object.ghost_exchange_overlap and \
+			flux_kernel != 2 and not domain_object.active_cell_compaction and \
+			domain_object.max_flux_update_frequency == 1
+
+	if overlap:
+		exchange = domain_object.post_ghost_exchange
+	else:
+		exchange = domain_object.update_ghosts
+
+	while True:
+		# Operators may have changed parameters or invalidated the struct
+		if flux_kernel == 2:
+			ds = get_domain_struct_with_edges(domain_object)
+		else:
+			ds = get_domain_struct(domain_object)
+
+		relative_time = domain_object.relative_time
+		initial_time = domain_object.starttime + relative_time
+
+		if substeps > 1:
+			t0 = profiler.start()
+			with nogil:
+				_backup_conserved_quantities(&ds.D)
+			profiler.stop('backup', t0)
+
+		# First euler step
+		if pending:
+			_native_overlap_euler_substep(ds, domain_object, forcing_terms, manning_friction_implicit,
+							profiler, substeps > 1, True)
+			pending = False
+		else:
+			_native_euler_substep(ds, domain_object, flux_kernel, forcing_terms, manning_friction_implicit,
+							profiler, True)
+
+		profiler.time('timestep', domain_object.update_timestep, yieldstep, finaltime)
+		timestep = domain_object.timestep
+
+		if substeps == 1 and ds.D.max_flux_update_frequency != 1:
+			t0 = profiler.start()
+			with nogil:
+				_compute_flux_update_frequency(&ds.D, timestep)
+			profiler.stop('flux_update_frequency', t0)
+
+		_native_update(ds, timestep, profiler)
+
+		if substeps > 1:
+			# Second euler step using the same timestep
+			domain_object.relative_time = relative_time + timestep
+
+			if update_ghosts and domain_object.ghost_exchange_due(1):
+				profiler.time('ghost_exchange', exchange)
+				domain_object.record_ghost_exchange(1)
+				pending = overlap
+
+			if pending:
+				_native_overlap_euler_substep(ds, domain_object, forcing_terms, manning_friction_implicit,
+								profiler, False, False)
+				pending = False
+			else:
+				_native_euler_substep(ds, domain_object, flux_kernel, forcing_terms, manning_friction_implicit,
+								profiler, False)
+			_native_update(ds, timestep, profiler)
+
+		if substeps == 2:
+			t0 = profiler.start()
+			with nogil:
+				_saxpy_conserved_quantities(&ds.D, 0.5, 0.5, 1.0)
+			profiler.stop('saxpy', t0)
+
+		if substeps == 3:
+			t0 = profiler.start()
+			with nogil:
+				_saxpy_conserved_quantities(&ds.D, 0.25, 0.75, 1.0)
+			profiler.stop('saxpy', t0)
+
+			# Third euler step from the intermediate solution at t + h/2
+			domain_object.relative_time = relative_time + timestep * 0.5
+
+			if update_ghosts and domain_object.ghost_exchange_due(2):
+				profiler.time('ghost_exchange', exchange)
+				domain_object.record_ghost_exchange(2)
+				pending = overlap
+
+			if pending:
+				_native_overlap_euler_substep(ds, domain_object, forcing_terms, manning_friction_implicit,
+								profiler, False, False)
+				pending = False
+			else:
+				_native_euler_substep(ds, domain_object, flux_kernel, forcing_terms, manning_friction_implicit,
+								profiler, False)
+			_native_update(ds, timestep, profiler)
+
+			t0 = profiler.start()
+			with nogil:
+				_saxpy_conserved_quantities(&ds.D, 2.0, 1.0, 3.0)
+			profiler.stop('saxpy', t0)
+
+			domain_object.relative_time = relative_time + timestep
+
+		if operators:
+			domain_object.apply_fractional_steps()
+
+		domain_object.set_time(initial_time + domain_object.timestep)
+
+		# Between exchanges the ghost cells are computed redundantly (see
+		# set_ghost_exchange_period). The extrema are found over the ghost
+		# cells too, so the exchange is completed at once for them.
+		if update_ghosts:
+			domain_object.advance_ghost_layers()
+			if domain_object.ghost_exchange_due_at_step_end():
+				if update_extrema:
+					profiler.time('ghost_exchange', domain_object.update_ghosts)
+				else:
+					profiler.time('ghost_exchange', exchange)
+					pending = overlap
+				domain_object.record_ghost_exchange()
+
+		if update_extrema:
+			profiler.time('extrema', domain_object.update_extrema)
+
+		domain_object.number_of_steps += 1
+
+		if domain_object._order_ == 1:
+			domain_object.number_of_first_order_steps += 1
+
+		time = domain_object.get_time()
+
+		if (finaltime is not None and time >= finaltime - epsilon) or \
+				time >= domain_object.yieldtime:
+			if pending:
+				profiler.time('ghost_exchange', domain_object.complete_ghost_exchange)
+			break
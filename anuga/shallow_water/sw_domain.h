@@ -33,6 +33,13 @@ struct domain {
 
     long max_flux_update_frequency;
     long ncol_riverwall_hydraulic_properties;
+    long number_of_boundary_flux_edges;
+    long number_of_unique_edges;
+    long multiprocessor_mode;
+    long simd_fluxes;
+    long use_sloped_mannings;
+    long active_cell_compaction;
+    long lazy_vertex_values;
 
     // Changing values in these arrays will change the values in the python object
     long*   neighbours;
@@ -72,31 +79,82 @@ struct domain {
     double* bed_vertex_values;
     double* height_vertex_values;
 
+    // Single precision vertex values, used in place of the above
+    // when not NULL (see Domain.set_vertex_output_precision)
+    float* stage_vertex_values_single;
+    float* xmom_vertex_values_single;
+    float* ymom_vertex_values_single;
+    float* height_vertex_values_single;
 
     double* stage_boundary_values;
     double* xmom_boundary_values;
     double* ymom_boundary_values;
     double* bed_boundary_values;
+    double* height_boundary_values;
 
     double* stage_explicit_update;
     double* xmom_explicit_update;
     double* ymom_explicit_update;
 
+    double* stage_semi_implicit_update;
+    double* xmom_semi_implicit_update;
+    double* ymom_semi_implicit_update;
+
+    double* stage_centroid_backup_values;
+    double* xmom_centroid_backup_values;
+    double* ymom_centroid_backup_values;
+
+    double* friction_centroid_values;
+
+    double* xvel_edge_values;
+    double* yvel_edge_values;
+    double* xvel_boundary_values;
+    double* yvel_boundary_values;
+
     long* flux_update_frequency;
     long* update_next_flux;
     long* update_extrapolation;
+    long* triangle_flux_update_frequency;
+    long* flux_update_statistics;
+    long* flux_update_cells;
+    long* number_of_flux_update_cells;
     double* edge_timestep;
     double* edge_flux_work;
     double* pressuregrad_work;
     double* x_centroid_work;
     double* y_centroid_work;
     double* boundary_flux_sum;
+    long* boundary_flux_edges;
 
     long* allow_timestep_increase;
 
+    // State of the flux computation kept between calls
+    long* flux_call;
+    long* flux_base_call;
+    long* flux_last_timestep_fluxcalls;
+    long* flux_cyclic_number_of_steps;
+    double* flux_local_timestep;
+
+    // Active cell compaction (see _update_active_cells)
+    long* active_cells;
+    long* extrapolation_cells;
+    long* active_cell_distance;
+    long* active_cell_changed;
+    long* number_of_active_cells;
+    double* active_cell_state;
+
     double* riverwall_elevation;
     long* riverwall_rowIndex;
+    long* riverwall_index;
     double* riverwall_hydraulic_properties;
+
+    // Edge based layout, one entry (or pair of entries) per unique edge
+    long* edge_cells;
+    long* edge_half_edges;
+    double* edge_normals;
+    double* edge_lengths;
+    long* edge_riverwall_index;
+    double* edge_max_speed;
 };
 
 
@@ -105,7 +105,800 @@ class Test_DE1_domain(unittest.TestCase):
         assert num.all(vv<2.0e-02)
 
 
-            
+    def _create_riverwall_domain(self, flow_algorithm, multiprocessor_mode):
+
+        points, vertices, boundary = anuga.rectangular_cross(20,20, len1=1., len2=1.)
+
+        domain=Domain(points,vertices,boundary)
+        domain.set_flow_algorithm(flow_algorithm)
+        domain.set_store(False)
+        domain.set_multiprocessor_mode(multiprocessor_mode)
+
+        def topography(x,y):
+            return -x/2.0 +0.05*num.sin((x+y)*50.0)
+
+        def stagefun(x,y):
+            return -0.1 + 0.3*(x<0.5)
+
+        domain.set_quantity('elevation',topography,location='centroids')
+        domain.set_quantity('friction',0.03)
+        domain.set_quantity('stage', stagefun,location='centroids')
+
+        riverWall={ 'centralWall': [ [0.5, 0.0, 0.05], [0.5, 1.0, 0.05]] }
+        riverWall_Par={'centralWall':{'Qfactor':1.0}}
+        domain.riverwallData.create_riverwalls(riverWall,riverWall_Par,verbose=False)
+
+        Br=anuga.Reflective_boundary(domain)
+        Bd=anuga.Dirichlet_boundary([0.0, 0.0, 0.0])
+        domain.set_boundary({'left': Br, 'right': Bd, 'top': Br, 'bottom':Br})
+
+        return domain
+
+    def _assert_same_evolution(self, domain_1, domain_2):
+
+        for t in domain_1.evolve(yieldstep=0.1, finaltime=0.5):
+            pass
+
+        for t in domain_2.evolve(yieldstep=0.1, finaltime=0.5):
+            pass
+
+        for name in ['stage', 'xmomentum', 'ymomentum']:
+            Q_1 = domain_1.quantities[name]
+            Q_2 = domain_2.quantities[name]
+            assert num.all(Q_1.centroid_values == Q_2.centroid_values)
+            assert num.all(Q_1.edge_values == Q_2.edge_values)
+
+        assert num.all(domain_1.max_speed == domain_2.max_speed)
+        assert domain_1.get_boundary_flux_integral() == \
+               domain_2.get_boundary_flux_integral()
+        assert domain_1.get_time() == domain_2.get_time()
+
+    def test_openmp_fluxes_match_serial(self):
+        """Threaded flux computation should give identical results
+        to the serial flux computation
+        """
+
+        for flow_algorithm in ['DE0', 'DE1']:
+            domain_serial = self._create_riverwall_domain(flow_algorithm, 0)
+            domain_openmp = self._create_riverwall_domain(flow_algorithm, 1)
+            domain_openmp.set_omp_num_threads(4)
+
+            assert num.sum(domain_serial.riverwallData.riverwall_index >= 0) > 0
+
+            self._assert_same_evolution(domain_serial, domain_openmp)
+
+    def test_openmp_extrapolation_matches_serial(self):
+        """The fused, threaded extrapolation should give identical
+        results to the serial extrapolation
+        """
+
+        from anuga.shallow_water import swDE1_domain_ext as ext
+
+        def topography(x,y):
+            return x/2.0 + 0.05*num.sin((x+y)*50.0)
+
+        def stagefun(x,y):
+            return 0.1*(x<0.2) + topography(x,y)*(x>=0.2)
+
+        def xmomfun(x,y):
+            return 0.01*num.cos(x*30.0)*(x<0.3)
+
+        names = ['stage', 'xmomentum', 'ymomentum', 'elevation', 'height']
+
+        for velocity in [True, False]:
+            domains = []
+            for multiprocessor_mode in [0, 1]:
+                domain = self._create_riverwall_domain('DE1', multiprocessor_mode)
+                domain.set_quantity('elevation',topography,location='centroids')
+                domain.set_quantity('stage', stagefun,location='centroids')
+                domain.set_quantity('xmomentum', xmomfun,location='centroids')
+                domain.set_quantity('ymomentum', xmomfun,location='centroids')
+                domain.set_extrapolate_velocity(velocity)
+                domain.set_omp_num_threads(4)
+
+                # A wet cell surrounded by dry cells
+                d = num.sum((domain.centroid_coordinates - [0.8, 0.5])**2, axis=1)
+                k = num.argmin(d)
+                domain.quantities['stage'].centroid_values[k] += 0.05
+                domain.quantities['xmomentum'].centroid_values[k] = 0.01
+
+                domain.protect_against_infinitesimal_and_negative_heights()
+                domains.append(domain)
+
+            xmom = domains[1].quantities['xmomentum'].centroid_values.copy()
+
+            ext.extrapolate_second_order_edge_sw(domains[0])
+            ext.extrapolate_second_order_edge_sw_openmp(domains[1])
+
+            for name in names:
+                Q_1 = domains[0].quantities[name]
+                Q_2 = domains[1].quantities[name]
+                assert num.all(Q_1.centroid_values == Q_2.centroid_values)
+                assert num.all(Q_1.edge_values == Q_2.edge_values)
+                assert num.all(Q_1.vertex_values == Q_2.vertex_values)
+
+            # The momentum of the wet cell surrounded by dry cells is zeroed
+            assert num.any(domains[1].quantities['xmomentum'].centroid_values != xmom)
+
+    def test_edge_based_fluxes_match_serial(self):
+        """Edge based flux computation, serial and threaded, should give
+        identical results to the triangle based flux computation
+        """
+
+        for multiprocessor_mode in [0, 1]:
+            domain_serial = self._create_riverwall_domain('DE1', 0)
+            domain_edges = self._create_riverwall_domain('DE1', multiprocessor_mode)
+            domain_edges.set_edge_based_fluxes(True)
+
+            self._assert_same_evolution(domain_serial, domain_edges)
+
+            # Each interior edge once, and each boundary edge
+            edge_structure = domain_edges.edge_structure
+            number_of_boundary_edges = num.sum(domain_edges.neighbours < 0)
+            assert edge_structure['cells'].shape[0] == \
+                   (3*domain_edges.number_of_elements + number_of_boundary_edges)//2
+            assert num.sum(edge_structure['riverwall_index'] >= 0) == \
+                   len(domain_edges.riverwallData.riverwall_elevation)//2
+
+    def test_flux_function_central_batch(self):
+        """Batched flux function should agree with the scalar flux
+        function, including dry and partially dry edges
+        """
+
+        from anuga.shallow_water.swDE1_domain_ext import flux_function_central
+        from anuga.shallow_water.swDE1_domain_ext import flux_function_central_batch
+
+        nb = 203
+        g = 9.8
+        epsilon = 1.0e-12
+
+        num.random.seed(17)
+        angle = num.random.uniform(0.0, 2*num.pi, nb)
+        normals = num.ascontiguousarray(num.array([num.cos(angle), num.sin(angle)]))
+        ze = num.random.uniform(-1.0, 0.0, nb)
+        hle = num.random.uniform(0.0, 2.0, nb)
+        hre = num.random.uniform(0.0, 2.0, nb)
+        # Some dry edges, and some edges with one dry side
+        hle[::7] = 0.0
+        hre[::7] = 0.0
+        hle[1::5] = 0.0
+        hre[2::11] = 0.0
+        h_left = num.maximum(hle - num.random.uniform(0.0, 0.5, nb), 0.0)
+        h_right = num.maximum(hre - num.random.uniform(0.0, 0.5, nb), 0.0)
+        ql = num.ascontiguousarray(num.array([ze + hle,
+                    num.random.uniform(-2.0, 2.0, nb), num.random.uniform(-2.0, 2.0, nb)]))
+        qr = num.ascontiguousarray(num.array([ze + hre,
+                    num.random.uniform(-2.0, 2.0, nb), num.random.uniform(-2.0, 2.0, nb)]))
+
+        for low_froude in [0, 1, 2]:
+            edgeflux_batch = num.zeros((3, nb))
+            max_speed_batch, pressure_flux_batch = flux_function_central_batch(
+                normals, ql, qr, h_left, h_right, hle, hre,
+                edgeflux_batch, epsilon, ze, g, low_froude)
+
+            for j in range(nb):
+                edgeflux = num.zeros(3)
+                max_speed, pressure_flux = flux_function_central(
+                    num.ascontiguousarray(normals[:,j]),
+                    num.ascontiguousarray(ql[:,j]), num.ascontiguousarray(qr[:,j]),
+                    h_left[j], h_right[j], hle[j], hre[j],
+                    edgeflux, epsilon, ze[j], g, low_froude)
+
+                assert num.allclose(edgeflux, edgeflux_batch[:,j], rtol=1.0e-12, atol=1.0e-12)
+                assert num.allclose(max_speed, max_speed_batch[j], rtol=1.0e-12, atol=1.0e-12)
+                assert num.allclose(pressure_flux, pressure_flux_batch[j], rtol=1.0e-12, atol=1.0e-12)
+
+    def test_simd_fluxes_evolve(self):
+        """Evolution with the batched flux function should agree with the
+        scalar flux function to rounding error
+        """
+
+        domain_serial = self._create_riverwall_domain('DE1', 0)
+        domain_simd = self._create_riverwall_domain('DE1', 0)
+        domain_simd.set_simd_fluxes(True)
+
+        for t in domain_serial.evolve(yieldstep=0.1, finaltime=0.5):
+            pass
+
+        for t in domain_simd.evolve(yieldstep=0.1, finaltime=0.5):
+            pass
+
+        for name in ['stage', 'xmomentum', 'ymomentum']:
+            Q_serial = domain_serial.quantities[name]
+            Q_simd = domain_simd.quantities[name]
+            assert num.allclose(Q_serial.centroid_values, Q_simd.centroid_values,
+                                rtol=1.0e-10, atol=1.0e-10)
+
+    def test_cached_domain_struct(self):
+        """The C domain structure is built once and reused, and rebuilding
+        it at every yieldstep does not change the evolution
+        """
+
+        domain_1 = self._create_riverwall_domain('DE0', 0)
+        domain_2 = self._create_riverwall_domain('DE0', 0)
+
+        assert domain_1.c_domain_struct is None
+
+        structs = []
+        for t in domain_1.evolve(yieldstep=0.1, finaltime=0.5):
+            structs.append(domain_1.c_domain_struct)
+
+        assert structs[-1] is not None
+        for struct in structs[1:]:
+            assert struct is structs[-1]
+
+        for t in domain_2.evolve(yieldstep=0.1, finaltime=0.5):
+            domain_2.invalidate_domain_struct()
+
+        for name in ['stage', 'xmomentum', 'ymomentum']:
+            Q_1 = domain_1.quantities[name]
+            Q_2 = domain_2.quantities[name]
+            assert num.all(Q_1.centroid_values == Q_2.centroid_values)
+
+        # Pickled (checkpointed) without the structure, which the copy
+        # rebuilds on its next kernel call
+        import pickle
+        domain_3 = pickle.loads(pickle.dumps(domain_1))
+        assert domain_3.c_domain_struct is None
+        assert domain_1.c_domain_struct is structs[-1]
+        for domain in [domain_1, domain_3]:
+            for t in domain.evolve(yieldstep=0.1, duration=0.1):
+                pass
+        assert domain_3.c_domain_struct is not None
+        assert num.all(domain_1.quantities['stage'].centroid_values ==
+                       domain_3.quantities['stage'].centroid_values)
+
+        # Recreating the riverwalls replaces the riverwall arrays
+        riverWall={ 'centralWall': [ [0.5, 0.0, 0.05], [0.5, 1.0, 0.05]] }
+        riverWall_Par={'centralWall':{'Qfactor':1.0}}
+        domain_1.riverwallData.create_riverwalls(riverWall,riverWall_Par,verbose=False)
+
+        assert domain_1.c_domain_struct is None
+
+    def test_native_evolve_matches_python(self):
+        """Timestepping between yield points in C gives the same results
+        as the python timestepping loop
+        """
+
+        for flow_algorithm in ['DE0', 'DE1', 'DE2']:
+            domain_1 = self._create_riverwall_domain(flow_algorithm, 0)
+            domain_2 = self._create_riverwall_domain(flow_algorithm, 0)
+            domain_2.set_native_evolve(True)
+
+            assert not domain_1.use_native_evolve()
+            assert domain_2.use_native_evolve()
+
+            # A fractional step operator, called back from C
+            for domain in [domain_1, domain_2]:
+                anuga.Rate_operator(domain, rate=0.1, center=(0.25, 0.5), radius=0.1)
+
+            self._assert_same_evolution(domain_1, domain_2)
+
+            assert domain_1.number_of_steps == domain_2.number_of_steps
+            assert domain_1.get_time() == domain_2.get_time()
+
+    def test_active_cell_compaction_matches_full(self):
+        """Leaving dry cells away from water out of the kernels gives the
+        same results as looping over all cells
+        """
+
+        def topography(x,y):
+            return x/2.0 + 0.05*num.sin((x+y)*50.0)
+
+        def stagefun(x,y):
+            return 0.1*(x<0.2) + topography(x,y)*(x>=0.2)
+
+        def create_domain(flow_algorithm, multiprocessor_mode):
+            domain = self._create_riverwall_domain(flow_algorithm, multiprocessor_mode)
+            domain.set_quantity('elevation',topography,location='centroids')
+            domain.set_quantity('stage', stagefun,location='centroids')
+            domain.set_boundary({'left': anuga.Reflective_boundary(domain),
+                                 'right': anuga.Reflective_boundary(domain),
+                                 'top': anuga.Reflective_boundary(domain),
+                                 'bottom': anuga.Reflective_boundary(domain)})
+
+            # Rain on dry cells, changing them between timesteps
+            anuga.Rate_operator(domain, rate=0.1, center=(0.75, 0.5), radius=0.1)
+            return domain
+
+        for flow_algorithm, multiprocessor_mode, native_evolve in \
+                [('DE0', 0, False), ('DE1', 0, False), ('DE2', 0, False),
+                 ('DE1', 1, False), ('DE1', 0, True)]:
+            domain_1 = create_domain(flow_algorithm, multiprocessor_mode)
+            domain_2 = create_domain(flow_algorithm, multiprocessor_mode)
+            domain_2.set_active_cell_compaction(True)
+            for domain in [domain_1, domain_2]:
+                domain.set_native_evolve(native_evolve)
+
+            # Speeds of cells left out are cleared as well
+            domain_2.max_speed[:] = 1.0
+
+            self._assert_same_evolution(domain_1, domain_2)
+
+            for name in ['stage', 'xmomentum', 'ymomentum', 'elevation']:
+                Q_1 = domain_1.quantities[name]
+                Q_2 = domain_2.quantities[name]
+                assert num.all(Q_1.vertex_values == Q_2.vertex_values)
+
+            assert domain_1.get_number_of_active_cells() == 0
+            assert 0 < domain_2.get_number_of_active_cells() < len(domain_2)
+
+    def test_single_precision_vertex_output(self):
+        """Single precision vertex values of the evolved quantities are
+        the double precision ones rounded, and leave the evolution unchanged
+        """
+
+        for flow_algorithm, multiprocessor_mode, native_evolve in \
+                [('DE0', 0, False), ('DE1', 0, False), ('DE1', 1, False),
+                 ('DE1', 0, True)]:
+            domain_1 = self._create_riverwall_domain(flow_algorithm, multiprocessor_mode)
+            domain_2 = self._create_riverwall_domain(flow_algorithm, multiprocessor_mode)
+            domain_2.set_vertex_output_precision('single')
+            for domain in [domain_1, domain_2]:
+                domain.set_native_evolve(native_evolve)
+
+            assert domain_2.get_vertex_output_precision() == 'single'
+
+            self._assert_same_evolution(domain_1, domain_2)
+
+            for name in ['stage', 'xmomentum', 'ymomentum', 'height']:
+                Q_1 = domain_1.quantities[name]
+                Q_2 = domain_2.quantities[name]
+                assert Q_2.vertex_values.dtype == num.float32
+                assert num.all(Q_2.vertex_values == Q_1.vertex_values.astype(num.float32))
+
+                # The values the kernels work on stay double precision
+                assert Q_2.centroid_values.dtype == float
+                assert Q_2.edge_values.dtype == float
+
+            # Smoothed vertex values and setting values at the vertices
+            A_1, V_1 = domain_1.get_quantity('stage').get_vertex_values(xy=False, smooth=True)
+            A_2, V_2 = domain_2.get_quantity('stage').get_vertex_values(xy=False, smooth=True)
+            assert num.allclose(A_1, A_2)
+
+            domain_2.set_quantity('stage', expression='elevation + 0.25')
+            Q = domain_2.quantities['stage']
+            assert Q.vertex_values.dtype == num.float32
+            assert num.allclose(Q.centroid_values,
+                                domain_2.quantities['elevation'].centroid_values + 0.25)
+
+        # Only the DE kernels support single precision vertex output
+        domain_2.set_flow_algorithm('1_5')
+        assert domain_2.get_vertex_output_precision() == 'double'
+        assert domain_2.quantities['stage'].vertex_values.dtype == float
+
+        try:
+            domain_2.set_vertex_output_precision('single')
+        except Exception:
+            pass
+        else:
+            raise Exception('Single precision vertex output should need a DE algorithm')
+
+    def test_quantity_arena_matches_separate_arrays(self):
+        """Quantity arrays packed in one block give the same evolution
+        """
+
+        for policy, precision in [('quantity', 'double'), ('array', 'single')]:
+            domain_1 = self._create_riverwall_domain('DE1', 0)
+            domain_2 = self._create_riverwall_domain('DE1', 0)
+            domain_2.set_quantity_arena(policy)
+            for domain in [domain_1, domain_2]:
+                domain.set_vertex_output_precision(precision)
+
+            # Still in the block after changing the vertex values dtype
+            Q = domain_2.quantities['stage']
+            arena = domain_2.get_quantity_arena()
+            assert Q.vertex_values.ctypes.data == arena.base.ctypes.data + \
+                   arena.get_offset('stage', 'vertex_values')
+
+            self._assert_same_evolution(domain_1, domain_2)
+
+    def test_first_touch_arrays(self):
+        """Arrays reallocated from the OpenMP threads keep their values
+        and give the same evolution
+        """
+
+        for policy in [None, 'array']:
+            domain_1 = self._create_riverwall_domain('DE1', 1)
+            domain_2 = self._create_riverwall_domain('DE1', 1)
+            domain_2.set_quantity_arena(policy)
+
+            neighbours = domain_2.neighbours
+            stage = domain_2.quantities['stage'].centroid_values
+            domain_2.first_touch_arrays()
+
+            assert domain_2.neighbours is not neighbours
+            assert num.all(domain_2.neighbours == neighbours)
+            assert domain_2.mesh.neighbours is domain_2.neighbours
+            assert domain_2.mesh.edge_midpoint_coordinates is domain_2.edge_coordinates
+            assert domain_2.quantities['stage'].centroid_values is not stage
+            assert num.all(domain_2.quantities['stage'].centroid_values == stage)
+            if policy is not None:
+                arena = domain_2.get_quantity_arena()
+                assert domain_2.quantities['stage'].centroid_values.ctypes.data == \
+                       arena.base.ctypes.data + arena.get_offset('stage', 'centroid_values')
+
+            self._assert_same_evolution(domain_1, domain_2)
+
+    def test_kernel_timing(self):
+        """The evolve loop counts the calls of each of its steps and
+        writes the counts and times as JSON at each yield step
+        """
+
+        import json
+
+        filename = 'kernel_timing_de1.json'
+
+        for native_evolve in [False, True]:
+            domain = self._create_riverwall_domain('DE1', 0)
+            domain.set_native_evolve(native_evolve)
+            operator = anuga.Rate_operator(domain, rate=0.1, center=(0.25, 0.5), radius=0.1)
+            domain.set_kernel_timing_file(filename)
+
+            assert domain.get_timestepping_method() == 'rk2'
+
+            for t in domain.evolve(yieldstep=0.1, finaltime=0.3):
+                pass
+
+            timing = domain.get_kernel_timing()
+            steps = timing['timestep']['calls']
+            assert steps > 0
+
+            for name in ['flux', 'forcing', 'update']:
+                assert timing[name]['calls'] == 2*steps, name
+            for name in ['backup', 'saxpy', 'operator:' + operator.label]:
+                assert timing[name]['calls'] == steps, name
+            # Once more for the initial values and each yield step
+            for name in ['extrapolation', 'boundary']:
+                assert timing[name]['calls'] == 2*steps + 4, name
+            assert timing['protect']['calls'] >= timing['extrapolation']['calls']
+            for name in timing:
+                assert timing[name]['time'] >= 0.0
+
+            with open(filename) as fid:
+                data = json.load(fid)
+            os.remove(filename)
+
+            assert data['time'] == domain.get_time()
+            assert data['number_of_triangles'] == len(domain)
+            assert data['kernels'] == timing
+
+            assert 'flux' in domain.kernel_timing_statistics()
+
+            domain.reset_kernel_timing()
+            assert domain.get_kernel_timing() == {}
+
+    def test_lazy_vertex_values(self):
+        """Computing the vertex values only when they are accessed gives
+        the same vertex values as computing them every timestep
+        """
+
+        names = ['stage', 'xmomentum', 'ymomentum', 'height', 'elevation']
+
+        for flow_algorithm, multiprocessor_mode, native_evolve, precision in \
+                [('DE0', 0, False, 'double'), ('DE1', 0, False, 'double'),
+                 ('DE1', 1, False, 'double'), ('DE1', 0, True, 'double'),
+                 ('DE1', 0, False, 'single')]:
+            domain_1 = self._create_riverwall_domain(flow_algorithm, multiprocessor_mode)
+            domain_2 = self._create_riverwall_domain(flow_algorithm, multiprocessor_mode)
+            domain_2.set_lazy_vertex_values(True)
+            for domain in [domain_1, domain_2]:
+                domain.set_native_evolve(native_evolve)
+                domain.set_vertex_output_precision(precision)
+
+            domain_1.distribute_to_vertices_and_edges()
+            domain_2.distribute_to_vertices_and_edges()
+            Q = domain_2.quantities['stage']
+            assert Q.vertex_values_stale
+            assert num.all(Q.vertex_values == domain_1.quantities['stage'].vertex_values)
+            assert not Q.vertex_values_stale
+
+            self._assert_same_evolution(domain_1, domain_2)
+
+            for name in names:
+                Q_1 = domain_1.quantities[name]
+                Q_2 = domain_2.quantities[name]
+                assert num.all(Q_1.get_values(location='vertices') ==
+                               Q_2.get_values(location='vertices'))
+
+            # Switching back computes them every timestep again
+            domain_2.distribute_to_vertices_and_edges()
+            domain_2.set_lazy_vertex_values(False)
+            assert not domain_2.quantities['xmomentum'].vertex_values_stale
+            for domain in [domain_1, domain_2]:
+                for t in domain.evolve(yieldstep=0.1, duration=0.1):
+                    pass
+            for name in names:
+                assert num.all(domain_1.quantities[name].vertex_values ==
+                               domain_2.quantities[name].vertex_values)
+
+    def test_flux_update_frequency(self):
+        """Local flux updating gives the same results with the threaded
+        kernels, and when visiting only the triangles with a flux due
+        as when visiting all edges (edge based kernel). The statistics
+        count the skipped edge fluxes
+        """
+
+        def create_domain(multiprocessor_mode, edge_based_fluxes=False):
+            domain = self._create_riverwall_domain('DE0', multiprocessor_mode)
+            domain.set_quantity('stage', lambda x,y: -0.1 + 1.0*(x<0.3), location='centroids')
+            domain.set_local_extrapolation_and_flux_updating(nlevels=3)
+            domain.set_edge_based_fluxes(edge_based_fluxes)
+            return domain
+
+        domains = [create_domain(0), create_domain(1)]
+        self._assert_same_evolution(domains[0], domains[1])
+        self._assert_same_evolution(create_domain(0), create_domain(0, True))
+
+        for domain in domains:
+            assert 0 < domain.number_of_flux_update_cells[0] <= len(domain)
+            assert num.all(domain.flux_update_frequency == domains[0].flux_update_frequency)
+            assert num.all(domain.update_next_flux == domains[0].update_next_flux)
+            assert num.all(domain.update_extrapolation == domains[0].update_extrapolation)
+
+            # Every edge (counted from both sides) is in the histogram, and
+            # on this dam break some fluxes are updated less often than
+            # every timestep while those near the front are not
+            stats = domain.get_flux_update_statistics()
+            histogram = stats['histogram']
+            assert sum(histogram.values()) == 3*len(domain)
+            for frequency, count in histogram.items():
+                assert count == num.sum(domain.flux_update_frequency == frequency)
+            assert histogram[1] > 0
+            assert sum(count for frequency, count in histogram.items()
+                       if frequency > 1) > 0
+            assert 0.0 < stats['fraction_skipped'] < 1.0
+
+            domain.reset_flux_update_statistics()
+            assert domain.get_flux_update_statistics()['fraction_skipped'] == 0.0
+
+    def test_native_boundaries_match_python(self):
+        """Boundaries evaluated in C give the same boundary values and
+        evolution as their python evaluate_segment methods
+        """
+
+        def create_domain(native):
+            domain = self._create_riverwall_domain('DE1', 0)
+            domain.set_native_boundaries(native)
+
+            Br = anuga.Reflective_boundary(domain)
+            Bt = anuga.Transmissive_boundary(domain)
+            Bs = anuga.Time_boundary(domain, function=lambda t: [0.1*t, 0.0, 0.01])
+            # Outside stage below the bed, to use the wet cell formulae
+            Bf = anuga.Flather_external_stage_zero_velocity_boundary(domain,
+                                                    lambda t: -0.6 + 0.05*num.sin(t))
+            domain.set_boundary({'left': Br, 'right': Bf, 'top': Bs, 'bottom': Bt})
+            return domain
+
+        domain_1 = create_domain(False)
+        domain_2 = create_domain(True)
+
+        self._assert_same_evolution(domain_1, domain_2)
+
+        names = ['stage', 'xmomentum', 'ymomentum', 'elevation', 'height',
+                 'xvelocity', 'yvelocity']
+        for name in names:
+            Q_1 = domain_1.quantities[name]
+            Q_2 = domain_2.quantities[name]
+            assert num.all(Q_1.boundary_values == Q_2.boundary_values)
+
+        # Replacing a boundary rebuilds the index arrays
+        S = domain_2.boundary_structure
+        for domain in [domain_1, domain_2]:
+            domain.set_boundary({'top': anuga.Dirichlet_boundary([0.2, 0.0, 0.0]),
+                                 'bottom': anuga.Transmissive_stage_zero_momentum_boundary(domain)})
+            domain.update_boundary()
+
+        assert domain_2.boundary_structure is not S
+        assert domain_2.boundary_structure['python_tags'] == ['bottom']
+        for name in names:
+            Q_1 = domain_1.quantities[name]
+            Q_2 = domain_2.quantities[name]
+            assert num.all(Q_1.boundary_values == Q_2.boundary_values)
+
+    def test_mesh_ordering_matches_original(self):
+        """A domain built on a mesh renumbered along a space filling curve
+        evolves as the original domain, up to the permutation
+        """
+
+        def topography(x,y):
+            return -x/2.0 + 0.05*num.sin((x+y)*50.0)
+
+        def stagefun(x,y):
+            return -0.1 + 0.3*(x<0.5)
+
+        def create_domain(mesh_ordering):
+            points, vertices, boundary = anuga.rectangular_cross(20, 20, len1=1., len2=1.)
+            domain = Domain(points, vertices, boundary, mesh_ordering=mesh_ordering)
+            domain.set_flow_algorithm('DE1')
+            domain.set_name('mesh_ordering_de1')
+            domain.set_store(mesh_ordering is not None)
+            domain.set_quantity('elevation',topography,location='centroids')
+            domain.set_quantity('friction',0.03)
+            domain.set_quantity('stage', stagefun,location='centroids')
+            domain.set_boundary({'left': anuga.Reflective_boundary(domain),
+                                 'right': anuga.Dirichlet_boundary([0.0, 0.0, 0.0]),
+                                 'top': anuga.Reflective_boundary(domain),
+                                 'bottom': anuga.Reflective_boundary(domain)})
+            return domain
+
+        domain_1 = create_domain(None)
+        domain_2 = create_domain('hilbert')
+
+        tp = domain_2.get_triangle_permutation()
+        assert domain_1.triangle_permutation is None
+        assert not num.all(tp == num.arange(len(domain_1)))
+
+        for t in domain_1.evolve(yieldstep=0.1, finaltime=0.5):
+            pass
+
+        for t in domain_2.evolve(yieldstep=0.1, finaltime=0.5):
+            pass
+
+        for name in ['stage', 'xmomentum', 'ymomentum']:
+            Q_1 = domain_1.quantities[name]
+            Q_2 = domain_2.quantities[name]
+            assert num.allclose(Q_1.centroid_values[tp], Q_2.centroid_values)
+            assert num.allclose(Q_1.edge_values[tp], Q_2.edge_values)
+
+        assert num.allclose(domain_1.get_boundary_flux_integral(),
+                            domain_2.get_boundary_flux_integral())
+        assert domain_1.get_time() == domain_2.get_time()
+
+        # The sww file records the permutation
+        from anuga.file.netcdf import NetCDFFile
+        fid = NetCDFFile('mesh_ordering_de1.sww')
+        assert num.all(fid.variables['triangle_permutation'][:] == tp)
+        fid.close()
+        os.remove('mesh_ordering_de1.sww')
+
+    def test_ghost_exchange_overlap(self):
+        """Computing the cells away from the ghost cells during the ghost
+        exchange gives the same results as after it
+        """
+
+        from anuga.parallel.distribute_mesh import build_local_overlap_cells
+
+        class Deferred_exchange_domain(Domain):
+            """Ghost exchange which, like the non-blocking exchange of a
+            parallel domain, only writes the ghost cells when completed.
+            Until then the ghost centroids are NaN, so any use of them by
+            the interior cells shows up in the results.
+            """
+
+            pending = []
+
+            def post_ghost_exchange(self, quantities=None):
+
+                if quantities is None:
+                    quantities = self.conserved_quantities
+
+                Idf = self.full_send_dict[self.processor][0]
+                Idg = self.ghost_recv_dict[self.processor][0]
+
+                self.pending = []
+                for q in quantities:
+                    Q_cv = self.quantities[q].centroid_values
+                    self.pending.append((Q_cv, Q_cv[Idf].copy()))
+                    Q_cv[Idg] = num.nan
+
+            def complete_ghost_exchange(self):
+
+                Idg = self.ghost_recv_dict[self.processor][0]
+
+                for Q_cv, values in self.pending:
+                    Q_cv[Idg] = values
+                self.pending = []
+
+        def create_domain(flow_algorithm, multiprocessor_mode, domain_class=Domain):
+            points, vertices, boundary = anuga.rectangular_cross(20,20, len1=1., len2=1.)
+
+            # Ghost cells on the right, updated from full cells on the left
+            x = num.mean(num.array(points)[num.array(vertices), 0], axis=1)
+            ghost = num.flatnonzero(x > 0.85)
+            full = num.flatnonzero(x < 0.15)
+            assert len(ghost) == len(full)
+
+            domain = domain_class(points, vertices, boundary,
+                                  full_send_dict={0: [full, full]},
+                                  ghost_recv_dict={0: [ghost, ghost]})
+            domain.set_flow_algorithm(flow_algorithm)
+            domain.set_store(False)
+            domain.set_multiprocessor_mode(multiprocessor_mode)
+            domain.set_native_evolve(True)
+
+            domain.set_quantity('elevation', lambda x, y: -x/2.0 + 0.05*num.sin((x+y)*50.0),
+                                location='centroids')
+            domain.set_quantity('friction', 0.03)
+            domain.set_quantity('stage', lambda x, y: -0.1 + 0.3*(x < 0.5),
+                                location='centroids')
+
+            Br = anuga.Reflective_boundary(domain)
+            domain.set_boundary({'left': Br, 'right': Br, 'top': Br, 'bottom': Br})
+            return domain
+
+        domain = create_domain('DE1', 0)
+        interior_cells, boundary_cells = build_local_overlap_cells(domain.neighbours,
+            domain.number_of_boundaries, domain.tri_full_flag)
+        for interior, boundary in zip(interior_cells, boundary_cells):
+            assert len(interior) + len(boundary) == len(domain)
+        assert num.all(domain.tri_full_flag[interior_cells[0]] == 1)
+        assert num.all(domain.tri_full_flag[boundary_cells[0]] == 0)
+        assert 0 < len(interior_cells[4]) < len(interior_cells[3]) < len(interior_cells[0])
+
+        for flow_algorithm, multiprocessor_mode, timestepping_method in \
+                [('DE0', 0, 'euler'), ('DE1', 0, 'rk2'), ('DE1', 1, 'rk2'),
+                 ('DE1', 0, 'rk3')]:
+            domain_1 = create_domain(flow_algorithm, multiprocessor_mode)
+            domain_2 = create_domain(flow_algorithm, multiprocessor_mode,
+                                     Deferred_exchange_domain)
+            domain_2.set_ghost_exchange_overlap(True)
+            for domain in [domain_1, domain_2]:
+                domain.set_timestepping_method(timestepping_method)
+
+            self._assert_same_evolution(domain_1, domain_2)
+            assert not num.any(num.isnan(domain_2.quantities['stage'].centroid_values))
+
+            # The protection is split in two with the overlap
+            calls_1 = domain_1.get_kernel_timing()['protect']['calls']
+            calls_2 = domain_2.get_kernel_timing()['protect']['calls']
+            assert calls_2 > calls_1
+
+    def test_concurrent_domains(self):
+        """Domains with different timestepping methods evolved at the same
+        time, interleaved step by step or in separate threads, should
+        give the same results as when evolved on their own
+        """
+
+        import threading
+
+        def evolve(domain):
+            for t in domain.evolve(yieldstep=0.1, finaltime=0.5):
+                pass
+
+        # Flow algorithm and flux updating levels (only for euler timestepping)
+        setups = [('DE0', 2), ('DE0', 2), ('DE1', 0), ('DE2', 0)]
+
+        def create_domains():
+            domains = []
+            for flow_algorithm, nlevels in setups:
+                domain = self._create_riverwall_domain(flow_algorithm, 0)
+                domain.set_local_extrapolation_and_flux_updating(nlevels=nlevels)
+                domains.append(domain)
+            return domains
+
+        domains_alone = create_domains()
+        for domain in domains_alone:
+            evolve(domain)
+
+        # Interleave the evolve generators
+        domains_interleaved = create_domains()
+        evolvers = [domain.evolve(yieldstep=0.1, finaltime=0.5) for domain in domains_interleaved]
+        finished = False
+        while not finished:
+            finished = True
+            for evolver in evolvers:
+                for t in evolver:
+                    finished = False
+                    break
+
+        # And in threads, which release the GIL in the C kernels
+        domains_threaded = create_domains()
+        threads = [threading.Thread(target=evolve, args=(domain,)) for domain in domains_threaded]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        for domain_alone, domain_interleaved, domain_threaded in \
+                zip(domains_alone, domains_interleaved, domains_threaded):
+            for name in ['stage', 'xmomentum', 'ymomentum']:
+                Q = domain_alone.quantities[name].centroid_values
+                assert num.all(Q == domain_interleaved.quantities[name].centroid_values)
+                assert num.all(Q == domain_threaded.quantities[name].centroid_values)
+            assert domain_alone.get_time() == domain_threaded.get_time()
+
+
 if __name__ == "__main__":
     suite = unittest.makeSuite(Test_DE1_domain, 'test')
     runner = unittest.TextTestRunner(verbosity=1)
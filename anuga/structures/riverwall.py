@@ -98,6 +98,9 @@ class RiverWall(object):
 
             riverwall_edges -- Holds indices of edges in domain which are riverwalls, ordered like riverwall_elevation
 
+            riverwall_index -- For every edge in the domain, the index of that edge in riverwall_elevation
+                               (and hydraulic_properties_rowIndex), or -1 if the edge is not a riverwall
+
             names -- list with the names of the riverwalls
                      len = number of riverwalls which cover edges in the domain
 
@@ -148,6 +151,10 @@ class RiverWall(object):
         #    len = number of riverwall edges in the domain
         self.riverwall_edges=numpy.array([default_int])
 
+        # Variable to hold the riverwall_elevation index of every edge
+        #    len = number of edges in the domain
+        self.riverwall_index=numpy.zeros(len(domain.edge_flux_type), int) - 1
+
         # Input info
         self.input_riverwall_geo=None
         self.input_riverwallPar=None
@@ -402,6 +409,11 @@ class RiverWall(object):
             riverwall_rowIndex[riverwallInds].astype(int)
         # index of edges which are riverwalls 
         self.riverwall_edges=riverwallInds
+        # riverwall_elevation index of every edge
+        self.riverwall_index[:]=-1
+        self.riverwall_index[riverwallInds]=numpy.arange(len(riverwallInds))
+        # The edge based flux layout caches riverwall indices, so rebuild it
+        domain.edge_structure=None
 
         # Record the names of the riverwalls
         self.names=nw_names
@@ -459,6 +471,9 @@ class RiverWall(object):
        
         # Define the hydraulic properties 
         self.hydraulic_properties=hydraulicTmp
+
+        # The C kernels cache pointers to the riverwall arrays
+        domain.invalidate_domain_struct()
       
         # Check for riverwall 'connectedness' errors (e.g. theoretically possible
         # to miss an edge due to round-off)
@@ -74,7 +74,30 @@ except:
   def send_recv_via_dicts(*args, **kwargs):
       pass
 
+  def send_recv_init(*args, **kwargs):
+      return []
+
+  def startall(*args, **kwargs):
+      pass
+
+  def waitall(*args, **kwargs):
+      pass
+
+  def iallreduce(*args, **kwargs):
+      pass
+
+  def wait(*args, **kwargs):
+      pass
+
+  def create_op(*args, **kwargs):
+      pass
+
+  def free_op(*args, **kwargs):
+      pass
+
   MIN = None
+  SUM = None
+  MAX = None
 
   pypar_available = False
   mpiWrapper = None
@@ -135,6 +158,26 @@ else:
   def allreduce(sendbuf, op, buffer=None, vanilla=0, bypass=False):
     return comm.Allreduce(sendbuf, buffer, op=op)
 
+  def iallreduce(sendbuf, op, buffer):
+    """ Non-blocking allreduce of sendbuf into buffer, returns the
+        request to pass to wait
+    """
+    return comm.Iallreduce(sendbuf, buffer, op=op)
+
+  def wait(request):
+    request.Wait()
+
+  def create_op(function, commute=True):
+    """ User defined reduction operation, function(inbuf, outbuf,
+        datatype) combines inbuf into outbuf
+    """
+    return MPI.Op.Create(function, commute=commute)
+
+  def free_op(op):
+    """ Free an operation of create_op
+    """
+    op.Free()
+
   def broadcast(buffer, root, vanilla=False, bypass=False):
     """ Uses numpy array Bcast if bypass is True
     """
@@ -273,6 +316,40 @@ else:
       comm.Sendrecv(np.ascontiguousarray(sendBuf), key, 123,
         recvBuf, key, 123)
 
+  def send_recv_init(sendDict, recvDict):
+    """ Persistent requests (MPI_Recv_init and MPI_Send_init) for
+        exchanging the contiguous numpy arrays in recvDict and sendDict,
+        keyed by the process to receive from and send to. The arrays
+        must stay in place while the requests are used. Start the
+        exchange with startall and complete it with waitall.
+    """
+
+    skeys = list(sendDict.keys())
+    skeys.sort()
+    rkeys = list(recvDict.keys())
+    rkeys.sort()
+    assert rkeys == skeys
+
+    requests = []
+    for key in rkeys:
+      requests.append(comm.Recv_init(recvDict[key], key, 123))
+    for key in skeys:
+      requests.append(comm.Send_init(sendDict[key], key, 123))
+
+    return requests
+
+  def startall(requests):
+    """ Start the persistent requests of send_recv_init
+    """
+
+    MPI.Prequest.Startall(requests)
+
+  def waitall(requests):
+    """ Wait for the started requests of send_recv_init to complete
+    """
+
+    MPI.Request.Waitall(requests)
+
   numprocs = size()
   myid = rank()
 
@@ -0,0 +1,101 @@
+// Hardware performance counters read through the perf_event_open system
+// call (Linux only), used by Kernel_profiler to count cycles, instructions
+// and last level cache misses of the kernels of the evolve loop.
+//
+// The counters count user space events of the calling thread and of the
+// threads it creates after the counters are opened (inherit), so open them
+// before the first OpenMP parallel region to include the OpenMP threads.
+// Counts are scaled up if the kernel had to multiplex the counters.
+//
+// The file descriptors of a set of counters are held by the caller (one
+// set per Kernel_profiler), so each set is opened and closed independently.
+
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define NUMBER_OF_PERF_COUNTERS 3
+
+// Close the counters of fds (if open) and mark them closed (-1)
+void _close_perf_counters(int* fds) {
+
+  int i;
+
+  for (i = 0; i < NUMBER_OF_PERF_COUNTERS; i++) {
+#if defined(__linux__)
+    if (fds[i] >= 0) close(fds[i]);
+#endif
+    fds[i] = -1;
+  }
+}
+
+// Open the cycle, instruction and cache miss counters into fds. Returns 0,
+// or the errno of the failing perf_event_open call (ENOSYS if not on Linux)
+int _open_perf_counters(int* fds) {
+
+#if defined(__linux__)
+  uint64_t configs[NUMBER_OF_PERF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES,
+                                               PERF_COUNT_HW_INSTRUCTIONS,
+                                               PERF_COUNT_HW_CACHE_MISSES};
+  struct perf_event_attr attr;
+  int i, err;
+
+  _close_perf_counters(fds);
+
+  for (i = 0; i < NUMBER_OF_PERF_COUNTERS; i++) {
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[i];
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    fds[i] = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fds[i] < 0) {
+      err = errno;
+      _close_perf_counters(fds);
+      return err;
+    }
+  }
+
+  return 0;
+#else
+  _close_perf_counters(fds);
+  return ENOSYS;
+#endif
+}
+
+// Current value of each counter. Returns 0, or -1 if the counters are not
+// open or could not be read
+int _read_perf_counters(int* fds, int64_t* values) {
+
+#if defined(__linux__)
+  uint64_t buffer[3];
+  int i;
+
+  for (i = 0; i < NUMBER_OF_PERF_COUNTERS; i++) {
+    if (fds[i] < 0) return -1;
+    if (read(fds[i], buffer, sizeof(buffer)) != sizeof(buffer)) return -1;
+
+    // buffer holds the value, time enabled and time running
+    if (buffer[2] > 0 && buffer[2] < buffer[1]) {
+      values[i] = (int64_t) ((double) buffer[0] * buffer[1] / buffer[2]);
+    } else {
+      values[i] = (int64_t) buffer[0];
+    }
+  }
+
+  return 0;
+#else
+  return -1;
+#endif
+}
@@ -0,0 +1,59 @@
+#cython: wraparound=False, boundscheck=False, cdivision=True, profile=False, nonecheck=False, overflowcheck=False, cdivision_warnings=False, unraisable_tracebacks=False
+import cython
+
+import os
+
+from libc.stdint cimport int64_t
+
+# declare the interface to the C code
+cdef extern from "perf_counters.c":
+    int _open_perf_counters(int* fds)
+    void _close_perf_counters(int* fds)
+    int _read_perf_counters(int* fds, int64_t* values)
+
+# Order of the values returned by Perf_counters.read
+perf_counter_names = ['cycles', 'instructions', 'llc_misses']
+
+cdef class Perf_counters:
+    """One set of the hardware counters of perf_counter_names, counting
+    the thread that opened them and the threads it creates afterwards.
+    Each set is independent of the others, and is closed by close() or
+    when it is garbage collected.
+    """
+
+    cdef int fds[3]
+
+    def __cinit__(self):
+
+        self.fds[0] = self.fds[1] = self.fds[2] = -1
+
+    def __init__(self):
+        """Open the counters, raises OSError if the system does not allow
+        it (e.g. not Linux, or /proc/sys/kernel/perf_event_paranoid too
+        high, or inside a container)
+        """
+
+        cdef int err
+
+        err = _open_perf_counters(self.fds)
+        if err != 0:
+            raise OSError(err, 'perf_event_open: ' + os.strerror(err))
+
+    def __dealloc__(self):
+
+        _close_perf_counters(self.fds)
+
+    def close(self):
+
+        _close_perf_counters(self.fds)
+
+    def read(self):
+        """Tuple of the current values of the counters of perf_counter_names
+        """
+
+        cdef int64_t values[3]
+
+        if _read_perf_counters(self.fds, values) != 0:
+            raise OSError('Hardware performance counters are not open')
+
+        return (values[0], values[1], values[2])
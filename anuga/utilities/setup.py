@@ -38,6 +38,9 @@ def configuration(parent_package='',top_path=None):
 
     config.add_extension('quad_tree_ext',
                          sources=['quad_tree_ext.pyx'])
+
+    config.add_extension('perf_counters_ext',
+                         sources=['perf_counters_ext.pyx'])
     
     config.ext_modules = cythonize(config.ext_modules,annotate=True)
 
@@ -0,0 +1,242 @@
+"""
+Benchmark the shallow water solver on rectangular_cross_domain meshes.
+
+For each mesh size and flow algorithm a dam break on the unit square is
+evolved for a fixed number of timesteps, in a separate process so that
+the peak memory use of each run is measured on its own. The timestep is
+fixed (through evolve_max_timestep, well below the CFL limit) so that
+every run takes the same number of steps with the same timestep.
+
+For each run the results file records steps per second, cells times
+steps per second, peak resident set size and the kernel timing of the
+evolve loop (see Domain.get_kernel_timing), together with a description
+of the machine and of the anuga build.
+
+Given the results file of an earlier run (--baseline), runs whose cell
+steps per second dropped, or whose peak memory grew, by more than the
+tolerance are reported as regressions and the exit status is 1.
+
+Usage:
+
+  python run_benchmarks.py [--sizes 10000 100000 ...]
+                           [--algorithms DE0 DE1 ...] [--steps 20]
+                           [--multiprocessor_mode 0]
+                           [--output results.json]
+                           [--baseline baseline.json] [--tolerance 0.1]
+
+The default sizes are 10k, 100k, 1M and 10M triangles. The number of
+triangles of rectangular_cross_domain(n, n) is 4*n*n, so the actual
+sizes are the nearest of those.
+"""
+
+import os
+import sys
+import json
+import time
+import platform
+import argparse
+import subprocess
+
+
+default_sizes = [10000, 100000, 1000000, 10000000]
+default_algorithms = ['DE0', 'DE1', 'DE1_7', '2_0', 'tsunami']
+
+
+def run_worker(flow_algorithm, n, steps, multiprocessor_mode):
+    """Evolve a dam break on rectangular_cross_domain(n, n) for the
+    given number of steps and return the results as a dictionary
+    """
+
+    import resource
+    import anuga
+    from anuga.config import g
+
+    t0 = time.time()
+
+    domain = anuga.rectangular_cross_domain(n, n)
+    domain.set_flow_algorithm(flow_algorithm)
+    domain.set_multiprocessor_mode(multiprocessor_mode)
+    domain.set_store(False)
+
+    domain.set_quantity('elevation', 0.0)
+    domain.set_quantity('friction', 0.0)
+    domain.set_quantity('stage', lambda x, y: 0.5 + 0.5*(x < 0.5))
+
+    Br = anuga.Reflective_boundary(domain)
+    domain.set_boundary({'left': Br, 'right': Br, 'top': Br, 'bottom': Br})
+
+    # Well below the CFL limit for the triangles' inscribed radius
+    # (1/n/(2 + sqrt(8))) and wave speed (sqrt(g h) plus flow speed)
+    timestep = 0.1/n/(2.0 + 8.0**0.5)/(2.0*(g*1.0)**0.5)
+    domain.set_evolve_max_timestep(timestep)
+
+    setup_time = time.time() - t0
+
+    # The initial yield happens before any steps are taken
+    evolve = domain.evolve(yieldstep=steps*timestep, finaltime=steps*timestep)
+    next(evolve)
+
+    domain.reset_kernel_timing()
+    t0 = time.time()
+    for t in evolve:
+        pass
+    evolve_time = time.time() - t0
+
+    number_of_steps = domain.number_of_steps
+    number_of_triangles = len(domain)
+
+    # ru_maxrss is in kilobytes on linux, bytes on macOS
+    peak_rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    if sys.platform != 'darwin':
+        peak_rss *= 1024
+
+    return {'flow_algorithm': flow_algorithm,
+            'number_of_triangles': number_of_triangles,
+            'steps': number_of_steps,
+            'timestep': timestep,
+            'multiprocessor_mode': multiprocessor_mode,
+            'setup_time': setup_time,
+            'evolve_time': evolve_time,
+            'steps_per_second': number_of_steps/evolve_time,
+            'cell_steps_per_second': number_of_triangles*number_of_steps/evolve_time,
+            'peak_rss': peak_rss,
+            'kernels': domain.get_kernel_timing()}
+
+
+def get_machine():
+    """Description of the machine and anuga build the benchmarks ran on
+    """
+
+    import numpy
+    import anuga
+
+    machine = {'platform': platform.platform(),
+               'processor': platform.processor(),
+               'cpu_count': os.cpu_count(),
+               'python': platform.python_version(),
+               'numpy': numpy.__version__,
+               'anuga': anuga.__version__,
+               'git_sha': anuga.__git_sha__,
+               'omp_num_threads': os.environ.get('OMP_NUM_THREADS')}
+
+    try:
+        with open('/proc/cpuinfo') as fid:
+            for line in fid:
+                if line.startswith('model name'):
+                    machine['processor'] = line.split(':', 1)[1].strip()
+                    break
+    except IOError:
+        pass
+
+    return machine
+
+
+def run_benchmarks(sizes, algorithms, steps, multiprocessor_mode, verbose=True):
+    """Run each benchmark in its own process, returns list of results
+    """
+
+    results = []
+    for size in sizes:
+        n = max(1, int(round((size/4.0)**0.5)))
+        for flow_algorithm in algorithms:
+            cmd = [sys.executable, os.path.abspath(__file__), '--worker',
+                   flow_algorithm, str(n), str(steps), str(multiprocessor_mode)]
+            output = subprocess.check_output(cmd)
+            result = json.loads(output.decode().strip().splitlines()[-1])
+            results.append(result)
+
+            if verbose:
+                print('%-10s %10d %8d %12.2f %16.4e %10.1f' %
+                      (flow_algorithm, result['number_of_triangles'],
+                       result['steps'], result['steps_per_second'],
+                       result['cell_steps_per_second'],
+                       result['peak_rss']/1.0e6))
+                sys.stdout.flush()
+
+    return results
+
+
+def compare_with_baseline(results, baseline, tolerance):
+    """List of messages for the results which are more than tolerance
+    (relative) slower, or use more than tolerance more memory, than the
+    matching baseline results
+    """
+
+    key = lambda r: (r['flow_algorithm'], r['number_of_triangles'],
+                     r['multiprocessor_mode'])
+    baseline_results = dict((key(r), r) for r in baseline['results'])
+
+    regressions = []
+    for result in results:
+        base = baseline_results.get(key(result))
+        if base is None:
+            continue
+
+        name = '%s with %d triangles' % (result['flow_algorithm'],
+                                         result['number_of_triangles'])
+
+        ratio = result['cell_steps_per_second']/base['cell_steps_per_second']
+        if ratio < 1.0 - tolerance:
+            regressions.append('%s: %.4e cell steps/s, baseline %.4e (%.1f%%)' %
+                               (name, result['cell_steps_per_second'],
+                                base['cell_steps_per_second'],
+                                100.0*(ratio - 1.0)))
+
+        ratio = float(result['peak_rss'])/base['peak_rss']
+        if ratio > 1.0 + tolerance:
+            regressions.append('%s: peak RSS %.1f MB, baseline %.1f MB (+%.1f%%)' %
+                               (name, result['peak_rss']/1.0e6,
+                                base['peak_rss']/1.0e6, 100.0*(ratio - 1.0)))
+
+    return regressions
+
+
+if __name__ == '__main__':
+
+    if len(sys.argv) > 1 and sys.argv[1] == '--worker':
+        flow_algorithm = sys.argv[2]
+        n, steps, multiprocessor_mode = [int(arg) for arg in sys.argv[3:6]]
+        print(json.dumps(run_worker(flow_algorithm, n, steps, multiprocessor_mode)))
+        sys.exit(0)
+
+    parser = argparse.ArgumentParser(description='Benchmark the anuga shallow water solver')
+    parser.add_argument('--sizes', type=int, nargs='+', default=default_sizes,
+                        help='approximate numbers of triangles')
+    parser.add_argument('--algorithms', nargs='+', default=default_algorithms,
+                        help='flow algorithms')
+    parser.add_argument('--steps', type=int, default=20,
+                        help='number of timesteps of each run')
+    parser.add_argument('--multiprocessor_mode', type=int, default=0,
+                        help='0: serial C kernels, 1: OpenMP threaded C kernels')
+    parser.add_argument('--output', default='benchmark_results.json',
+                        help='results file')
+    parser.add_argument('--baseline', default=None,
+                        help='results file to compare with')
+    parser.add_argument('--tolerance', type=float, default=0.1,
+                        help='relative slow down or memory growth reported as regression')
+    args = parser.parse_args()
+
+    print('%-10s %10s %8s %12s %16s %10s' % ('algorithm', 'triangles', 'steps',
+                                             'steps/s', 'cell steps/s',
+                                             'RSS (MB)'))
+
+    results = run_benchmarks(args.sizes, args.algorithms, args.steps,
+                             args.multiprocessor_mode)
+
+    with open(args.output, 'w') as fid:
+        json.dump({'machine': get_machine(),
+                   'date': time.strftime('%Y-%m-%d %H:%M:%S'),
+                   'results': results}, fid, indent=2, sort_keys=True)
+    print('Results written to %s' % args.output)
+
+    if args.baseline is not None:
+        with open(args.baseline) as fid:
+            baseline = json.load(fid)
+
+        regressions = compare_with_baseline(results, baseline, args.tolerance)
+        for msg in regressions:
+            print('REGRESSION ' + msg)
+
+        if regressions:
+            sys.exit(1)
+        print('No regressions against %s' % args.baseline)
@@ -0,0 +1,78 @@
+"""Measure the per call overhead of the DE C kernel wrappers.
+
+   Each wrapper used to build the C domain structure from the python
+   domain on every call. The structure is now cached on the domain and
+   only the scalar parameters are refreshed. This script times the
+   kernels called from one DE timestep, with the cached structure and
+   with the structure rebuilt on every call (by invalidating the cache
+   before each call), for a range of mesh sizes.
+
+   Usage:
+
+     python run_domain_struct_benchmark.py [number_of_calls]
+"""
+from __future__ import print_function
+from __future__ import division
+
+import sys
+import time
+
+import anuga
+from anuga.shallow_water import swDE1_domain_ext as ext
+
+
+def create_domain(n):
+    domain = anuga.rectangular_cross_domain(n, n, len1=1.0, len2=1.0)
+    domain.set_flow_algorithm('DE0')
+    domain.set_quantity('elevation', lambda x, y: -x/2.0)
+    domain.set_quantity('stage', expression='elevation + 0.2')
+    domain.set_boundary({'left': anuga.Reflective_boundary(domain),
+                         'right': anuga.Reflective_boundary(domain),
+                         'top': anuga.Reflective_boundary(domain),
+                         'bottom': anuga.Reflective_boundary(domain)})
+    domain.distribute_to_vertices_and_edges()
+    domain.update_boundary()
+    return domain
+
+
+def time_calls(domain, number_of_calls, cached):
+
+    t0 = time.time()
+    for i in range(number_of_calls):
+        if not cached:
+            domain.invalidate_domain_struct()
+        ext.extrapolate_second_order_edge_sw(domain)
+        if not cached:
+            domain.invalidate_domain_struct()
+        ext.compute_fluxes_ext_central(domain, 1.0)
+        if not cached:
+            domain.invalidate_domain_struct()
+        ext.protect_new(domain)
+    return (time.time() - t0)/(3*number_of_calls)
+
+
+def run_benchmark(number_of_calls=1000, sizes=(2, 8, 32, 64)):
+
+    print('%10s %15s %15s %15s' % ('triangles', 'rebuilt (us)',
+                                   'cached (us)', 'saved (us)'))
+    for n in sizes:
+        domain = create_domain(n)
+
+        # Warm up both paths
+        time_calls(domain, 10, False)
+        time_calls(domain, 10, True)
+
+        rebuilt = time_calls(domain, number_of_calls, False)
+        cached = time_calls(domain, number_of_calls, True)
+
+        print('%10d %15.2f %15.2f %15.2f' % (len(domain), 1.0e6*rebuilt,
+                                             1.0e6*cached,
+                                             1.0e6*(rebuilt - cached)))
+
+
+if __name__ == '__main__':
+
+    if len(sys.argv) > 1:
+        run_benchmark(int(sys.argv[1]))
+    else:
+        run_benchmark()
@@ -0,0 +1,117 @@
+"""Measure the memory bandwidth of the threaded quantity kernels with
+   the arrays placed by the master thread and by first_touch_arrays.
+
+   A worker process is run for each NUMA node (socket), bound to the
+   cpus of that node with one OpenMP thread per cpu, and once more for
+   all cpus of the machine. Each worker creates a domain, with or without
+   numa_first_touch, and times saxpy_quantities on the conserved
+   quantities, which streams the centroid and backup values of each
+   quantity (24 bytes per triangle per quantity). The reported bandwidth
+   counts those bytes only.
+
+   On a machine with several sockets, the rows for all cpus show the
+   effect of first touch placement: with the arrays placed by the master
+   thread every thread reads the memory of the master's socket.
+
+   Usage:
+
+     python run_first_touch_benchmark.py [n] [number_of_calls]
+
+   The domain has 4*n*n triangles (default n = 1000).
+"""
+from __future__ import print_function
+from __future__ import division
+
+import os
+import sys
+import glob
+import subprocess
+
+
+def parse_cpulist(cpulist):
+    """Cpus of a linux cpulist such as 0-3,8-11"""
+
+    cpus = []
+    for part in cpulist.strip().split(','):
+        if '-' in part:
+            first, last = part.split('-')
+            cpus.extend(range(int(first), int(last) + 1))
+        elif part:
+            cpus.append(int(part))
+    return cpus
+
+
+def get_numa_nodes():
+    """List of (node name, cpus) for each NUMA node with cpus"""
+
+    nodes = []
+    for path in sorted(glob.glob('/sys/devices/system/node/node[0-9]*')):
+        with open(os.path.join(path, 'cpulist')) as fid:
+            cpus = parse_cpulist(fid.read())
+        if cpus:
+            nodes.append((os.path.basename(path), cpus))
+    return nodes
+
+
+def run_worker(n, number_of_calls, first_touch):
+    """Time saxpy_quantities, return bandwidth in GB/s"""
+
+    import time
+    import anuga
+    from anuga.abstract_2d_finite_volumes.quantity_ext import saxpy_quantities
+
+    anuga.config.numa_first_touch = first_touch
+    domain = anuga.rectangular_cross_domain(n, n)
+    domain.set_multiprocessor_mode(1)
+    domain.set_quantity('stage', 1.0)
+    domain.backup_conserved_quantities()
+
+    saxpy_quantities(domain, 0.5, 0.5)
+    t0 = time.time()
+    for i in range(number_of_calls):
+        saxpy_quantities(domain, 0.5, 0.5)
+    elapsed = (time.time() - t0)/number_of_calls
+
+    nbytes = 24*len(domain)*len(domain.conserved_quantities)
+    return nbytes/elapsed/1.0e9
+
+
+def run_benchmark(n=1000, number_of_calls=20):
+
+    nodes = get_numa_nodes()
+    all_cpus = sorted(os.sched_getaffinity(0)) if hasattr(os, 'sched_getaffinity') else []
+    setups = []
+    if len(nodes) > 1:
+        setups.extend(nodes)
+    setups.append(('all', all_cpus))
+
+    print('%10s %7s %22s %22s' % ('cpus', 'threads', 'master placed (GB/s)',
+                                  'first touch (GB/s)'))
+    for name, cpus in setups:
+        bandwidth = []
+        for first_touch in [0, 1]:
+            env = dict(os.environ)
+            if cpus:
+                env['OMP_NUM_THREADS'] = str(len(cpus))
+            env.setdefault('OMP_PROC_BIND', 'close')
+            cmd = [sys.executable, __file__, '--worker', str(n),
+                   str(number_of_calls), str(first_touch),
+                   ','.join(str(cpu) for cpu in cpus)]
+            output = subprocess.check_output(cmd, env=env)
+            bandwidth.append(float(output.split()[-1]))
+
+        print('%10s %7d %22.2f %22.2f' % (name, len(cpus), bandwidth[0],
+                                          bandwidth[1]))
+
+
+if __name__ == '__main__':
+
+    if len(sys.argv) > 1 and sys.argv[1] == '--worker':
+        n, number_of_calls, first_touch = [int(arg) for arg in sys.argv[2:5]]
+        # Bind before the OpenMP runtime starts its threads
+        if len(sys.argv) > 5 and sys.argv[5]:
+            os.sched_setaffinity(0, parse_cpulist(sys.argv[5]))
+        print(run_worker(n, number_of_calls, bool(first_touch)))
+    else:
+        args = [int(arg) for arg in sys.argv[1:3]]
+        run_benchmark(*args)
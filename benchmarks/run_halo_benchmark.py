@@ -0,0 +1,152 @@
+"""
+Benchmark ghost layer widths and ghost exchange periods of parallel runs.
+
+A dam break on rectangular_cross_domain is distributed with each ghost
+layer width k (the parameters of distribute) and evolved for a fixed
+number of timesteps with each ghost exchange period m (see
+Domain.set_ghost_exchange_period). Deeper layers cost redundant
+computation of the ghost cells, rarer exchanges save the latency of the
+exchanges, so the best k and m depend on the machine, the number of
+processors and the mesh size.
+
+Combinations which the layer width cannot support (k smaller than
+2*substeps*m) are skipped. For each run the results file records steps
+per second, the number of ghost exchanges, the communication time and the
+kernel timing of processor 0, together with a description of the machine
+(see run_benchmarks.py).
+
+Usage:
+
+  mpiexec -np 8 python run_halo_benchmark.py [--size 1000000]
+                           [--widths 2 4 8] [--periods 1 2 4]
+                           [--algorithm DE1] [--steps 40]
+                           [--output halo_results.json]
+"""
+
+import sys
+import json
+import time
+import argparse
+
+from run_benchmarks import get_machine
+
+
+def run_halo(n, algorithm, ghost_layer_width, ghost_exchange_period, steps):
+    """Evolve a dam break on rectangular_cross_domain(n, n) distributed
+    with the given ghost layer width and exchange period, returns the
+    results of this processor as a dictionary
+    """
+
+    import anuga
+    from anuga import distribute, myid, barrier
+    from anuga.config import g
+
+    if myid == 0:
+        domain = anuga.rectangular_cross_domain(n, n)
+        domain.set_flow_algorithm(algorithm)
+        domain.set_quantity('elevation', 0.0)
+        domain.set_quantity('friction', 0.0)
+        domain.set_quantity('stage', lambda x, y: 0.5 + 0.5*(x < 0.5))
+    else:
+        domain = None
+
+    domain = distribute(domain, parameters={'ghost_layer_width': ghost_layer_width})
+    domain.set_ghost_exchange_period(ghost_exchange_period)
+    domain.set_store(False)
+
+    Br = anuga.Reflective_boundary(domain)
+    domain.set_boundary({'left': Br, 'right': Br, 'top': Br, 'bottom': Br})
+
+    # Fixed timestep as in run_benchmarks.py
+    timestep = 0.1/n/(2.0 + 8.0**0.5)/(2.0*(g*1.0)**0.5)
+    domain.set_evolve_max_timestep(timestep)
+
+    evolve = domain.evolve(yieldstep=steps*timestep, finaltime=steps*timestep)
+    next(evolve)
+
+    domain.reset_kernel_timing()
+    domain.communication_time = 0.0
+    domain.communication_reduce_time = 0.0
+
+    barrier()
+    t0 = time.time()
+    for t in evolve:
+        pass
+    barrier()
+    evolve_time = time.time() - t0
+
+    kernels = domain.get_kernel_timing()
+    exchanges = kernels.get('ghost_exchange', {}).get('calls', 0)
+
+    return {'flow_algorithm': algorithm,
+            'number_of_triangles': 4*n*n,
+            'number_of_local_triangles': len(domain),
+            'ghost_layer_width': ghost_layer_width,
+            'ghost_exchange_period': ghost_exchange_period,
+            'steps': domain.number_of_steps,
+            'evolve_time': evolve_time,
+            'steps_per_second': domain.number_of_steps/evolve_time,
+            'ghost_exchanges': exchanges,
+            'communication_time': domain.communication_time,
+            'communication_reduce_time': domain.communication_reduce_time,
+            'kernels': kernels}
+
+
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser(description='Benchmark ghost layer widths and exchange periods')
+    parser.add_argument('--size', type=int, default=1000000,
+                        help='approximate number of triangles')
+    parser.add_argument('--widths', type=int, nargs='+', default=[2, 4, 8],
+                        help='ghost layer widths')
+    parser.add_argument('--periods', type=int, nargs='+', default=[1, 2, 4],
+                        help='ghost exchange periods')
+    parser.add_argument('--algorithm', default='DE1',
+                        help='flow algorithm')
+    parser.add_argument('--steps', type=int, default=40,
+                        help='number of timesteps of each run')
+    parser.add_argument('--output', default='halo_results.json',
+                        help='results file')
+    args = parser.parse_args()
+
+    import anuga
+    from anuga import myid, numprocs, finalize
+
+    substeps = {'DE0': 1, 'DE1': 2, 'DE1_7': 3}.get(args.algorithm, 2)
+    n = max(1, int(round((args.size/4.0)**0.5)))
+
+    if myid == 0:
+        print('%d processors, %s, %d triangles' % (numprocs, args.algorithm, 4*n*n))
+        print('%6s %6s %12s %10s %12s' % ('width', 'period', 'steps/s',
+                                          'exchanges', 'comm (s)'))
+
+    results = []
+    for k in args.widths:
+        for m in args.periods:
+            if k < 2*substeps*m and m > 1:
+                continue
+
+            result = run_halo(n, args.algorithm, k, m, args.steps)
+            results.append(result)
+
+            if myid == 0:
+                print('%6d %6d %12.2f %10d %12.4f' %
+                      (k, m, result['steps_per_second'],
+                       result['ghost_exchanges'], result['communication_time']))
+                sys.stdout.flush()
+
+    if myid == 0:
+        best = max(results, key=lambda r: r['steps_per_second'])
+        print('Fastest: ghost_layer_width %d, ghost_exchange_period %d' %
+              (best['ghost_layer_width'], best['ghost_exchange_period']))
+
+        machine = get_machine()
+        machine['numprocs'] = numprocs
+
+        with open(args.output, 'w') as fid:
+            json.dump({'machine': machine,
+                       'date': time.strftime('%Y-%m-%d %H:%M:%S'),
+                       'results': results}, fid, indent=2, sort_keys=True)
+        print('Results written to %s' % args.output)
+
+    finalize()
@@ -0,0 +1,148 @@
+"""
+Compare the results of analytical_exact validation tests run with the
+vertex values of the evolved quantities kept in double and in single
+precision (see Domain.set_vertex_output_precision).
+
+Each numerical_*.py script is run twice, in a copy of its directory.
+The second run switches to single precision vertex values at the start
+of evolve, after the initial conditions are set. The final centroid,
+edge and vertex values of stage, xmomentum, ymomentum and height are
+saved by each run, in double precision, and compared:
+
+  centroid and edge values must be identical, as the DE kernels only
+  compute with the double precision ones,
+
+  vertex values must differ by no more than single precision rounding,
+  a relative difference of 2**-24.
+
+The sww files are not compared, since they store single precision
+values in both modes.
+
+Usage:
+
+  python vertex_output_precision_report.py [test_dir ...] [-alg DE0]
+
+With no test directories, runs the dam break and lake at rest tests.
+Exits with status 1 if any of the checks fails.
+"""
+
+import os
+import sys
+import glob
+import shutil
+import tempfile
+import subprocess
+
+import numpy
+
+
+default_test_dirs = ['dam_break_dry', 'dam_break_wet',
+                     'lake_at_rest_immersed_bump',
+                     'lake_at_rest_steep_island']
+
+names = ['stage', 'xmomentum', 'ymomentum', 'height']
+
+single_precision_rounding = 2.0**-24
+
+run_with_precision = """
+import sys, runpy
+import numpy
+import anuga
+
+# The numerical scripts import float from numpy, removed in numpy 1.24
+if not hasattr(numpy, 'float'):
+    numpy.float = float
+
+precision = %r
+evolve = anuga.Domain.evolve
+
+def evolve_with_precision(self, *args, **kwargs):
+    self.set_vertex_output_precision(precision)
+    return evolve(self, *args, **kwargs)
+
+anuga.Domain.evolve = evolve_with_precision
+
+sys.argv = sys.argv[1:]
+domain = runpy.run_path(sys.argv[0], run_name='__main__')['domain']
+
+values = {}
+for name in %r:
+    Q = domain.quantities[name]
+    values[name + '_centroid'] = Q.centroid_values
+    values[name + '_edge'] = Q.edge_values
+    values[name + '_vertex'] = numpy.array(Q.vertex_values, float)
+numpy.savez('final_values.npz', **values)
+"""
+
+
+def run_test(test_dir, precision, args):
+    """Run the numerical script of test_dir in a temporary copy of the
+    directory and return the name of the file of final values produced
+    """
+
+    run_dir = tempfile.mkdtemp(prefix='vertex_output_precision_')
+    shutil.rmtree(run_dir)
+    shutil.copytree(test_dir, run_dir)
+
+    script = glob.glob(os.path.join(run_dir, 'numerical_*.py'))[0]
+    cmd = [sys.executable, '-c', run_with_precision % (precision, names),
+           os.path.basename(script)] + args
+    with open(os.path.join(run_dir, 'run.stdout'), 'w') as fid:
+        subprocess.check_call(cmd, cwd=run_dir, stdout=fid, stderr=fid)
+
+    return os.path.join(run_dir, 'final_values.npz')
+
+
+def compare_values(values_double, values_single):
+    """List of (array, largest absolute difference, largest difference
+    relative to the double precision value, passed) for each saved array
+    """
+
+    double = numpy.load(values_double)
+    single = numpy.load(values_single)
+
+    results = []
+    for array in sorted(double.files):
+        difference = numpy.abs(double[array] - single[array])
+        scale = numpy.maximum(numpy.abs(double[array]),
+                              numpy.finfo(numpy.float32).tiny)
+        relative = (difference/scale).max()
+
+        if array.endswith('_vertex'):
+            passed = relative <= single_precision_rounding
+        else:
+            passed = difference.max() == 0.0
+
+        results.append((array, difference.max(), relative, passed))
+
+    return results
+
+
+if __name__ == '__main__':
+
+    test_dirs = [arg for arg in sys.argv[1:] if os.path.isdir(arg)]
+    args = [arg for arg in sys.argv[1:] if arg not in test_dirs]
+
+    if not test_dirs:
+        here = os.path.dirname(os.path.abspath(__file__))
+        test_dirs = [os.path.join(here, name) for name in default_test_dirs]
+
+    failed = False
+
+    print('%-30s %-20s %15s %15s %6s' % ('test', 'values', 'max abs diff',
+                                         'max rel diff', ''))
+    for test_dir in test_dirs:
+        values_double = run_test(test_dir, 'double', args)
+        values_single = run_test(test_dir, 'single', args)
+
+        for array, max_difference, relative, passed in \
+                compare_values(values_double, values_single):
+            print('%-30s %-20s %15.3e %15.3e %6s' %
+                  (os.path.basename(test_dir), array, max_difference,
+                   relative, 'ok' if passed else 'FAIL'))
+            failed = failed or not passed
+
+        shutil.rmtree(os.path.dirname(values_double))
+        shutil.rmtree(os.path.dirname(values_single))
+
+    sys.exit(1 if failed else 0)